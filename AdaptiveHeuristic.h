@@ -0,0 +1,282 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include "Arm.h"
+#include "PotSon.h"
+#include "TreeSearch.h"
+
+
+
+/**
+* Statistics shared by all the AdaptiveHeuristic objects working on the same tour.
+*
+* For each window of tour indices and each class of son (the rotations of the
+* four largest arms, i.e. 7, 6, 5 and 4 for 8 arms), we record how many times
+* the class was chosen and the sum of the (normalized) depths reached
+* afterward. The depths reached are small compared to the saturation depth so
+* the exploration bonus of the UCB rule is scaled by the mean reward of the
+* window: otherwise it dominates the means and only balances the counts of
+* the classes. All counters are atomics updated with relaxed ordering so the
+* searches never lock each other.
+**/
+class BanditStats
+    {
+
+    public:
+
+        static constexpr int NB_CLASSES = 81;   // 3^4 : rotation -1/0/+1 of the four largest arms
+        static constexpr int FIXED_ONE = 1024;  // fixed point unit for the rewards
+
+
+        /**
+        * Ctor.
+        *
+        * tour_len  : number of pixels in the tour
+        * window    : number of tour indices sharing the same statistics
+        * max_depth : depth at which the reward saturates to 1
+        **/
+        BanditStats(size_t tour_len, int window = 16, int max_depth = 512) : _window(window), _max_depth(max_depth)
+            {
+            MTOOLS_INSURE(window > 0);
+            MTOOLS_INSURE(max_depth > 0);
+            _nbwin = (int)(tour_len / window) + 1;
+            const size_t N = (size_t)_nbwin * NB_CLASSES;
+            _count.reset(new std::atomic<uint32_t>[N]);
+            _sum.reset(new std::atomic<uint64_t>[N]);
+            _total.reset(new std::atomic<uint64_t>[_nbwin]);
+            _totsum.reset(new std::atomic<uint64_t>[_nbwin]);
+            for (size_t i = 0; i < N; i++) { _count[i].store(0, std::memory_order_relaxed); _sum[i].store(0, std::memory_order_relaxed); }
+            for (int i = 0; i < _nbwin; i++) { _total[i].store(0, std::memory_order_relaxed); _totsum[i].store(0, std::memory_order_relaxed); }
+            }
+
+
+        /**
+        * Record that the class 'cl' chosen at tour index n led to a path 'depth' steps deeper.
+        **/
+        void record(int n, int cl, int depth)
+            {
+            const int w = _win(n);
+            const int d = (depth > _max_depth) ? _max_depth : depth;
+            const size_t i = (size_t)w * NB_CLASSES + cl;
+            const uint64_t r = (uint64_t)((int64_t)d * FIXED_ONE / _max_depth);
+            _count[i].fetch_add(1, std::memory_order_relaxed);
+            _sum[i].fetch_add(r, std::memory_order_relaxed);
+            _total[w].fetch_add(1, std::memory_order_relaxed);
+            _totsum[w].fetch_add(r, std::memory_order_relaxed);
+            }
+
+
+        /**
+        * UCB1 score of class cl at index n (the bonus is scaled by the mean reward of the window).
+        **/
+        double ucb(int n, int cl, double explore) const
+            {
+            const int w = _win(n);
+            const size_t i = (size_t)w * NB_CLASSES + cl;
+            const uint32_t c = _count[i].load(std::memory_order_relaxed);
+            if (c == 0) return mtools::INF;
+            const double mean = ((double)_sum[i].load(std::memory_order_relaxed)) / ((double)FIXED_ONE * c);
+            const double tot = (double)_total[w].load(std::memory_order_relaxed);
+            const double wmean = ((double)_totsum[w].load(std::memory_order_relaxed)) / ((double)FIXED_ONE * tot);
+            return mean + explore * wmean * sqrt(log(tot + 1.0) / c);
+            }
+
+
+        /**
+        * Mean reward of class cl at index n (-1 if never tried).
+        **/
+        double mean(int n, int cl) const
+            {
+            const size_t i = (size_t)_win(n) * NB_CLASSES + cl;
+            const uint32_t c = _count[i].load(std::memory_order_relaxed);
+            if (c == 0) return -1.0;
+            return ((double)_sum[i].load(std::memory_order_relaxed)) / ((double)FIXED_ONE * c);
+            }
+
+
+        /**
+        * Number of tour indices per window.
+        **/
+        int window() const
+            {
+            return _window;
+            }
+
+
+    private:
+
+        int _win(int n) const
+            {
+            int w = n / _window;
+            return (w >= _nbwin) ? (_nbwin - 1) : w;
+            }
+
+        int _window;
+        int _max_depth;
+        int _nbwin;
+        std::unique_ptr<std::atomic<uint32_t>[]> _count;   // number of times each class was chosen
+        std::unique_ptr<std::atomic<uint64_t>[]> _sum;     // sum of the rewards (fixed point)
+        std::unique_ptr<std::atomic<uint64_t>[]> _total;   // total number of records per window
+        std::unique_ptr<std::atomic<uint64_t>[]> _totsum;  // sum of the rewards per window (fixed point)
+    };
+
+
+
+
+/**
+* Adaptive heuristic for TreeSearch::search().
+*
+* Each time a choice made at index p is abandoned (because the search went back
+* to an index <= p), the depth reached after that choice is recorded in the
+* shared BanditStats. Each son then receives the weight (s / smax)^power where
+* s is the UCB score of its class and smax the largest score among the sons.
+* When all the classes have the same statistics (and for power = 0) the son is
+* chosen uniformly, as with uniform_heuristic().
+*
+* The object is copied into each search thread: the bookkeeping of the choices
+* is per instance while the statistics are shared through the pointer.
+**/
+class AdaptiveHeuristic
+    {
+
+    public:
+
+
+        /**
+        * Ctor.
+        *
+        * stats   : statistics, possibly shared between several searches on the same tour.
+        * power   : exponent applied to the relative UCB scores (0 = uniform choice).
+        * explore : exploration constant of the UCB rule.
+        **/
+        AdaptiveHeuristic(std::shared_ptr<BanditStats> stats, double power = 1.0, double explore = 0.5) : _stats(stats), _power(power), _explore(explore), _last(-1), _stamp(0)
+            {
+            MTOOLS_INSURE(_stats != nullptr);
+            MTOOLS_INSURE(power >= 0.0);
+            for (int c = 0; c < BanditStats::NB_CLASSES; c++) { _cstamp[c] = 0; _cscore[c] = 0.0; }
+            }
+
+
+        /**
+        * Choose the next son. Same signature as the heuristics used by TreeSearch::search().
+        **/
+        Arm operator()(int n, Arm arm, iVec2 target, PotSon& potson, bool backtracked, TreeSearch* TS)
+            {
+            if (_cls.size() == 0)
+                {
+                const size_t L = TS->tour().size() + 1;
+                _cls.resize(L, NO_CLASS);
+                _peak.resize(L, -1);
+                }
+            _update(n);
+            _last = n;
+            _peak[n] = n;
+
+            const int nbs = potson.size();
+            int cl[ArmDims<Arm::NB_ARMS>::nbSteps()];
+            for (int i = 0; i < nbs; i++) cl[i] = _classOf(potson[i] - arm);
+
+            if (_power == 0.0)
+                {
+                const int k = (int)Unif_int(0, nbs - 1, potson.rng());
+                _cls[n] = (uint8_t)cl[k];
+                return potson[k];
+                }
+
+            // UCB score of each class present, computed once per call.
+            _stamp++;
+            double smax = 0.0;
+            bool untried = false;
+            for (int i = 0; i < nbs; i++)
+                {
+                const int c = cl[i];
+                if (_cstamp[c] == _stamp) continue;
+                _cstamp[c] = _stamp;
+                const double s = _stats->ucb(n, c, _explore);
+                _cscore[c] = s;
+                if (s == mtools::INF) untried = true; else if (s > smax) smax = s;
+                }
+
+            // son weights: untried classes first, then (s / smax)^power.
+            double w[ArmDims<Arm::NB_ARMS>::nbSteps()];
+            double tot = 0.0;
+            for (int i = 0; i < nbs; i++)
+                {
+                const double s = _cscore[cl[i]];
+                if (untried) tot += (s == mtools::INF) ? 1.0 : 0.0;
+                else tot += (smax > 0.0) ? pow(s / smax, _power) : 1.0;
+                w[i] = tot;
+                }
+            for (int i = 0; i < nbs; i++) w[i] /= tot;
+            const int k = (int)sampleDiscreteRVfromCDF(w, nbs - 1, potson.rng());
+            _cls[n] = (uint8_t)cl[k];
+            return potson[k];
+            }
+
+
+    private:
+
+        static constexpr uint8_t NO_CLASS = 255;
+
+
+        /** class of a step increment: rotations of the four largest arms in base 3. */
+        static int _classOf(const Arm& a)
+            {
+            int c = 0;
+            for (int k = Arm::NB_ARMS - 1; (k >= Arm::NB_ARMS - 4) && (k >= 0); k--)
+                {
+                const int v = a.angle(k);
+                c = 3 * c + ((v == 0) ? 0 : ((v == 1) ? 1 : 2));
+                }
+            return c;
+            }
+
+
+        /**
+        * Credit the choices abandoned since the last call.
+        *
+        * With macro steps (or after tunneling) the search can move forward by
+        * more than one index between two calls: the indices skipped have no
+        * choice recorded so this is a plain continuation and the choice at
+        * _last is credited with the progress.
+        **/
+        void _update(int n)
+            {
+            if (_last < 0) return;
+            if (n > _last)
+                { // moving forward: nothing abandoned.
+                _peak[_last] = n - 1;
+                return;
+                }
+            // choices at indices n.._last are abandoned
+            int m = -1;
+            for (int p = _last; p >= n; p--)
+                {
+                if (_peak[p] > m) m = _peak[p];
+                if (_cls[p] != NO_CLASS) _stats->record(p, _cls[p], m + 1 - p);
+                _cls[p] = NO_CLASS;
+                _peak[p] = -1;
+                }
+            if ((n > 0) && (m > _peak[n - 1])) _peak[n - 1] = m; // the choice at n-1 is still there and reached m+1.
+            }
+
+
+        std::shared_ptr<BanditStats> _stats;   // shared statistics
+        double _power;                          // exponent of the relative UCB scores
+        double _explore;                        // UCB exploration constant
+
+        int _last;                              // index of the last call
+        std::vector<uint8_t> _cls;              // class chosen at each index of the current path
+        std::vector<int> _peak;                 // deepest index reached after the choice (partial, propagated on abandon)
+
+        uint32_t _stamp;                                // id of the current call
+        uint32_t _cstamp[BanditStats::NB_CLASSES];      // call in which the score of a class was computed
+        double _cscore[BanditStats::NB_CLASSES];        // UCB score of each class for the current call
+    };
+
+
+
+/** end of file */
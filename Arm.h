@@ -1,9 +1,11 @@
 #pragma once
 
 
-#include "mtools/mtools.hpp" 
+#include "mtools/mtools.hpp"
 using namespace mtools;
 
+#include <type_traits>
+
 #include "SantaImage.h"
 
 
@@ -14,67 +16,99 @@ std::pair<int, int> p2reach(int arm_index, int64 pos);
 
 
 /**
- * 
- * An arm configuration. Same size as uint64_t (8 bytes). 
- * 
- **/
-class Arm
+* Dimensions of the problem with NARMS arms (compile time constants).
+*
+* The arms have lengths 1 1 2 4 ... 2^(NARMS-2) and arm k has 8 * lenArm(k)
+* angles, stored on ARM_BITS[k] bits. The tip of the arm covers the image
+* [-C, C]^2 with C = 2^(NARMS-1) (C = 128 for the 8 arms of the challenge).
+* The angles of the 9 arms fit in 55 bits so NARMS is at most 9.
+**/
+static constexpr int ARM_BITS[10]  = { 3, 3, 4, 5, 6, 7, 8, 9, 10, 11 };    // bits of the angle of arm k
+static constexpr int ARM_SHIFT[10] = { 0, 3, 6, 10, 15, 21, 28, 36, 45, 55 }; // position of the angle of arm k
+
+template<int NARMS> struct ArmDims
     {
+    static_assert((NARMS >= 2) && (NARMS <= 9), "the number of arms must be in [2, 9]");
 
+    static constexpr int NB_ARMS = NARMS;                       // number of arms
+    static constexpr int NB_BITS = ARM_SHIFT[NARMS];            // bits used by the angles
+    static constexpr int IMAGE_C = 1 << (NARMS - 1);            // the image is [-IMAGE_C, IMAGE_C]^2
+    static constexpr int IMAGE_L = 2 * IMAGE_C + 1;             // side of the image
+    static constexpr int MAX_MOVE = NARMS;                      // largest L1 norm of a step
+    static constexpr int NB_EXTREMAL = 1 << (NARMS - 1);        // number of extremal paths (see pathToReach())
 
-    friend Arm operator+(const Arm& arm1, const Arm& arm2);
-    friend Arm operator-(const Arm& arm1, const Arm& arm2);
+    /** Number of step increments (rotation -1, 0 or +1 of each arm) = 3^NARMS. */
+    static constexpr int nbSteps() { int n = 1; for (int k = 0; k < NARMS; k++) n *= 3; return n; }
 
-    /**
-    * Return the cost of moving from a to b (assuming they are admissible)
-    **/
-    friend double penaltyL1(Arm a, Arm b);
+    /** Length of arm k. */
+    static constexpr int len(int k) { return (k == 0) ? 1 : (1 << (k - 1)); }
 
+    /** Mask of all the angles. */
+    static constexpr uint64_t fieldMask() { return (NB_BITS == 64) ? ~((uint64_t)0) : ((((uint64_t)1) << NB_BITS) - 1); }
+
+    /** Mask of the highest bit of each angle. */
+    static constexpr uint64_t highMask() { uint64_t m = 0; for (int k = 0; k < NARMS; k++) m |= ((uint64_t)1) << (ARM_SHIFT[k] + ARM_BITS[k] - 1); return m; }
+
+    /** Start position: the largest arm at (l, 0) and all the others at (-l, 0). */
+    static constexpr uint64_t startVal() { uint64_t v = 0; for (int k = 0; k < NARMS; k++) v |= ((uint64_t)(((k == NARMS - 1) ? 3 : 7) * len(k))) << ARM_SHIFT[k]; return v; }
+    };
 
-    /**
-    * Return the loss of moving from a to b compared to the sqrt(L1) norm on the pixel. 
-    **/
-    friend double lossL1(Arm a, Arm b);
 
 
+/**
+ *
+ * An arm configuration with NARMS arms. Same size as uint64_t (8 bytes).
+ *
+ * The angles are packed in a single uint64 (arm k at bits ARM_SHIFT[k]) and
+ * all the dimensions are compile time constants so the accesses compile to
+ * shifts and masks. The arms of the challenge are Arm = ArmT<SANTA_NB_ARMS>.
+ *
+ **/
+template<int NARMS> class ArmT
+    {
+
+    typedef ArmDims<NARMS> Dims;
+
 public:
-    
-    static const uint64_t START_ARM_POS = 11533731900201661375; 
+
+    static constexpr int NB_ARMS = NARMS;
+
+    static constexpr uint64_t START_ARM_POS = Dims::startVal();
 
 
     /**
     * ctor. Set the position to the challenge start position.
     */
-    Arm() : _val(START_ARM_POS)
+    ArmT() : _val(START_ARM_POS)
         {
-        _free = 0;
         }
 
 
     /**
-    * ctor. P must be either the origin or a corner. 
+    * ctor. P must be either the origin or a corner.
     */
-    Arm(iVec2 P)
+    ArmT(iVec2 P)
         {
         if (P == iVec2(0, 0))
             {
             reset();
             return;
             }
-        int a = 0, b = 0; 
-        if (P == iVec2(-128, -128))
+        const int C = Dims::IMAGE_C;
+        int a = 0, b = 0;
+        if (P == iVec2(-C, -C))
             {
-            a = -1; b = -1; 
+            a = -1; b = -1;
             }
-        if (P == iVec2(128, -128))
+        if (P == iVec2(C, -C))
             {
             a = 1; b = -1;
             }
-        if (P == iVec2(-128, 128))
+        if (P == iVec2(-C, C))
             {
             a = -1; b = 1;
             }
-        if (P == iVec2(128, 128))
+        if (P == iVec2(C, C))
             {
             a = 1; b = 1;
             }
@@ -83,40 +117,26 @@ public:
             {
             MTOOLS_ERROR("Arm::Arm(iVec2 P) WRONG POSITION !");
             }
-        setPos(0, { a*1, b * 1 });
-        setPos(1, { a*1, b * 1 });
-        setPos(2, { a * 2, b * 2 });
-        setPos(3, { a * 4, b * 4 });
-        setPos(4, { a * 8, b * 8 });
-        setPos(5, { a * 16, b * 16 });
-        setPos(6, { a * 32, b * 32 });
-        setPos(7, { a * 64, b * 64 });
-        _free = 0;
+        _val = 0;
+        for (int k = 0; k < NARMS; k++) setPos(k, { a * lenArm(k), b * lenArm(k) });
         MTOOLS_INSURE(pos() == P);
         }
 
 
     /**
-    * Set the angle of each arm. (0 = smallest, 7 = largest). 
+    * Set the angle of each arm. (first = smallest, last = largest).
     **/
-    Arm(int v0, int v1, int v2, int v3, int v4, int v5, int v6, int v7)
+    template<typename... ANGLES, typename = typename std::enable_if<(sizeof...(ANGLES) == NARMS)>::type> ArmT(ANGLES... v) : _val(0)
         {
-        _A0 = v0;
-        _A1 = v1;
-        _A2 = v2;
-        _A3 = v3;
-        _A4 = v4;
-        _A5 = v5;
-        _A6 = v6;
-        _A7 = v7;
-        _free = 0; 
+        const int A[NARMS] = { ((int)v)... };
+        for (int k = 0; k < NARMS; k++) setAngle(k, A[k]);
         }
 
 
     /**
     * Constructor from a string in the submission format e.g. "64 13;29 -32;5 16;0 -8;-4 0;-1 -2;-1 0;1 -1"
     **/
-    Arm(const std::string& str)
+    ArmT(const std::string& str)
         {
         parse(str);
         }
@@ -125,27 +145,27 @@ public:
     /**
     * Default copy ctor
     **/
-    Arm(const Arm&) = default; 
+    ArmT(const ArmT&) = default;
 
 
     /**
     * Default assignement operator
     **/
-    Arm& operator=(const Arm&) = default; 
+    ArmT& operator=(const ArmT&) = default;
 
 
     /**
-    * Comparison (equal if all arm are the same). 
+    * Comparison (equal if all arm are the same).
     **/
-    bool operator==(const Arm& arm) const
+    bool operator==(const ArmT& arm) const
         {
-        return ((_A0 == arm._A0) && (_A1 == arm._A1) && (_A2 == arm._A2) && (_A3 == arm._A3) && (_A4 == arm._A4) && (_A5 == arm._A5) && (_A6 == arm._A6) && (_A7 == arm._A7));
+        return (((_val ^ arm._val) & Dims::fieldMask()) == 0);
         }
 
     /**
     * Comparison (equal if all arm are the same).
     **/
-    bool operator!=(const Arm& arm) const
+    bool operator!=(const ArmT& arm) const
         {
         return !(operator==(arm));
         }
@@ -155,40 +175,48 @@ public:
     /**
     * Arm addition.
     **/
-    void operator+=(const Arm& arm)
+    void operator+=(const ArmT& arm)
         {
-        _A0 = _A0 + arm._A0;
-        _A1 = _A1 + arm._A1;
-        _A2 = _A2 + arm._A2;
-        _A3 = _A3 + arm._A3;
-        _A4 = _A4 + arm._A4;
-        _A5 = _A5 + arm._A5;
-        _A6 = _A6 + arm._A6;
-        _A7 = _A7 + arm._A7;
+        _val = _add(_val, arm._val);
         }
 
     /**
     * Arm substraction
     **/
-    void operator-=(const Arm& arm)
+    void operator-=(const ArmT& arm)
+        {
+        _val = _sub(_val, arm._val);
+        }
+
+
+    /**
+    * Arm addition (each angle modulo its number of values).
+    **/
+    ArmT operator+(const ArmT& arm) const
+        {
+        ArmT r;
+        r._val = _add(_val, arm._val);
+        return r;
+        }
+
+
+    /**
+    * Arm substraction (each angle modulo its number of values).
+    **/
+    ArmT operator-(const ArmT& arm) const
         {
-        _A0 = _A0 - arm._A0;
-        _A1 = _A1 - arm._A1;
-        _A2 = _A2 - arm._A2;
-        _A3 = _A3 - arm._A3;
-        _A4 = _A4 - arm._A4;
-        _A5 = _A5 - arm._A5;
-        _A6 = _A6 - arm._A6;
-        _A7 = _A7 - arm._A7;
+        ArmT r;
+        r._val = _sub(_val, arm._val);
+        return r;
         }
 
+
     /**
-    * Set all arm values to 0. 
+    * Set all arm values to 0.
     **/
     void setZero()
         {
-        _val = 0; 
-        _free = 0;
+        _val = 0;
         }
 
 
@@ -199,7 +227,6 @@ public:
     void reset()
         {
         _val = START_ARM_POS;
-        _free = 0;
         }
 
 
@@ -217,64 +244,40 @@ public:
     **/
     void setVal(uint64_t val)
         {
-        _val = val;
-        _free = 0; 
+        _val = val & Dims::fieldMask();
         }
 
 
     /**
-     * Final position pointed by the arms in [-128,128]x[-128,28]
+     * Final position pointed by the arms in [-C,C]x[-C,C]
      */
     iVec2 pos() const
         {
-        return _getArmPos(1, _A0) + _getArmPos(1, _A1) + _getArmPos(2, _A2) + _getArmPos(4, _A3) + _getArmPos(8, _A4) + _getArmPos(16, _A5) + _getArmPos(32, _A6) + _getArmPos(64, _A7);
+        iVec2 P(0, 0);
+        for (int k = 0; k < NARMS; k++) P += _getArmPos(lenArm(k), angle(k));
+        return P;
         }
 
 
     /**
-     * Position of the tip of a given arm (centered at 0). 
+     * Position of the tip of a given arm (centered at 0).
      */
     iVec2 pos(int arm_index) const
         {
-        switch (arm_index)
+        if ((arm_index < 0) || (arm_index >= NARMS))
             {
-            case 0: return _getArmPos(1, _A0);
-            case 1: return _getArmPos(1, _A1);
-            case 2: return _getArmPos(2, _A2);
-            case 3: return _getArmPos(4, _A3);
-            case 4: return _getArmPos(8, _A4);
-            case 5: return _getArmPos(16, _A5);
-            case 6: return _getArmPos(32, _A6);
-            case 7: return _getArmPos(64, _A7);
-            }        
-        MTOOLS_ERROR("Arm::pos(). Invalid arm number: " << arm_index);
-        return { 0,0 };
-        }
-
-
-    /**
-    * Position of the center of the ith rectangle 
-    * i.e.  sum of the positon of the arm in [arm_index,7]. 
-    */
-    iVec2 centerBox(int arm_index)
-        {
-        iVec2 P(0, 0);
-        int i = 7; 
-        while (i >= arm_index)
-            {
-            P += pos(i);
-            i--; 
+            MTOOLS_ERROR("Arm::pos(). Invalid arm number: " << arm_index);
+            return { 0,0 };
             }
-        return P; 
+        return _getArmPos(lenArm(arm_index), angle(arm_index));
         }
 
 
-
     /**
      * Set the position of the tip of a given arm (centered at 0).
      */
-    void setPos(int arm_index, iVec2 P) 
-        {        
+    void setPos(int arm_index, iVec2 P)
+        {
         const int l = lenArm(arm_index);
         const int x = (int)P.X();
         const int y = (int)P.Y();
@@ -292,33 +295,22 @@ public:
 
     /**
     * Angle of the tip of a given arm
-    * 
+    *
     *    6l---------4l
     *    |          |
     *    |          |
     *    |          |
     *    0----------2l
     */
-    int angle(int arm_index) const 
+    int angle(int arm_index) const
         {
-        switch (arm_index)
-            {
-            case 0: return _A0; 
-            case 1: return _A1;
-            case 2: return _A2;
-            case 3: return _A3;
-            case 4: return _A4;
-            case 5: return _A5;
-            case 6: return _A6;
-            case 7: return _A7;
-            }
-        MTOOLS_ERROR("Arm::angle(). Invalid arm number: " << arm_index);
-        return 0; 
+        MTOOLS_ASSERT((arm_index >= 0) && (arm_index < NARMS));
+        return (int)((_val >> ARM_SHIFT[arm_index]) & _mask(arm_index));
         }
 
 
     /**
-    * Set the angle of the tip of a given arm
+    * Set the angle of the tip of a given arm (taken modulo the number of angles)
     *
     *    6l---------4l
     *    |          |
@@ -328,47 +320,31 @@ public:
     */
     void setAngle(int arm_index, int val)
         {
-        switch (arm_index)
+        if ((arm_index < 0) || (arm_index >= NARMS))
             {
-            case 0: _A0 = val; return;
-            case 1: _A1 = val; return;
-            case 2: _A2 = val; return;
-            case 3: _A3 = val; return;
-            case 4: _A4 = val; return;
-            case 5: _A5 = val; return;
-            case 6: _A6 = val; return;
-            case 7: _A7 = val; return;
+            MTOOLS_ERROR("Arm::setAngle(). Invalid param arm: " << arm_index << "  val: " << val);
+            return;
             }
-        MTOOLS_ERROR("Arm::setAngle(). Invalid param arm: " << arm_index << "  val: " << val);
+        const uint64_t m = _mask(arm_index) << ARM_SHIFT[arm_index];
+        _val = (_val & ~m) | ((((uint64_t)(int64_t)val) << ARM_SHIFT[arm_index]) & m);
         }
 
 
     /**
-    * Move a the angle of a given arm 
+    * Move a the angle of a given arm
     **/
     void addAngle(int arm_index, int val)
         {
-        switch (arm_index)
-            {
-            case 0: _A0 = (_A0 + val); return;
-            case 1: _A1 = (_A1 + val); return;
-            case 2: _A2 = (_A2 + val); return;
-            case 3: _A3 = (_A3 + val); return;
-            case 4: _A4 = (_A4 + val); return;
-            case 5: _A5 = (_A5 + val); return;
-            case 6: _A6 = (_A6 + val); return;
-            case 7: _A7 = (_A7 + val); return;
-            }
-        MTOOLS_ERROR("Arm::addAngle(). Invalid param arm: " << arm_index << "  val: " << val);
+        setAngle(arm_index, angle(arm_index) + val);
         }
 
 
 
 
     /**
-    * Return the length of a given arm: 1 1 2 4 8 16 32 64
+    * Return the length of a given arm: 1 1 2 4 8 16 32 64 ...
     */
-    int lenArm(int arm_index) const
+    static constexpr int lenArm(int arm_index)
         {
         return (arm_index == 0) ? 1 : (1 << (arm_index - 1));
         }
@@ -379,10 +355,10 @@ public:
     */
     std::string toString() const
         {
-        mtools::ostringstream os; 
+        mtools::ostringstream os;
         auto P = pos();
         os << "Arm (" << P.X() << " , " << P.Y() << ")   -> val =" << _val << "\n";
-        for (int i = 0; i < 8; i++) 
+        for (int i = 0; i < NARMS; i++)
             {
             const int l = lenArm(i);
             const int x = (int)pos(i).X();
@@ -402,26 +378,44 @@ public:
         const int l = lenArm(arm_index);
         const int x = (int)pos(arm_index).X();
         const int y = (int)pos(arm_index).Y();
-        iVec2 P; 
+        iVec2 P;
         P.X() = (x == -l) ? -1 : ((x == l) ? 1 : 0);
         P.Y() = (y == -l) ? -1 : ((y == l) ? 1 : 0);
-        return P; 
+        return P;
         }
 
 
 
 
+    /** Maximum length of the line written by write() / str(). */
+    static constexpr int MAX_STR_LEN = 10 * NARMS + 1;
+
+
     /**
     * Print the arm configuration in the submission format
     */
     std::string str() const
         {
-        mtools::ostringstream os;
-        for (int i = 7; i >= 0; i--)
+        char buf[MAX_STR_LEN];
+        return std::string(buf, write(buf));
+        }
+
+
+    /**
+    * Write the arm configuration in the submission format (with the final
+    * '\n') at buf (at least MAX_STR_LEN chars). Return the end of the text.
+    **/
+    char* write(char* buf) const
+        {
+        for (int i = NARMS - 1; i >= 0; i--)
             {
-            os << pos(i).X() << " " << pos(i).Y() << ((i == 0) ? "\n" : ";");
+            const iVec2 P = pos(i);
+            buf = _writeInt(buf, (int)P.X());
+            *(buf++) = ' ';
+            buf = _writeInt(buf, (int)P.Y());
+            *(buf++) = ((i == 0) ? '\n' : ';');
             }
-        return os.str();
+        return buf;
         }
 
 
@@ -430,37 +424,54 @@ public:
     **/
     bool parse(const std::string & str)
         {
-        auto R = tokenize(str, "", "; \n");
-        if (R.size() != 16)
+        return parse(str.data(), str.data() + str.size());
+        }
+
+
+    /**
+    * Parse the submission format from the range [p, end) without copy. The
+    * numbers are separated by spaces, tabs, ';' or line ends. Return false
+    * (and reset the arm) if there are not exactly 2 * NARMS integers or if
+    * some arm position is not on the boundary of its square.
+    **/
+    bool parse(const char* p, const char* end)
+        {
+        uint64_t v = 0;
+        for (int i = NARMS - 1; i >= 0; i--)
             {
-            reset(); 
-            return false;
+            int x, y, a;
+            if ((!_readInt(p, end, x)) || (!_readInt(p, end, y)) || (!_angleOf(lenArm(i), x, y, a)))
+                {
+                reset();
+                return false;
+                }
+            v |= ((uint64_t)a) << ARM_SHIFT[i];
             }
-        for (int i = 0; i < 8; i++)
+        while ((p < end) && (_isSep(*p))) p++;
+        if (p != end)
             {
-            int x, y;
-            fromString(R[2 * i], x);
-            fromString(R[2 * i + 1], y);
-            setPos(7 - i, iVec2(x, y));
+            reset();
+            return false;
             }
+        _val = v;
         return true;
         }
 
 
     /**
-    * The center of the box of arm k = pos(k) + pos(k+1) + ... + pos(7)
+    * The center of the box of arm k = pos(k) + pos(k+1) + ... + pos(NARMS-1)
     **/
     iVec2 centerBox(int arm_index) const
         {
         iVec2 C(0, 0);
-        for (int k = 7; k >= arm_index; k--) { C += pos(k); }
+        for (int k = NARMS - 1; k >= arm_index; k--) { C += pos(k); }
         return C;
         }
 
 
     /**
-    * Return the bounding box associated with arm k 
-    * (ie for k= 7 it is a quarter image and for k =0 a single pixel). 
+    * Return the bounding box associated with arm k
+    * (ie for the largest arm it is a quarter image and for k =0 a single pixel).
     */
     iBox2 boundingBox(int arm_index) const
         {
@@ -474,23 +485,23 @@ public:
 
 
     /**
-    * Compute the two angles that an arm with a given index must rotate in order for 
-    * its bounding box to contain point P. 
-    * 
+    * Compute the two angles that an arm with a given index must rotate in order for
+    * its bounding box to contain point P.
+    *
     * The value return are in ]-4*la, 4*la] where  la = lenArm(index)
-    * 
-    * Set error to signify when an error occur (either a special move or a larger arm 
-    * does not contain P). 
+    *
+    * Set error to signify when an error occur (either a special move or a larger arm
+    * does not contain P).
     **/
     std::pair<int, int> anglesToReach(iVec2 P, int arm_index, bool & error) const
         {
-        error = false; 
+        error = false;
         if (arm_index == 0)
             {
             iVec2 Q = P - centerBox(1);
             if (std::max(abs(Q.X()), abs(Q.Y())) != 1)
-                { // special case 
-                error = true; 
+                { // special case
+                error = true;
                 return {0,0};
                 }
             const int tab[9] = { 0,1,2,7,-1,3,6,5,4 };
@@ -505,7 +516,7 @@ public:
         const int la = lenArm(arm_index);
         if ((abs(Q.X()), abs(Q.Y())) > 2 * la)
             {
-            error = true; 
+            error = true;
             return { 0, 0 };
             }
         Q += iVec2(la * 2, la * 2);
@@ -554,21 +565,21 @@ public:
 
 
     /**
-    * Return the 128 extremal path to reach point P from this arm. 
-    * All the arm 'a' in the array are located at P. 
-    * They may not be all distinct. 
+    * Return the 2^(NARMS-1) extremal path to reach point P from this arm.
+    * All the arm 'a' in the array are located at P.
+    * They may not be all distinct.
     **/
-    std::array<Arm, 128> pathToReach(iVec2 P) const
+    std::array<ArmT, Dims::NB_EXTREMAL> pathToReach(iVec2 P) const
         {
-        std::array<Arm, 128> v;
+        std::array<ArmT, Dims::NB_EXTREMAL> v;
         if (centerBox(1) == P)
             {
             MTOOLS_ERROR("This case must be treated separately !");
             return v;
             }
         int nb = 0;
-        _pathToReach(P, 7, v, nb);
-        MTOOLS_INSURE(nb = 128);
+        _pathToReach(P, NARMS - 1, v, nb);
+        MTOOLS_INSURE(nb == Dims::NB_EXTREMAL);
         return v;
         }
 
@@ -576,22 +587,39 @@ public:
 
 
     /**
-    * Check if this arm is a valid step increment (rotation -1, 0 or +1 on each arm) 
+    * Check if this arm is a valid step increment (rotation -1, 0 or +1 on each arm)
     **/
     bool isValidStep() const
         {
-        if ((_A0 != 0) && (_A0 != 1) && (_A0 != 7)) return false; 
-        if ((_A1 != 0) && (_A1 != 1) && (_A1 != 7)) return false;
-        if ((_A2 != 0) && (_A2 != 1) && (_A2 != 15)) return false;
-        if ((_A3 != 0) && (_A3 != 1) && (_A3 != 31)) return false;
-        if ((_A4 != 0) && (_A4 != 1) && (_A4 != 63)) return false;
-        if ((_A5 != 0) && (_A5 != 1) && (_A5 != 127)) return false;
-        if ((_A6 != 0) && (_A6 != 1) && (_A6 != 255)) return false;
-        if ((_A7 != 0) && (_A7 != 1) && (_A7 != 511)) return false;
+        for (int k = 0; k < NARMS; k++)
+            {
+            const int a = angle(k);
+            if ((a != 0) && (a != 1) && (a != (int)_mask(k))) return false;
+            }
         return true;
         }
 
 
+    /**
+    * Step increment number u in [0, 3^NARMS): the digit k of u in base 3 is the
+    * rotation of arm k (0, +1 or 2 for -1). Set nb to the number of arms moved.
+    **/
+    static ArmT stepIncrement(int u, int& nb)
+        {
+        ArmT a;
+        a._val = 0;
+        nb = 0;
+        for (int k = 0; k < NARMS; k++)
+            {
+            const int d = u % 3; u /= 3;
+            if (d == 0) continue;
+            a.setAngle(k, (d == 1) ? 1 : -1);
+            nb++;
+            }
+        return a;
+        }
+
+
     /**
     * Return the sign of the angle of an arm (+1, -1 or 0)
     * (sign is positive at exact half by convention)
@@ -599,7 +627,7 @@ public:
     int sign(int arm_index) const
         {
         const int a = angle(arm_index);
-        if (a == 0) return 0; 
+        if (a == 0) return 0;
         const int la = lenArm(arm_index);
         return ((a > 4 * la) ? -1 : 1);
         }
@@ -609,30 +637,34 @@ public:
     private:
 
 
+    uint64_t _val;      // angle of arm k at bits [ARM_SHIFT[k], ARM_SHIFT[k+1])
 
-    union 
+
+    /** mask of the angle of arm k (once shifted down) */
+    static constexpr uint64_t _mask(int arm_index)
         {
-        uint64_t _val;
+        return (((uint64_t)1) << ARM_BITS[arm_index]) - 1;
+        }
 
-        struct 
-            {
-            uint64_t
-                _A0 : 3,
-                _A1 : 3,
-                _A2 : 4,
-                _A3 : 5,
-                _A4 : 6,
-                _A5 : 7,
-                _A6 : 8,
-                _A7 : 9,
-                _free  : 19;
-            };
-        };
 
+    /** add the angles field by field (no carry between fields) */
+    static uint64_t _add(uint64_t a, uint64_t b)
+        {
+        const uint64_t H = Dims::highMask();
+        return ((((a & ~H) + (b & ~H)) ^ ((a ^ b) & H)) & Dims::fieldMask());
+        }
+
+
+    /** substract the angles field by field (no borrow between fields) */
+    static uint64_t _sub(uint64_t a, uint64_t b)
+        {
+        const uint64_t H = Dims::highMask();
+        return ((((a | H) - (b & ~H)) ^ ((a ^ ~b) & H)) & Dims::fieldMask());
+        }
 
 
     /** helper method to compute the position of an arm from its angle */
-    iVec2 _getArmPos(int l, int a) const
+    static iVec2 _getArmPos(int l, int a)
         {
         if (a < 2*l) return { -l + a, -l };
         a -= 2*l;
@@ -644,129 +676,93 @@ public:
         }
 
 
-    /** recursive method called by path2reach */
-    /*
-    void _pathToReach(iVec2 P, int arm_index, std::array<Arm, 128>& V, int& nb) const
+    /** angle of an arm of length l at (x,y) (same as setPos()), return false if (x,y) is not on the boundary of its square */
+    static bool _angleOf(int l, int x, int y, int& a)
         {
-        if (arm_index == 0)
-            {
-            iVec2 Q = P - centerBox(1);
-            MTOOLS_INSURE(std::max(abs(Q.X()), abs(Q.Y())) == 1);
-            const int tab[9] = { 0,1,2,7,-1,3,6,5,4 };
-            const int ta = tab[(Q.X() + 1) + 3 * (Q.Y() + 1)];
-            const int a = angle(0);
-            Arm b = (*this);
-            b.addAngle(0, (ta - a));
-            MTOOLS_INSURE(b.pos() == P);
-            V[nb++] = b;
-            return;
-            }
-        iVec2 Q = P - centerBox(arm_index + 1);
-        const int la = lenArm(arm_index);
-        MTOOLS_INSURE(std::max(abs(Q.X()), abs(Q.Y())) <= 2 * la);
-        Q += iVec2(la * 2, la * 2);
-        auto mm = p2reach(arm_index, Q.X() + (4 * la + 1) * Q.Y());
-        int n, p;
-        int a = angle(arm_index);
-        if (mm.first <= mm.second)
-            {
-            if (a < mm.first)
-                {
-                p = mm.first - a;
-                n = (8 * la) - p - (mm.second - mm.first);
-                } else if (a > mm.second)
-                    {
-                    n = a - mm.second;
-                    p = (8 * la) - n - (mm.second - mm.first);
-                    } else
-                    {
-                    n = 0;
-                    p = 0;
-                    }
-            } else
-            {
-            if ((a > mm.second) && (a < mm.first))
-                {
-                n = a - mm.second;
-                p = mm.first - a;
-                } else
-                {
-                n = 0;
-                p = 0;
-                }
-            }
+        if ((x < -l) || (x > l) || (y < -l) || (y > l)) return false;
+        if (x == -l) a = 6*l + l-y;
+        else if (x == l) a = 2*l + y+l;
+        else if (y == -l) a = x+l;
+        else if (y == l) a = 4*l + l-x;
+        else return false;
+        a &= (8*l - 1);
+        return true;
+        }
 
-            {
-            Arm b = (*this);
-            b.addAngle(arm_index, p);
-            b._pathToReach(P, arm_index - 1, V, nb);
-            }
-            {
-            Arm b = (*this);
-            b.addAngle(arm_index, -n);
-            b._pathToReach(P, arm_index - 1, V, nb);
-            }
+
+    /** separator between two numbers in the submission format */
+    static bool _isSep(char c)
+        {
+        return ((c == ' ') || (c == ';') || (c == '\t') || (c == '\r') || (c == '\n'));
         }
-    */
 
 
+    /** read a (small) signed integer after the separators, advance p */
+    static bool _readInt(const char*& p, const char* end, int& v)
+        {
+        while ((p < end) && (_isSep(*p))) p++;
+        bool neg = false;
+        if ((p < end) && ((*p == '-') || (*p == '+'))) { neg = (*p == '-'); p++; }
+        const char* q = p;
+        int r = 0;
+        while ((p < end) && (*p >= '0') && (*p <= '9') && (p - q < 6)) { r = 10 * r + (*p - '0'); p++; }
+        if ((p == q) || ((p < end) && (!_isSep(*p)))) return false;
+        v = (neg ? -r : r);
+        return true;
+        }
+
 
+    /** write a (small) signed integer, return the end of the text */
+    static char* _writeInt(char* buf, int v)
+        {
+        if (v < 0) { *(buf++) = '-'; v = -v; }
+        if (v >= 100) { *(buf++) = (char)('0' + v / 100); v %= 100; *(buf++) = (char)('0' + v / 10); v %= 10; }
+        else if (v >= 10) { *(buf++) = (char)('0' + v / 10); v %= 10; }
+        *(buf++) = (char)('0' + v);
+        return buf;
+        }
 
 
-    void _pathToReach(iVec2 P, int arm_index, std::array<Arm, 128>& V, int& nb) const
+    void _pathToReach(iVec2 P, int arm_index, std::array<ArmT, Dims::NB_EXTREMAL>& V, int& nb) const
         {
-        bool err = false; 
+        bool err = false;
         auto R = anglesToReach(P, arm_index, err);
         MTOOLS_INSURE(err == false);
         if (arm_index == 0)
             {
-            Arm b = (*this);
+            ArmT b = (*this);
             b.addAngle(0, R.first);
             MTOOLS_INSURE(b.pos() == P);
             V[nb++] = b;
             return;
             }
         {
-        Arm b = (*this);
+        ArmT b = (*this);
         b.addAngle(arm_index, R.first);
         b._pathToReach(P, arm_index - 1, V, nb);
         }
         {
-        Arm b = (*this);
+        ArmT b = (*this);
         b.addAngle(arm_index, R.second);
         b._pathToReach(P, arm_index - 1, V, nb);
         }
         }
 
+    };
 
 
 
+/** The arms of the challenge (8 arms unless SANTA_NB_ARMS is set). */
+typedef ArmT<SANTA_NB_ARMS> Arm;
 
-
-
-
-
-
- 
-
-
-
-
-
-
-
-        
-
-
-    };
-
+static_assert(ArmDims<SANTA_NB_ARMS>::IMAGE_C == SANTA_IMAGE_CX, "the image does not match the arms");
 
 
 
 
 struct compareArm
     {
-    bool operator()(Arm a, Arm b) const 
+    template<int NARMS> bool operator()(ArmT<NARMS> a, ArmT<NARMS> b) const
         {
         return (a.val() < b.val());
         }
@@ -774,35 +770,6 @@ struct compareArm
 
 
 
-
-
-inline Arm operator+(const Arm& arm1, const Arm& arm2)
-    {
-    return Arm((int)(arm1._A0 + arm2._A0), 
-        (int)(arm1._A1 + arm2._A1),
-        (int)(arm1._A2 + arm2._A2),
-        (int)(arm1._A3 + arm2._A3),
-        (int)(arm1._A4 + arm2._A4),
-        (int)(arm1._A5 + arm2._A5),
-        (int)(arm1._A6 + arm2._A6),
-        (int)(arm1._A7 + arm2._A7));
-    }
-
-
-inline Arm operator-(const Arm& arm1, const Arm& arm2)
-    {
-    return Arm((int)(arm1._A0 - arm2._A0), 
-        (int)(arm1._A1 - arm2._A1),
-        (int)(arm1._A2 - arm2._A2),
-        (int)(arm1._A3 - arm2._A3),
-        (int)(arm1._A4 - arm2._A4),
-        (int)(arm1._A5 - arm2._A5),
-        (int)(arm1._A6 - arm2._A6),
-        (int)(arm1._A7 - arm2._A7));
-    }
-
-
-
 /** end of file */
 
 
@@ -0,0 +1,394 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include <memory>
+#include <array>
+#include <algorithm>
+
+#include "Arm.h"
+
+
+
+/**
+* Persistent path of arm configurations.
+*
+* The path is stored in blocks of BLOCK_SIZE arms held by shared pointers.
+* Copying a path (or a prefix of it) only copies the block pointers so both
+* paths share their blocks. A block is duplicated the first time it is
+* modified while shared (copy on write). Hence rewinding or branching a path
+* from another one costs O(length / BLOCK_SIZE) plus the copy of the block
+* modified afterwards, whatever the length of the common prefix.
+*
+* A block can also be packed (see pack()): consecutive arms of a lossless path
+* differ by at most +/-1 on each angle so the step between them fits in a 16
+* bit code (2 bits per arm). A packed block keeps a full keyframe every
+* KEY_PERIOD arms and one code per step: 544 bytes instead of 2048. The steps
+* that do not fit (jumps) are kept aside in full. A packed block is immutable
+* and is unpacked when written. Reading an arm of a packed block decodes at
+* most KEY_PERIOD steps and the last decoded segment is cached so sequential
+* access (in both directions) costs O(1) per arm. Forward iteration with
+* begin() / end() never uses the cache.
+*
+* Reading is done with the const operator[] which returns a copy. Writing must
+* go through set() or push_back() (there is no non-const access to the
+* elements). Because of the cache, a path object must not be read by several
+* threads at once (different paths sharing blocks are fine).
+**/
+class ArmPath
+    {
+
+    public:
+
+        static constexpr int BLOCK_BITS = 8;
+        static constexpr int BLOCK_SIZE = (1 << BLOCK_BITS);   // number of arms per block
+        static constexpr int BLOCK_MASK = BLOCK_SIZE - 1;
+
+        static constexpr int KEY_BITS = 6;
+        static constexpr int KEY_PERIOD = (1 << KEY_BITS);     // distance between keyframes in a packed block
+        static constexpr int KEY_MASK = KEY_PERIOD - 1;
+
+        typedef std::conditional<(Arm::NB_ARMS <= 8), uint16_t, uint32_t>::type StepCode;  // 2 bits per arm
+
+        static constexpr StepCode ESCAPE = (StepCode)0xAAAAAAAA; // code of a step stored in full (no arm uses the 2 bits '10')
+
+
+        /**
+        * Code of the step from a to b: 2 bits per arm (00 = same angle, 01 = +1,
+        * 11 = -1). Return ESCAPE if some angle moves by more than one.
+        **/
+        static StepCode encodeStep(const Arm& a, const Arm& b)
+            {
+            StepCode code = 0;
+            for (int k = 0; k < Arm::NB_ARMS; k++)
+                {
+                const int m = 8 * a.lenArm(k) - 1;
+                const int d = (b.angle(k) - a.angle(k)) & m;
+                if (d == 1) code |= (StepCode)(1 << (2 * k));
+                else if (d == m) code |= (StepCode)(3 << (2 * k));
+                else if (d != 0) return ESCAPE;
+                }
+            if (decodeStep(a, code).val() != b.val()) return ESCAPE;
+            return code;
+            }
+
+
+        /**
+        * Apply the step 'code' (not ESCAPE) to a.
+        **/
+        static Arm decodeStep(Arm a, StepCode code)
+            {
+            for (int k = 0; k < Arm::NB_ARMS; k++)
+                {
+                const int f = (code >> (2 * k)) & 3;
+                if (f == 1) a.addAngle(k, 1);
+                else if (f == 3) a.addAngle(k, -1);
+                }
+            return a;
+            }
+
+
+    private:
+
+        typedef std::array<Arm, BLOCK_SIZE> Block;
+
+
+        /** packed block (immutable) */
+        struct Packed
+            {
+            Arm         key[BLOCK_SIZE / KEY_PERIOD];   // arms at the keyframes
+            StepCode    code[BLOCK_SIZE];               // step from j-1 to j (unused at the keyframes)
+            std::vector<std::pair<int, Arm>> esc;       // arms reached by an ESCAPE step (sorted by index)
+
+            /** arm at index j given the arm 'prev' at index j-1 (j is not a keyframe) */
+            Arm next(const Arm& prev, int j) const
+                {
+                if (code[j] != ESCAPE) return decodeStep(prev, code[j]);
+                auto it = std::lower_bound(esc.begin(), esc.end(), j, [](const std::pair<int, Arm>& e, int v) { return e.first < v; });
+                return it->second;
+                }
+
+            /** decode the arms j0 (a keyframe) ... j1 - 1 in out */
+            void decode(int j0, int j1, Arm* out) const
+                {
+                Arm a = key[j0 >> KEY_BITS];
+                out[0] = a;
+                for (int j = j0 + 1; j < j1; j++) { a = next(a, j); out[j - j0] = a; }
+                }
+            };
+
+
+        /** a block is either plain or packed */
+        struct Slot
+            {
+            std::shared_ptr<Block>          plain;
+            std::shared_ptr<const Packed>   packed;
+            };
+
+
+    public:
+
+
+        /**
+        * Forward iterator. Decode the packed blocks step by step.
+        **/
+        class const_iterator
+            {
+
+            public:
+
+                const_iterator(const ArmPath* P, size_t i) : _P(P), _i(i)
+                    {
+                    if (_i < _P->_size) _a = _P->_get(_i);
+                    }
+
+                /** the arm */
+                const Arm& operator*() const { return _a; }
+
+                /** its index in the path */
+                size_t index() const { return _i; }
+
+                const_iterator& operator++()
+                    {
+                    if (++_i >= _P->_size) return *this;
+                    const Slot& S = _P->_blocks[_i >> BLOCK_BITS];
+                    if ((S.packed) && ((_i & KEY_MASK) != 0)) _a = S.packed->next(_a, (int)(_i & BLOCK_MASK)); else _a = _P->_get(_i);
+                    return *this;
+                    }
+
+                bool operator==(const const_iterator& it) const { return (_i == it._i); }
+                bool operator!=(const const_iterator& it) const { return (_i != it._i); }
+
+            private:
+
+                const ArmPath*  _P;
+                size_t          _i;
+                Arm             _a;
+            };
+
+
+        /** Empty path. */
+        ArmPath() : _size(0), _cseg(0)
+            {
+            }
+
+
+        /** Path with a copy of the arms of V. */
+        explicit ArmPath(const std::vector<Arm>& V) : _size(0), _cseg(0)
+            {
+            reserve(V.size());
+            for (auto& a : V) push_back(a);
+            }
+
+
+        /** Copy: share all the blocks. */
+        ArmPath(const ArmPath&) = default;
+        ArmPath& operator=(const ArmPath&) = default;
+        ArmPath(ArmPath&&) = default;
+        ArmPath& operator=(ArmPath&&) = default;
+
+
+        /** Number of arms in the path. */
+        size_t size() const
+            {
+            return _size;
+            }
+
+
+        /** Reserve room for the block pointers of a path of length n. */
+        void reserve(size_t n)
+            {
+            _blocks.reserve((n + BLOCK_MASK) >> BLOCK_BITS);
+            }
+
+
+        /** Arm at index i. */
+        Arm operator[](size_t i) const
+            {
+            const Slot& S = _blocks[i >> BLOCK_BITS];
+            if (S.plain) return (*S.plain)[i & BLOCK_MASK];
+            const int seg = (int)((i & BLOCK_MASK) >> KEY_BITS);
+            if ((_cpk != S.packed) || (_cseg != seg))
+                { // decode the segment and keep it
+                S.packed->decode(seg << KEY_BITS, (seg + 1) << KEY_BITS, _carm);
+                _cpk = S.packed;
+                _cseg = seg;
+                }
+            return _carm[i & KEY_MASK];
+            }
+
+
+        /** Last arm of the path. */
+        Arm back() const
+            {
+            return (*this)[_size - 1];
+            }
+
+
+        /** Iterator to the arm at index i. */
+        const_iterator iter(size_t i) const
+            {
+            return const_iterator(this, i);
+            }
+
+
+        const_iterator begin() const
+            {
+            return const_iterator(this, 0);
+            }
+
+
+        const_iterator end() const
+            {
+            return const_iterator(this, _size);
+            }
+
+
+        /** Set the arm at index i (copy the block if it is shared or packed). */
+        void set(size_t i, const Arm& a)
+            {
+            _own(i >> BLOCK_BITS)[i & BLOCK_MASK] = a;
+            }
+
+
+        /** Append an arm. */
+        void push_back(const Arm& a)
+            {
+            const size_t k = _size >> BLOCK_BITS;
+            if (k == _blocks.size()) { _blocks.push_back(Slot()); _blocks.back().plain = std::make_shared<Block>(); }
+            _own(k)[_size & BLOCK_MASK] = a;
+            _size++;
+            }
+
+
+        /** Truncate the path to its first n arms (n <= size()). */
+        void resize(size_t n)
+            {
+            MTOOLS_INSURE(n <= _size);
+            _size = n;
+            _blocks.resize((n + BLOCK_MASK) >> BLOCK_BITS);
+            }
+
+
+        /** Make this path equal to the first L arms of P (the blocks are shared). */
+        void assignPrefix(const ArmPath& P, size_t L)
+            {
+            MTOOLS_INSURE(L <= P._size);
+            _blocks.assign(P._blocks.begin(), P._blocks.begin() + ((L + BLOCK_MASK) >> BLOCK_BITS));
+            _size = L;
+            }
+
+
+        /**
+        * Pack the full blocks lying entirely before index n (all of them by
+        * default). If 'other' uses the same (plain) block at the same place, it
+        * gets the packed block too so the two paths keep sharing it.
+        **/
+        void pack(size_t n = (size_t)(-1), ArmPath* other = nullptr)
+            {
+            if (n > _size) n = _size;
+            const size_t nb = n >> BLOCK_BITS;
+            for (size_t k = 0; k < nb; k++)
+                {
+                Slot& S = _blocks[k];
+                if (!S.plain) continue;
+                std::shared_ptr<const Packed> pk = _pack(*S.plain);
+                if ((other) && (k < other->_blocks.size()) && (other->_blocks[k].plain == S.plain))
+                    {
+                    other->_blocks[k].plain.reset();
+                    other->_blocks[k].packed = pk;
+                    }
+                S.plain.reset();
+                S.packed = pk;
+                }
+            }
+
+
+        /** Copy of the first L arms (the whole path by default) in a vector. */
+        std::vector<Arm> toVector(size_t L = (size_t)(-1)) const
+            {
+            if (L > _size) L = _size;
+            std::vector<Arm> V;
+            V.reserve(L);
+            for (size_t k = 0; (k << BLOCK_BITS) < L; k++)
+                {
+                const size_t m = std::min<size_t>(BLOCK_SIZE, L - (k << BLOCK_BITS));
+                const Slot& S = _blocks[k];
+                if (S.plain) { V.insert(V.end(), S.plain->begin(), S.plain->begin() + m); continue; }
+                const size_t j0 = V.size();
+                V.resize(j0 + m);
+                for (size_t j = 0; j < m; j += KEY_PERIOD) S.packed->decode((int)j, (int)std::min<size_t>(j + KEY_PERIOD, m), V.data() + j0 + j);
+                }
+            return V;
+            }
+
+
+        /** Memory used by the blocks in bytes (shared blocks are counted in full). */
+        size_t memory() const
+            {
+            size_t m = 0;
+            for (auto& S : _blocks)
+                {
+                if (S.plain) m += sizeof(Block); else m += sizeof(Packed) + S.packed->esc.size() * sizeof(std::pair<int, Arm>);
+                }
+            return m;
+            }
+
+
+    private:
+
+
+        /** Arm at index i without using the cache. */
+        Arm _get(size_t i) const
+            {
+            const Slot& S = _blocks[i >> BLOCK_BITS];
+            if (S.plain) return (*S.plain)[i & BLOCK_MASK];
+            const int j = (int)(i & BLOCK_MASK);
+            Arm a = S.packed->key[j >> KEY_BITS];
+            for (int t = (j & ~KEY_MASK) + 1; t <= j; t++) a = S.packed->next(a, t);
+            return a;
+            }
+
+
+        /** Plain block k, unpacked or duplicated first if needed. */
+        Block& _own(size_t k)
+            {
+            Slot& S = _blocks[k];
+            if (S.packed)
+                {
+                S.plain = std::make_shared<Block>();
+                for (int j = 0; j < BLOCK_SIZE; j += KEY_PERIOD) S.packed->decode(j, j + KEY_PERIOD, S.plain->data() + j);
+                S.packed.reset();
+                }
+            else if (S.plain.use_count() > 1) S.plain = std::make_shared<Block>(*S.plain);
+            return *S.plain;
+            }
+
+
+        /** Pack a full block. */
+        static std::shared_ptr<const Packed> _pack(const Block& B)
+            {
+            auto P = std::make_shared<Packed>();
+            for (int j = 0; j < BLOCK_SIZE; j++)
+                {
+                if ((j & KEY_MASK) == 0) { P->key[j >> KEY_BITS] = B[j]; P->code[j] = 0; continue; }
+                P->code[j] = encodeStep(B[j - 1], B[j]);
+                if (P->code[j] == ESCAPE) P->esc.push_back({ j, B[j] });
+                }
+            return P;
+            }
+
+
+        std::vector<Slot>   _blocks;    // the blocks
+        size_t              _size;      // number of arms
+
+        mutable std::shared_ptr<const Packed>   _cpk;               // packed block of the cached segment
+        mutable int                             _cseg;              // index of the cached segment in that block
+        mutable Arm                             _carm[KEY_PERIOD];  // the decoded segment
+    };
+
+
+
+/** end of file */
@@ -0,0 +1,415 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include <functional>
+#include <map>
+#include <mutex>
+#include <filesystem>
+
+#include "Arm.h"
+#include "LKHtour.h"
+#include "Solution.h"
+#include "LiftSession.h"
+
+
+
+/**
+* Lift all the LKH tours of a directory.
+*
+* The tours are loaded and checked in parallel by a pre-pass (checkTour() and
+* an optional prescreen function giving a difficulty, see setPrescreen()),
+* then queued by score. Up to 'concurrency' tours are lifted at the same time,
+* each by a LiftSession, and the thread budget is split evenly between the
+* running sessions (a session spreads its share over the five parts of its
+* tour).
+*
+* The score of a pixel tour is a lower bound for the score of any of its lifts
+* so a tour whose score exceeds the best solution found so far by more than
+* 'margin' cannot be useful: it is cancelled if it is running and skipped if
+* it is queued. A tour can also be given up after a time limit.
+*
+* For each tour lifted, the parts are saved by the session in the output
+* directory ([name].X.lossless.skp) and the solution in [name].solved.csv.
+* The summary table is rewritten in [outdir]/batch_summary.txt each time the
+* status of a tour changes.
+**/
+class BatchLift
+    {
+
+    public:
+
+        typedef LiftSession::Heuristic Heuristic;
+
+        /** function returning the difficulty of a tour (INF and err set if the tour should not be lifted). */
+        typedef std::function<double(const std::vector<iVec2>&, std::string& err)> Prescreen;
+
+
+        /**
+        * Ctor.
+        *
+        * directory  : directory containing the .tour files.
+        * outdir     : directory where the results are written (created if needed).
+        * nb_threads : total number of search threads (0 = all cores).
+        * seed       : seed for the RNGs of the sessions.
+        **/
+        BatchLift(const std::string& directory, const std::string& outdir, int nb_threads, uint64 seed) : _dir(directory), _outdir(outdir), _nb_threads(nb_threads), _gen(seed), _concurrency(0), _margin(0.0), _max_time(0), _max_difficulty(mtools::INF), _prepassed(false), _started(false), _next(0), _best(mtools::INF)
+            {
+            if (_nb_threads <= 0) _nb_threads = (int)std::thread::hardware_concurrency();
+            if (_nb_threads <= 0) _nb_threads = 1;
+            setConcurrency();
+            }
+
+
+        /**
+        * Dtor. Stop the running sessions.
+        **/
+        ~BatchLift()
+            {
+            _running.clear();
+            }
+
+
+        /**
+        * Set the maximum number of tours lifted at the same time (0 = one
+        * session per 5 threads, i.e. one thread per part to start with).
+        **/
+        void setConcurrency(int nb_sessions = 0)
+            {
+            _concurrency = (nb_sessions > 0) ? nb_sessions : (_nb_threads / 5);
+            if (_concurrency < 1) _concurrency = 1;
+            if (_concurrency > _nb_threads) _concurrency = _nb_threads;
+            }
+
+
+        /**
+        * Set when a tour is given up: when its score is larger than the best
+        * solution so far plus margin (INF = never) or after max_time_sec
+        * seconds (0 = no limit).
+        **/
+        void setCancel(double margin = 0.0, int max_time_sec = 0)
+            {
+            _margin = margin;
+            _max_time = (max_time_sec < 0) ? 0 : max_time_sec;
+            }
+
+
+        /**
+        * Set the prescreen function called on each tour during the pre-pass
+        * (from the loading threads). The tours with a difficulty larger than
+        * max_difficulty are not lifted.
+        **/
+        void setPrescreen(Prescreen fun, double max_difficulty = mtools::INF)
+            {
+            MTOOLS_INSURE(!_prepassed);
+            _prescreen = fun;
+            _max_difficulty = max_difficulty;
+            }
+
+
+        /**
+        * Function called on each new TreeSearch object before it is started
+        * (to set its parameters).
+        **/
+        void setSetup(std::function<void(TreeSearch&)> setup)
+            {
+            _setup = setup;
+            }
+
+
+        /**
+        * Load, check and prescreen all the tours of the directory (called by
+        * start() if not done before).
+        **/
+        void prepass()
+            {
+            if (_prepassed) return;
+            _prepassed = true;
+            std::map<std::string, std::pair<double, std::string>> res; // filename -> (difficulty, error)
+            std::mutex mut;
+            auto T = loadLKHTours(_dir, _nb_threads, [&](LKHTourFile& F)
+                {
+                std::string err;
+                double d = 0;
+                if (!checkTour(F.tour, err)) d = mtools::INF;
+                else if (_prescreen) d = _prescreen(F.tour, err);
+                F.tour.clear();
+                F.tour.shrink_to_fit(); // reloaded when the lift starts.
+                std::lock_guard<std::mutex> lock(mut);
+                res[F.filename] = { d, err };
+                });
+            for (auto& F : T)
+                {
+                Entry E;
+                E.filename = F.filename;
+                E.name = std::filesystem::path(F.filename).filename().string();
+                E.tour_score = F.score;
+                E.difficulty = mtools::INF;
+                E.status = REJECTED;
+                E.sol_score = mtools::INF;
+                E.time = 0;
+                if (F.error.size() > 0) { E.note = F.error; }
+                else
+                    {
+                    E.difficulty = res[F.filename].first;
+                    E.note = res[F.filename].second;
+                    if (E.difficulty <= _max_difficulty) E.status = QUEUED;
+                    else if (E.note.size() == 0) E.note = "Too difficult..";
+                    }
+                _entry.push_back(E);
+                }
+            }
+
+
+        /**
+        * Start the batch.
+        **/
+        void start(Heuristic fun)
+            {
+            MTOOLS_INSURE(!_started);
+            prepass();
+            std::error_code ec;
+            std::filesystem::create_directories(_outdir, ec);
+            _fun = fun;
+            _started = true;
+            _ch.reset();
+            update();
+            }
+
+
+        /**
+        * Collect the lifted tours, cancel the useless ones and start the next
+        * ones. Return true once all the tours are processed.
+        **/
+        bool update()
+            {
+            MTOOLS_INSURE(_started);
+            bool changed = false;
+            for (size_t k = 0; k < _running.size(); k++)
+                {
+                Running& R = _running[k];
+                Entry& E = _entry[R.entry];
+                if (R.session->update())
+                    {
+                    auto SOL = R.session->solution();
+                    E.sol_score = score(SOL, false);
+                    saveSolution(SOL, (_basename(E) + ".solved.csv").c_str());
+                    E.status = LIFTED;
+                    if (E.sol_score < _best) { _best = E.sol_score; _bestname = E.name; }
+                    }
+                else if ((_max_time > 0) && (R.ch.elapsed() > 1000 * (uint64)_max_time))
+                    {
+                    E.status = CANCELLED;
+                    E.note = "Time limit reached..";
+                    }
+                else if (_useless(E))
+                    {
+                    E.status = CANCELLED;
+                    E.note = "Worse than the best solution..";
+                    }
+                else continue;
+                E.time = R.ch.elapsed() / 1000.0;
+                _running.erase(_running.begin() + k);
+                k--;
+                changed = true;
+                }
+            while ((int)_running.size() < _concurrency)
+                {
+                while ((_next < _entry.size()) && (_entry[_next].status != QUEUED)) _next++;
+                if (_next == _entry.size()) break;
+                Entry& E = _entry[_next];
+                changed = true;
+                if (_useless(E)) { E.status = CANCELLED; E.note = "Worse than the best solution.."; continue; }
+                std::vector<iVec2> tour;
+                std::string err;
+                if ((!loadLKHTour(E.filename, tour, err)) || (!checkTour(tour, err)))
+                    { // the file changed since the prepass.
+                    E.status = REJECTED;
+                    E.note = err;
+                    continue;
+                    }
+                Running R;
+                R.entry = _next;
+                R.session.reset(new LiftSession(tour, _basename(E), 1, Unif_64(_gen)));
+                R.session->setSetup(_setup);
+                R.session->start(_fun);
+                R.ch.reset();
+                E.status = RUNNING;
+                _running.push_back(std::move(R));
+                }
+            if (changed)
+                {
+                _share();
+                saveSummary();
+                }
+            return done();
+            }
+
+
+        /**
+        * Query if all the tours are processed.
+        **/
+        bool done() const
+            {
+            if (_running.size() > 0) return false;
+            for (size_t i = _next; i < _entry.size(); i++) { if (_entry[i].status == QUEUED) return false; }
+            return true;
+            }
+
+
+        /**
+        * Score of the best solution found so far (INF if none).
+        **/
+        double bestScore() const
+            {
+            return _best;
+            }
+
+
+        /**
+        * Print formattted info about the running sessions.
+        **/
+        std::string toString()
+            {
+            int nb[NB_STATUS] = { 0 };
+            for (auto& E : _entry) nb[E.status]++;
+            mtools::ostringstream oss;
+            oss << "tours : " << _entry.size() << "   queued : " << nb[QUEUED] << "   running : " << nb[RUNNING] << "   lifted : " << nb[LIFTED]
+                << "   cancelled : " << nb[CANCELLED] << "   rejected : " << nb[REJECTED] << "\n";
+            oss << "best  : " << ((_best < mtools::INF) ? (mtools::doubleToStringHighPrecision(_best) + " [" + _bestname + "]") : std::string("none")) << "\n";
+            oss << "rate  : " << mtools::doubleToStringNice(_rate()) << " tours lifted per hour\n\n";
+            for (auto& R : _running)
+                {
+                oss << _entry[R.entry].name << " (score " << mtools::doubleToStringHighPrecision(_entry[R.entry].tour_score) << ", " << R.ch.elapsed() / 1000 << "s)\n";
+                oss << R.session->toString() << "\n";
+                }
+            return oss.toString();
+            }
+
+
+        /**
+        * The summary table: one line per tour (in queue order).
+        **/
+        std::string summary() const
+            {
+            static const char* SN[NB_STATUS] = { "queued", "running", "lifted", "cancelled", "rejected" };
+            mtools::ostringstream oss;
+            oss << "rank |       tour score | difficulty |    status |   solution score |  time(s) | file\n";
+            for (size_t i = 0; i < _entry.size(); i++)
+                {
+                const Entry& E = _entry[i];
+                oss << justify_right(mtools::toString(i + 1), 4) << " | "
+                    << justify_right((E.tour_score < mtools::INF) ? mtools::doubleToStringHighPrecision(E.tour_score) : std::string("-"), 16) << " | "
+                    << justify_right((E.difficulty < mtools::INF) ? mtools::doubleToStringNice(E.difficulty) : std::string("-"), 10) << " | "
+                    << justify_right(SN[E.status], 9) << " | "
+                    << justify_right((E.sol_score < mtools::INF) ? mtools::doubleToStringHighPrecision(E.sol_score) : std::string("-"), 16) << " | "
+                    << justify_right(mtools::doubleToStringNice(((int)(E.time * 10)) / 10.0), 8) << " | "
+                    << E.name << ((E.note.size() > 0) ? (" : " + E.note) : std::string("")) << "\n";
+                }
+            oss << "best solution : " << ((_best < mtools::INF) ? (mtools::doubleToStringHighPrecision(_best) + " [" + _bestname + "]") : std::string("none")) << "\n";
+            oss << "elapsed : " << _ch.elapsed() / 1000 << "s   rate : " << mtools::doubleToStringNice(_rate()) << " tours lifted per hour\n";
+            return oss.toString();
+            }
+
+
+        /**
+        * Write the summary table in [outdir]/batch_summary.txt.
+        **/
+        void saveSummary() const
+            {
+            const std::string fn = (std::filesystem::path(_outdir) / "batch_summary.txt").string();
+            const std::string S = summary();
+            FILE* f = fopen(fn.c_str(), "wb");
+            if (f == nullptr) { MTOOLS_ERROR(std::string("BatchLift::saveSummary(): ERROR, CANNOT WRITE: ") + fn); }
+            const bool ok = (fwrite(S.data(), 1, S.size(), f) == S.size());
+            if ((fclose(f) != 0) || (!ok)) { MTOOLS_ERROR(std::string("BatchLift::saveSummary(): ERROR, CANNOT WRITE: ") + fn); }
+            }
+
+
+    private:
+
+
+        enum Status { QUEUED = 0, RUNNING, LIFTED, CANCELLED, REJECTED, NB_STATUS };
+
+
+        /** a tour of the batch */
+        struct Entry
+            {
+            std::string     filename;
+            std::string     name;           // file name without the directory
+            double          tour_score;     // score of the pixel tour (lower bound for the lift)
+            double          difficulty;     // from the prescreen (0 if none)
+            Status          status;
+            std::string     note;           // why the tour was rejected or cancelled
+            double          sol_score;      // score of the solution (INF if not lifted)
+            double          time;           // time spent lifting (s)
+            };
+
+
+        /** a tour being lifted */
+        struct Running
+            {
+            size_t                          entry;      // index in _entry
+            std::unique_ptr<LiftSession>    session;
+            Chrono                          ch;         // time since the start of the lift
+            };
+
+
+        /** the tour cannot improve on the best solution */
+        bool _useless(const Entry& E) const
+            {
+            return (_best < mtools::INF) && (E.tour_score > _best + _margin);
+            }
+
+
+        /** prefix of the files of a tour */
+        std::string _basename(const Entry& E) const
+            {
+            return (std::filesystem::path(_outdir) / E.name).string();
+            }
+
+
+        /** split the threads evenly between the running sessions */
+        void _share()
+            {
+            const int n = (int)_running.size();
+            for (int k = 0; k < n; k++) _running[k].session->setThreads(_nb_threads / n + ((k < _nb_threads % n) ? 1 : 0));
+            }
+
+
+        /** number of tours lifted per hour */
+        double _rate() const
+            {
+            int n = 0;
+            for (auto& E : _entry) { if (E.status == LIFTED) n++; }
+            const double h = _ch.elapsed() / 3600000.0;
+            return (h > 0) ? (n / h) : 0.0;
+            }
+
+
+        std::string             _dir;           // directory of the tours
+        std::string             _outdir;        // directory of the results
+        int                     _nb_threads;    // thread budget
+        MT2004_64               _gen;           // RNG used to seed the sessions
+        int                     _concurrency;   // max number of sessions
+        double                  _margin;        // cancel margin
+        int                     _max_time;      // time limit per tour (s, 0 = none)
+        Prescreen               _prescreen;     // difficulty of a tour
+        double                  _max_difficulty;
+        std::function<void(TreeSearch&)> _setup; // called on each new search
+        Heuristic               _fun;           // heuristic used by all the searches
+        bool                    _prepassed;
+        bool                    _started;
+        std::vector<Entry>      _entry;         // the tours, by score
+        size_t                  _next;          // first entry that may still be queued
+        std::vector<Running>    _running;       // the sessions
+        double                  _best;          // best solution score
+        std::string             _bestname;      // and its tour
+        Chrono                  _ch;            // time since start()
+    };
+
+
+
+/** end of file */
@@ -0,0 +1,259 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include "TreeSearch.h"
+
+
+
+/**
+* Result of a single benchmark run.
+**/
+struct BenchResult
+    {
+    uint64  seed;       // seed of the RNG
+    bool    solved;     // true if the tour was lifted before the time limit
+    double  time_sec;   // time used (= time limit if not solved)
+    int     bestpos;    // maximum position reached
+    int64   nbsteps;    // number of steps performed
+    };
+
+
+
+/**
+* Run one search per seed with a given heuristic and record the time needed to
+* obtain a lossless lift (or the maximum position reached when the time limit
+* is hit). Runs are performed one after the other so they do not compete for
+* the cores.
+**/
+template<typename HEURISTIC>
+std::vector<BenchResult> benchHeuristic(const std::vector<iVec2>& tour, HEURISTIC fun, const std::vector<uint64>& seeds, double max_sec)
+    {
+    std::vector<BenchResult> res;
+    for (auto seed : seeds)
+        {
+        MT2004_64 gen(seed);
+        TreeSearch TS(tour, gen);
+        Chrono ch;
+        ch.reset();
+        TS.search(fun);
+        while ((!TS.solved()) && (ch.elapsed() < 1000 * max_sec))
+            {
+            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+            }
+        const double t = ch.elapsed() / 1000.0;
+        TS.stopSearch();
+        BenchResult r;
+        r.seed = seed;
+        r.solved = TS.solved();
+        r.time_sec = (r.solved) ? t : max_sec;
+        r.bestpos = TS.bestpos();
+        r.nbsteps = TS.nbsteps();
+        res.push_back(r);
+        }
+    return res;
+    }
+
+
+
+/**
+* Print the result of a benchmark (one line per seed and a summary line).
+**/
+inline std::string benchToString(const std::string& name, const std::vector<BenchResult>& res)
+    {
+    mtools::ostringstream oss;
+    oss << "--- " << name << " ---\n";
+    oss << "seed       | solved | time (s) | maxpos | nb steps\n";
+    double tot = 0;
+    int nbsolved = 0;
+    for (auto& r : res)
+        {
+        oss << justify_left(mtools::toString(r.seed), 11) << "| "
+            << justify_left((r.solved ? "yes" : "no"), 7) << "| "
+            << justify_right(mtools::doubleToStringNice(r.time_sec), 8) << " | "
+            << justify_right(mtools::toString(r.bestpos), 6) << " | "
+            << mtools::toString(r.nbsteps) << "\n";
+        tot += r.time_sec;
+        if (r.solved) nbsolved++;
+        }
+    oss << "solved " << nbsolved << " / " << res.size() << "   mean time (s) : " << mtools::doubleToStringNice((res.size() > 0) ? (tot / res.size()) : 0.0) << "\n\n";
+    return oss.toString();
+    }
+
+
+
+/**
+* Result of a scaling run.
+**/
+struct ScalingResult
+    {
+    int     nbthreads;      // number of concurrent searches
+    double  steps_per_sec;  // total number of steps per second
+    double  efficiency;     // steps per second per thread relative to a single thread
+    };
+
+
+
+/**
+* Measure the total number of search steps per second when running 1, 2, 4, ...
+* up to max_threads searches concurrently (one thread each) for 'sec' seconds.
+* Run k always uses the seeds seed, seed+1, ..., seed+k-1 so the searches are
+* comparable from one run to the next.
+**/
+template<typename HEURISTIC>
+std::vector<ScalingResult> benchScaling(const std::vector<iVec2>& tour, HEURISTIC fun, int max_threads, double sec, uint64 seed = 1)
+    {
+    std::vector<ScalingResult> res;
+    std::vector<int> nbs;
+    for (int k = 1; k < max_threads; k *= 2) nbs.push_back(k);
+    nbs.push_back(max_threads);
+    auto PT = PixelTour::make(tour); // shared by all the searches
+    for (int k : nbs)
+        {
+        std::vector<std::unique_ptr<MT2004_64>> gens;
+        std::vector<std::unique_ptr<TreeSearch>> TS;
+        for (int i = 0; i < k; i++)
+            {
+            gens.emplace_back(new MT2004_64(seed + i));
+            TS.emplace_back(new TreeSearch(PT, *gens.back()));
+            }
+        Chrono ch;
+        ch.reset();
+        for (int i = 0; i < k; i++) TS[i]->search(fun);
+        std::this_thread::sleep_for(std::chrono::milliseconds((int64)(1000 * sec)));
+        for (int i = 0; i < k; i++) TS[i]->stopSearch();
+        const double t = ch.elapsed() / 1000.0;
+        int64 tot = 0;
+        for (int i = 0; i < k; i++) tot += TS[i]->nbsteps();
+        ScalingResult r;
+        r.nbthreads = k;
+        r.steps_per_sec = tot / t;
+        r.efficiency = (res.size() == 0) ? 1.0 : ((r.steps_per_sec / k) / res[0].steps_per_sec);
+        res.push_back(r);
+        }
+    return res;
+    }
+
+
+
+/**
+* Print the result of a scaling benchmark.
+**/
+inline std::string scalingToString(const std::string& name, const std::vector<ScalingResult>& res)
+    {
+    mtools::ostringstream oss;
+    oss << "--- " << name << " ---\n";
+    oss << "threads | steps / sec | efficiency\n";
+    for (auto& r : res)
+        {
+        oss << justify_right(mtools::toString(r.nbthreads), 7) << " | "
+            << justify_right(mtools::toString((int64)r.steps_per_sec), 11) << " | "
+            << mtools::doubleToStringNice(((int)(1000 * r.efficiency)) / 10.0) << "%\n";
+        }
+    oss << "\n";
+    return oss.toString();
+    }
+
+
+
+/**
+* Result of the distcol() micro-benchmark.
+**/
+struct DistcolResult
+    {
+    int64   nbcalls;        // number of calls of each version
+    double  ns_planar;      // time per call reading the three planar double arrays
+    double  ns_packed;      // time per call with the packed table (pixel ids)
+    double  ns_distim;      // time per call of distim() (table of square roots + packed colors)
+    int64   nbdiff;         // number of results that differ (must be 0)
+    };
+
+
+
+/**
+* Compare distcol() with the packed color table against the computation from
+* the three planar arrays imR, imG, imB. The pairs of pixels are random
+* neighbours at L1 distance at most 8 (as in ArmToPixel and score()). Also
+* check and time distim().
+**/
+inline DistcolResult benchDistcol(int64 nbcalls = 20000000, uint64 seed = 1)
+    {
+    const int NP = 1 << 16;
+    MT2004_64 gen(seed);
+    std::vector<int> id1(NP), id2(NP);
+    for (int i = 0; i < NP; i++)
+        {
+        const int x = (int)Unif_int(-SANTA_IMAGE_CX + 8, SANTA_IMAGE_CX - 8, gen);
+        const int y = (int)Unif_int(-SANTA_IMAGE_CY + 8, SANTA_IMAGE_CY - 8, gen);
+        const int dx = (int)Unif_int(-4, 4, gen);
+        const int dy = (int)Unif_int(-4, 4, gen);
+        id1[i] = coord2id({ x, y });
+        id2[i] = coord2id({ x + dx, y + dy });
+        }
+    DistcolResult r;
+    r.nbcalls = nbcalls;
+    r.nbdiff = 0;
+    for (int i = 0; i < NP; i++)
+        {
+        const int a1 = id1[i], a2 = id2[i];
+        const double p = 3 * (fabs(imR[a1] - imR[a2]) + fabs(imG[a1] - imG[a2]) + fabs(imB[a1] - imB[a2]));
+        if (p != distcol(a1, a2)) r.nbdiff++;
+        }
+    Chrono ch;
+    double s1 = 0;
+    ch.reset();
+    for (int64 k = 0; k < nbcalls; k++)
+        {
+        const int a1 = id1[k & (NP - 1)], a2 = id2[k & (NP - 1)];
+        s1 += 3 * (fabs(imR[a1] - imR[a2]) + fabs(imG[a1] - imG[a2]) + fabs(imB[a1] - imB[a2]));
+        }
+    r.ns_planar = 1000000.0 * ch.elapsed() / nbcalls;
+    double s2 = 0;
+    ch.reset();
+    for (int64 k = 0; k < nbcalls; k++)
+        {
+        s2 += distcol(id1[k & (NP - 1)], id2[k & (NP - 1)]);
+        }
+    r.ns_packed = 1000000.0 * ch.elapsed() / nbcalls;
+    if (s1 != s2) r.nbdiff++; // also keeps the loops from being optimized away
+    std::vector<iVec2> P1(NP), P2(NP);
+    for (int i = 0; i < NP; i++)
+        {
+        P1[i] = id2coord(id1[i] + 1);
+        P2[i] = id2coord(id2[i] + 1);
+        const int l1 = (int)(abs(P2[i].X() - P1[i].X()) + abs(P2[i].Y() - P1[i].Y()));
+        if (distim(P1[i], P2[i]) != sqrt((double)l1) + distcol(id1[i], id2[i])) r.nbdiff++;
+        }
+    double s3 = 0;
+    ch.reset();
+    for (int64 k = 0; k < nbcalls; k++)
+        {
+        s3 += distim(P1[k & (NP - 1)], P2[k & (NP - 1)]);
+        }
+    r.ns_distim = 1000000.0 * ch.elapsed() / nbcalls;
+    if (s3 < 0) r.nbdiff++;
+    return r;
+    }
+
+
+
+/**
+* Print the result of the distcol() micro-benchmark.
+**/
+inline std::string distcolToString(const DistcolResult& r)
+    {
+    mtools::ostringstream oss;
+    oss << "--- distcol ---\n";
+    oss << "calls          : " << r.nbcalls << "\n";
+    oss << "planar arrays  : " << mtools::doubleToStringNice(r.ns_planar) << " ns / call\n";
+    oss << "packed table   : " << mtools::doubleToStringNice(r.ns_packed) << " ns / call\n";
+    oss << "distim         : " << mtools::doubleToStringNice(r.ns_distim) << " ns / call\n";
+    oss << "differences    : " << r.nbdiff << "\n\n";
+    return oss.toString();
+    }
+
+
+
+/** end of file */
@@ -0,0 +1,504 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include <unordered_map>
+
+#include "Arm.h"
+#include "PotSon.h"
+#include "LKHtour.h"
+#include "TreeSearch.h"
+#include "BridgeSearch.h"
+
+
+
+/**
+* Index of the arm configurations reached by the forward and backward searches
+* at a few indices in the middle of a tour.
+*
+* For each meeting point m, the forward searches publish the configurations
+* they reach at index m and the backward searches those they reach at index
+* m + gap. Each new configuration is compared with those of the other side at
+* the same meeting point: when the angular distance between the two arms is
+* compatible with the number of moves available in the gap, a short depth
+* first search looks for a lossless bridge between them. On success, the two
+* half paths and the bridge are joined into a full lossless lift.
+* (with gap = 0 the two configurations must simply be equal).
+*
+* Indices are always given in the forward numbering (0 = start of the tour).
+* Each entry keeps a copy of the path leading to it together with its last
+* configuration: the paths are shared by all the search threads and an ArmPath
+* cannot be read concurrently (its decoding cache is mutable) so they are only
+* read under the lock, while the last configurations are read freely. The
+* number of paths kept per side is bounded; when full, a random entry is
+* evicted.
+**/
+class MeetIndex
+    {
+
+    public:
+
+
+        /**
+        * Ctor.
+        *
+        * tour      : the tour (forward direction).
+        * nb_meet   : number of meeting points (spread over the middle half of the tour).
+        * gap       : number of steps between the forward and backward meeting indices.
+        * max_paths : maximum number of paths kept on each side.
+        * seed      : seed of the RNG used for the eviction.
+        **/
+        MeetIndex(const std::vector<iVec2>& tour, int nb_meet, int gap, int max_paths, uint64 seed) : _tour(tour), _gen(seed), _gap(gap), _max_paths(max_paths), _solved(false), _nbmatch_tests(0), _nbbridges(0)
+            {
+            const int N = (int)tour.size() - 1;
+            if (nb_meet < 1) nb_meet = 1;
+            if (_gap < 0) _gap = 0;
+            if (_max_paths < 1) _max_paths = 1;
+            MTOOLS_INSURE(N >= _gap + 2);
+            _slot[0].assign(tour.size(), -1);
+            _slot[1].assign(tour.size(), -1);
+            const int spacing = std::max(1, N / (2 * nb_meet));
+            for (int k = 0; k < nb_meet; k++)
+                {
+                int m = N / 2 - _gap / 2 + (k - nb_meet / 2) * spacing;
+                if (m < 1) m = 1;
+                if (m + _gap > N - 1) m = N - 1 - _gap;
+                if (_slot[0][m] >= 0) continue;
+                _slot[0][m] = (int)_meet.size();
+                _slot[1][m + _gap] = (int)_meet.size();
+                _meet.push_back(m);
+                }
+            for (int s = 0; s < 2; s++) _map[s].resize(_meet.size());
+            }
+
+
+        /**
+        * Register that a search reached configuration 'a' at (forward) index i with
+        * the path 'path' (path[0] is the start of that side, 'a' is not yet in it).
+        * potson is a scratch object of the calling search used for the bridge
+        * searches (its list of sons is overwritten). The candidates of the other
+        * side are collected under the lock but the bridges are searched outside.
+        **/
+        void publish(bool backward, int i, Arm a, const ArmPath& path, PotSon& potson)
+            {
+            const int side = (backward) ? 1 : 0;
+            if ((i < 0) || (i >= (int)_tour.size()) || (_slot[side][i] < 0)) return;
+            if ((bool)_solved) return;
+            const int k = _slot[side][i];
+            std::vector<Entry> cand; // entries of the other side to try
+                {
+                std::lock_guard<std::mutex> lock(_mut);
+                if ((bool)_solved) return;
+                if (_map[side][k].find(a.val()) != _map[side][k].end()) return; // already known (and already checked).
+                _candidates(side, k, a, cand);
+                }
+            auto Q = std::make_shared<ArmPath>(path); // shares the blocks of the search path
+            Q->push_back(a);
+            Q->pack();
+            const Entry P = { a, Q };
+            _nbmatch_tests++;
+                {
+                std::lock_guard<std::mutex> lock(_mut);
+                if ((bool)_solved) return;
+                auto& M = _map[side][k];
+                if (M.find(a.val()) != M.end()) return; // added meanwhile by another search.
+                if ((int)_keys[side].size() >= _max_paths)
+                    { // evict a random entry.
+                    const size_t r = (size_t)Unif_int(0, (int64)_keys[side].size() - 1, _gen);
+                    const auto key = _keys[side][r];
+                    _map[side][key.first].erase(key.second);
+                    _keys[side][r] = _keys[side].back();
+                    _keys[side].pop_back();
+                    }
+                M[a.val()] = P;
+                _keys[side].push_back({ k, a.val() });
+                }
+            _match(side, k, P, cand, potson);
+            }
+
+
+        /**
+        * Query if the two sides have met.
+        **/
+        bool solved() const
+            {
+            return (bool)_solved;
+            }
+
+
+        /**
+        * The full path (empty until solved).
+        **/
+        std::vector<Arm> path()
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            return _path;
+            }
+
+
+        /**
+        * Number of paths currently kept on each side.
+        **/
+        int nbEntries(bool backward)
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            return (int)_keys[(backward) ? 1 : 0].size();
+            }
+
+
+        /**
+        * Number of distinct configurations checked against the other side.
+        **/
+        int64 nbTests() const
+            {
+            return (int64)_nbmatch_tests;
+            }
+
+
+        /**
+        * Number of bridge searches performed (pairs that passed the distance filter).
+        **/
+        int64 nbBridges() const
+            {
+            return (int64)_nbbridges;
+            }
+
+
+        /**
+        * The forward meeting indices.
+        **/
+        const std::vector<int>& meetIndices() const
+            {
+            return _meet;
+            }
+
+
+    private:
+
+
+        /** a published configuration and the (packed) path leading to it */
+        struct Entry
+            {
+            Arm                             last;   // last configuration of the path (read without the lock)
+            std::shared_ptr<const ArmPath>  path;   // only read under the lock
+            };
+
+
+        /**
+        * Collect the entries of the other side at meeting point k that may be joined
+        * with a (equal when gap = 0, compatible distance otherwise). Called with the
+        * lock held.
+        **/
+        void _candidates(int side, int k, Arm a, std::vector<Entry>& cand)
+            {
+            auto& O = _map[1 - side][k];
+            if (O.size() == 0) return;
+            if (_gap == 0)
+                {
+                auto it = O.find(a.val());
+                if (it != O.end()) cand.push_back(it->second);
+                return;
+                }
+            const int m = _meet[k];
+            const int moves = BridgeSearch::moves(_tour, m, m + _gap);
+            for (auto& e : O)
+                {
+                if (BridgeSearch::compatible(a, e.second.last, moves)) cand.push_back(e.second);
+                }
+            }
+
+
+        /**
+        * Try to join the new entry P at meeting point k with the candidates of the
+        * other side. The bridges are searched without the lock (from the last
+        * configurations only), the paths are decoded under it.
+        **/
+        void _match(int side, int k, const Entry& P, const std::vector<Entry>& cand, PotSon& potson)
+            {
+            const int m = _meet[k];
+            for (auto& C : cand)
+                {
+                if ((bool)_solved) return;
+                const Entry& FP = (side == 0) ? P : C;
+                const Entry& BP = (side == 0) ? C : P;
+                std::vector<Arm> bridge;
+                if (_gap > 0)
+                    {
+                    _nbbridges++;
+                    if (!BridgeSearch::find(_tour, FP.last, m, BP.last, m + _gap, bridge, potson)) continue;
+                    }
+                std::lock_guard<std::mutex> lock(_mut);
+                if (!(bool)_solved) _join(FP.path->toVector(), bridge, BP.path->toVector());
+                return;
+                }
+            }
+
+
+        /**
+        * Join a forward path F (indices 0..m), the bridge (indices m+1..m+gap-1) and
+        * a backward path B (whose last arm is at index m+gap).
+        **/
+        void _join(const std::vector<Arm>& F, const std::vector<Arm>& bridge, const std::vector<Arm>& B)
+            {
+            const int N = (int)_tour.size() - 1;
+            std::vector<Arm> V(F);
+            V.insert(V.end(), bridge.begin(), bridge.end());
+            const int j = (int)V.size(); // first index taken from B
+            MTOOLS_INSURE(N - j == (int)B.size() - 1 - ((_gap == 0) ? 1 : 0));
+            for (int x = j; x <= N; x++) V.push_back(B[N - x]);
+            MTOOLS_INSURE(V.size() == _tour.size());
+            for (size_t k = 0; k < V.size(); k++)
+                {
+                MTOOLS_INSURE(V[k].pos() == _tour[k]);
+                if (k > 0) { MTOOLS_INSURE(lossL1(V[k - 1], V[k]) < 0.0000001); }
+                }
+            _path = V;
+            _solved = true;
+            }
+
+
+        const std::vector<iVec2>    _tour;          // the tour (forward direction)
+        MT2004_64                   _gen;           // RNG for the eviction
+        int                         _gap;           // distance between the forward and the backward meeting index
+        int                         _max_paths;     // maximum number of paths per side
+
+        std::vector<int>            _slot[2];       // meeting point of each index for each side (-1 if none)
+        std::vector<int>            _meet;          // forward meeting indices
+        std::vector<std::unordered_map<uint64_t, Entry>> _map[2];   // entries of each side for each meeting point
+        std::vector<std::pair<int, uint64_t>> _keys[2];     // list of the entries of each side (for the eviction)
+
+        std::mutex                  _mut;
+        std::vector<Arm>            _path;          // full path once solved
+        std::atomic<bool>           _solved;
+        std::atomic<int64>          _nbmatch_tests;
+        std::atomic<int64>          _nbbridges;
+    };
+
+
+
+
+/**
+* Wrapper around a heuristic that publishes the configurations reached at the
+* meeting indices. The wrapped heuristic is called unchanged.
+**/
+template<typename HEURISTIC> class MeetHeuristic
+    {
+
+    public:
+
+        MeetHeuristic(HEURISTIC fun, std::shared_ptr<MeetIndex> index, int N, bool backward) : _fun(fun), _index(index), _N(N), _backward(backward)
+            {
+            }
+
+
+        Arm operator()(int n, Arm arm, iVec2 target, PotSon& potson, bool backtracked, TreeSearch* TS)
+            {
+            const Arm a = _fun(n, arm, target, potson, backtracked, TS);
+            const int i = (_backward) ? (_N - (n + 1)) : (n + 1); // forward index of the new arm
+            _index->publish(_backward, i, a, TS->currentPathRef(), potson); // the sons are not needed anymore: potson is reused for the bridges.
+            return a;
+            }
+
+    private:
+
+        HEURISTIC _fun;
+        std::shared_ptr<MeetIndex> _index;
+        int _N;
+        bool _backward;
+    };
+
+
+
+
+/**
+* Lift a segment from both ends at once.
+*
+* Several TreeSearch objects run forward from the start of the tour and several
+* run backward from its end (on the reversed tour). Both ends must be the
+* origin or a corner. The configurations reached at a few middle indices are
+* shared through a MeetIndex and the search is solved as soon as a forward
+* and a backward configuration meet. Each search only has to sustain about
+* half the depth of the segment.
+*
+* Only lossless lifts are produced (do not push exceptions to the searches).
+**/
+class BidirSearch
+    {
+
+    public:
+
+
+        /**
+        * Ctor.
+        *
+        * tour        : the tour to lift.
+        * gen         : RNG used to seed the searches.
+        * nb_forward  : number of searches starting from tour[0].
+        * nb_backward : number of searches starting from the end of the tour.
+        * nb_meet     : number of meeting points.
+        * gap         : number of steps bridged between a forward and a backward configuration.
+        * max_paths   : maximum number of paths kept on each side of the index.
+        **/
+        BidirSearch(const std::vector<iVec2>& tour, MT2004_64& gen, int nb_forward = 2, int nb_backward = 2, int nb_meet = 8, int gap = 8, int max_paths = 256) : _tour(tour), _rtour(getReversed(tour))
+            {
+            MTOOLS_INSURE(nb_forward > 0);
+            MTOOLS_INSURE(nb_backward > 0);
+            _index = std::make_shared<MeetIndex>(_tour, nb_meet, gap, max_paths, Unif_64(gen));
+            auto F = PixelTour::make(_tour);
+            auto B = PixelTour::make(_rtour);
+            for (int i = 0; i < nb_forward + nb_backward; i++)
+                {
+                _gens.emplace_back(new MT2004_64(Unif_64(gen) + i));
+                _ts.emplace_back(new TreeSearch((i < nb_forward) ? F : B, *(_gens.back())));
+                _backward.push_back(i >= nb_forward);
+                }
+            }
+
+
+        /**
+        * Dtor.
+        **/
+        ~BidirSearch()
+            {
+            stopSearch();
+            }
+
+
+        /**
+        * Direct access to one of the searches (to set its parameters).
+        **/
+        TreeSearch& instance(int i)
+            {
+            return *(_ts[i]);
+            }
+
+
+        /**
+        * Number of searches.
+        **/
+        int nbInstances() const
+            {
+            return (int)_ts.size();
+            }
+
+
+        /**
+        * True if search i runs backward.
+        **/
+        bool isBackward(int i) const
+            {
+            return _backward[i];
+            }
+
+
+        /**
+        * Start all the searches with the same heuristic.
+        **/
+        template<typename HEURISTIC> void search(HEURISTIC fun)
+            {
+            const int N = (int)_tour.size() - 1;
+            for (size_t i = 0; i < _ts.size(); i++)
+                {
+                _ts[i]->search(MeetHeuristic<HEURISTIC>(fun, _index, N, _backward[i]));
+                }
+            }
+
+
+        /**
+        * Stop all the searches.
+        **/
+        void stopSearch()
+            {
+            for (auto& ts : _ts) ts->stopSearch();
+            }
+
+
+        /**
+        * Query if the segment is lifted (the two sides met or one side went all the way).
+        **/
+        bool solved()
+            {
+            if (_index->solved()) return true;
+            for (auto& ts : _ts) { if (ts->solved()) return true; }
+            return false;
+            }
+
+
+        /**
+        * Full path if solved, otherwise the best forward path.
+        **/
+        std::vector<Arm> bestPath()
+            {
+            if (_index->solved()) return _index->path();
+            int ib = -1;
+            for (size_t i = 0; i < _ts.size(); i++)
+                {
+                if (_ts[i]->solved())
+                    {
+                    auto V = _ts[i]->bestPath();
+                    return (_backward[i]) ? getReversed(V) : V;
+                    }
+                if ((!_backward[i]) && ((ib < 0) || (_ts[i]->bestpos() > _ts[ib]->bestpos()))) ib = (int)i;
+                }
+            return _ts[ib]->bestPath();
+            }
+
+
+        /**
+        * Save the path returned by bestPath() (same format as TreeSearch::save()).
+        **/
+        std::string save(std::string filename)
+            {
+            saveSolution(bestPath(), filename.c_str(), false);
+            return filename;
+            }
+
+
+        /**
+        * Print formattted info about the searches (one line per search and a summary).
+        **/
+        std::string toString()
+            {
+            mtools::ostringstream oss;
+            for (size_t i = 0; i < _ts.size(); i++)
+                {
+                oss << ((_backward[i]) ? "B " : "F ") << _ts[i]->toString();
+                }
+            oss << "meet at " << _index->meetIndices().front() << ".." << _index->meetIndices().back()
+                << "  paths F/B : " << _index->nbEntries(false) << " / " << _index->nbEntries(true)
+                << "  tests : " << _index->nbTests() << "  bridges : " << _index->nbBridges() << "\n";
+            return oss.toString();
+            }
+
+
+        /**
+        * Header for the toString function
+        **/
+        std::string header()
+            {
+            return "  " + _ts[0]->header();
+            }
+
+
+        std::string hrule()
+            {
+            return "  " + _ts[0]->hrule();
+            }
+
+
+    private:
+
+        std::vector<iVec2>  _tour;      // the tour
+        std::vector<iVec2>  _rtour;     // the reversed tour
+
+        std::shared_ptr<MeetIndex>                  _index;
+        std::vector<std::unique_ptr<MT2004_64>>     _gens;
+        std::vector<std::unique_ptr<TreeSearch>>    _ts;
+        std::vector<bool>                           _backward;
+    };
+
+
+
+/** end of file */
@@ -0,0 +1,111 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include "Arm.h"
+#include "PotSon.h"
+#include "distanceArm.h"
+
+
+
+/**
+* Short lossless bridges between two arm configurations.
+*
+* Used to join two partial lifts of the same tour: 'a' at index x and 'b' at
+* index end must be linked by lossless moves following tour[x+1], ...,
+* tour[end-1]. The angular distance between the arms bounds the number of
+* moves needed, which prunes the depth first search.
+**/
+class BridgeSearch
+    {
+
+    public:
+
+        static constexpr int MAX_NODES = 20000; // maximum number of nodes visited by a bridge search.
+
+
+        /**
+        * Sum over the arms of the angular distances between a and b.
+        **/
+        static int dist(const Arm& a, const Arm& b)
+            {
+            int d = 0;
+            for (int j = 0; j < Arm::NB_ARMS; j++) d += dtorus(a.angle(j), b.angle(j), 8 * a.lenArm(j));
+            return d;
+            }
+
+
+        /**
+        * Number of arm moves available between index x and index end of the tour.
+        **/
+        static int moves(const std::vector<iVec2>& tour, int x, int end)
+            {
+            int m = 0;
+            for (int i = x; i < end; i++) { const iVec2 D = tour[i + 1] - tour[i]; m += (int)(abs(D.X()) + abs(D.Y())); }
+            return m;
+            }
+
+
+        /**
+        * Query if b may be reached from a with exactly 'moves' arm moves.
+        **/
+        static bool compatible(const Arm& a, const Arm& b, int moves)
+            {
+            const int d = dist(a, b);
+            return ((d <= moves) && (((moves - d) & 1) == 0));
+            }
+
+
+        /**
+        * Look for a lossless path from 'a' at index x to 'b' at index 'end' of the
+        * tour. On success, return true and set 'bridge' to the arms strictly
+        * between the two ends. potson is used as scratch.
+        **/
+        static bool find(const std::vector<iVec2>& tour, const Arm& a, int x, const Arm& b, int end, std::vector<Arm>& bridge, PotSon& potson)
+            {
+            bridge.clear();
+            const int m = moves(tour, x, end);
+            if (!compatible(a, b, m)) return false;
+            int nodes = 0;
+            return _dfs(tour, a, x, b, end, m, bridge, nodes, potson);
+            }
+
+
+    private:
+
+
+        /**
+        * Depth first search. 'moves' is the number of arm moves left.
+        **/
+        static bool _dfs(const std::vector<iVec2>& tour, const Arm& a, int x, const Arm& b, int end, int moves, std::vector<Arm>& bridge, int& nodes, PotSon& potson)
+            {
+            if (x + 1 == end)
+                {
+                return (lossL1(a, b) < 0.0000001);
+                }
+            if (++nodes > MAX_NODES) return false;
+            const iVec2 D = tour[x + 1] - tour[x];
+            const int left = moves - (int)(abs(D.X()) + abs(D.Y()));
+            potson.clear();
+            potson.add(a, tour[x + 1], 0);
+            std::vector<Arm> sons;
+            for (int i = 0; i < potson.size(); i++)
+                {
+                if (compatible(potson[i], b, left)) sons.push_back(potson[i]);
+                }
+            for (auto& s : sons)
+                {
+                bridge.push_back(s);
+                if (_dfs(tour, s, x + 1, b, end, left, bridge, nodes, potson)) return true;
+                bridge.pop_back();
+                }
+            return false;
+            }
+
+    };
+
+
+
+/** end of file */
@@ -0,0 +1,179 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include "Arm.h"
+#include "PotSon.h"
+#include "cutTime.h"
+#include "TreeSearch.h"
+
+
+
+/**
+* Heuristic for TreeSearch::search() that looks at the upcoming cut times.
+*
+* For each large arm k (NB_ARMS - 1, ... down to 'min_arm'), we compute the
+* next time the tour enters the half plane (relative to the center of the box of
+* arm k) that the arm currently cannot reach. The CutTime tells us in which
+* direction the arm must rotate before that time. Sons that rotate the arm in
+* that direction get a larger weight, those rotating it the other way a
+* smaller one. The bias grows with the ratio between the rotation still needed
+* and the number of steps left before the crossing and is damped when the tour
+* itself moves mostly in the good direction (good vs bad moves of the cut).
+*
+* The object is copied into each search thread so every instance has its own
+* cache of cut times.
+**/
+class CutHeuristic
+    {
+
+    public:
+
+
+        /**
+        * Ctor.
+        *
+        * strength : maximum multiplicative bias of a single arm.
+        * min_arm  : smallest arm that is biased (arms min_arm..NB_ARMS-1 are considered).
+        **/
+        CutHeuristic(double strength = 50.0, int min_arm = 5) : _strength(strength), _min_arm(min_arm), _cut(Arm::NB_ARMS, CutTime(-1, -1, -1, -1, 0, 0, 0))
+            {
+            if (_min_arm < 3) _min_arm = 3; // anglesToReach() and cut times make no sense for small arms.
+            if (_min_arm > Arm::NB_ARMS - 1) _min_arm = Arm::NB_ARMS - 1;
+            for (int k = 0; k < Arm::NB_ARMS; k++) _invalidate(k);
+            }
+
+
+        /**
+        * Choose the next son. Same signature as the heuristics used by TreeSearch::search().
+        **/
+        Arm operator()(int n, Arm arm, iVec2, PotSon& potson, bool, TreeSearch* TS)
+            {
+            const PixelTour& tour = TS->tour();
+
+            // compute the preferred direction and the bias for each large arm.
+            int dir[Arm::NB_ARMS];
+            double boost[Arm::NB_ARMS];
+            for (int k = Arm::NB_ARMS - 1; k >= _min_arm; k--)
+                {
+                dir[k] = 0;
+                boost[k] = 1.0;
+                const CutTime & C = _nextCut(k, n, arm, tour);
+                if (C.sign == 0) continue; // no crossing within the horizon
+                const int dist = C.n1 - n;
+                if (dist <= 0) continue;
+                const double need = (double)rotationNeeded(arm, k, C.sign);
+                const double slack = ((double)(C.good - C.bad)) / ((double)(C.n1 - C.n0)); // in [-1,1]
+                double u = (need / dist) * (1.0 - 0.5 * slack);
+                if (u < 0) u = 0;
+                if (u > 1) u = 1;
+                dir[k] = C.sign;
+                boost[k] = 1.0 + _strength * u;
+                }
+
+            // weight the sons
+            const int ns = potson.size();
+            if ((int)_w.size() < ns) _w.resize(ns);
+            double* w = _w.data();
+            double tot = 0;
+            for (int i = 0; i < ns; i++)
+                {
+                const Arm a = potson[i] - arm;
+                double x = 1.0;
+                for (int k = Arm::NB_ARMS - 1; k >= _min_arm; k--)
+                    {
+                    if (dir[k] == 0) continue;
+                    const int d = _stepDir(a, k);
+                    if (d == dir[k]) x *= boost[k]; else if (d == -dir[k]) x /= boost[k];
+                    }
+                tot += x;
+                w[i] = tot;
+                }
+            for (int i = 0; i < ns; i++)
+                {
+                w[i] /= tot;
+                }
+            return potson.choice(w);
+            }
+
+
+        /**
+        * Half plane that arm k cannot reach, seen from the center of its box.
+        * (encoded as in timeEnter(): 0 = bottom side, 1 = right, 2 = top, 3 = left).
+        **/
+        static int halfPlane(const Arm& arm, int k)
+            {
+            const int l = arm.lenArm(k);
+            return arm.angle(k) / (2 * l);
+            }
+
+
+        /**
+        * Number of rotation steps (in direction sign) for arm k to leave its current
+        * side of the square and pass the corner.
+        **/
+        static int rotationNeeded(const Arm& arm, int k, int sign)
+            {
+            const int l = arm.lenArm(k);
+            const int a = arm.angle(k) % (2 * l); // position along the current side
+            return ((sign > 0) ? (2 * l - a) : a) + 1;
+            }
+
+
+    private:
+
+
+        /** Direction (+1, -1 or 0) of the rotation of arm k for a step increment a. */
+        static int _stepDir(const Arm& a, int k)
+            {
+            const int v = a.angle(k);
+            return (v == 0) ? 0 : ((v == 1) ? 1 : -1);
+            }
+
+
+        /**
+        * Return the next cut for arm k, recomputing it only when it is not valid anymore
+        * (backtrack, crossing passed, arm changed side or center of the box moved).
+        **/
+        const CutTime& _nextCut(int k, int n, const Arm& arm, const PixelTour& tour)
+            {
+            const iVec2 C = arm.centerBox(k + 1);
+            const int hp = halfPlane(arm, k);
+            if ((n < _cut[k].n0) || (n >= _cut_end[k]) || (hp != _cut_hp[k]) || (C != _cut_center[k]))
+                {
+                const int horizon = 8 * arm.lenArm(k); // a full rotation
+                _cut[k] = timeEnter(hp, tour, n, C, n + horizon);
+                _cut_hp[k] = hp;
+                _cut_center[k] = C;
+                _cut_end[k] = (_cut[k].sign == 0) ? (n + horizon / 4) : _cut[k].n1; // re-scan regularly when nothing was found.
+                if (_cut[k].sign == 0) _cut[k].n0 = n;
+                }
+            return _cut[k];
+            }
+
+
+        void _invalidate(int k)
+            {
+            _cut[k] = CutTime(-1, -1, -1, -1, 0, 0, 0);
+            _cut_end[k] = -1;
+            _cut_hp[k] = -1;
+            _cut_center[k] = iVec2(0, 0);
+            }
+
+
+        double _strength;           // maximum bias
+        int    _min_arm;            // smallest arm considered
+
+        std::vector<CutTime> _cut;              // cached cut for each arm
+        int     _cut_end[Arm::NB_ARMS];         // cached cut is valid for n < _cut_end
+        int     _cut_hp[Arm::NB_ARMS];          // half plane used for the cached cut
+        iVec2   _cut_center[Arm::NB_ARMS];      // center of the box used for the cached cut
+
+        std::vector<double> _w;                 // weights of the sons (reused between calls)
+    };
+
+
+
+/** end of file */
@@ -0,0 +1,344 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include <limits>
+#include <cmath>
+
+
+
+/**
+* Exact cost of a path.
+*
+* The colors of the image are multiples of 1/255 so the color cost of a move,
+* 3 * (|dR| + |dG| + |dB|), is 3/255 times an integer number of color units,
+* and the sqrt(L1) cost of a step is one of sqrt(0), ..., sqrt(9). A cost is
+* therefore stored as
+*
+*     r / 255 + s[0] * sqrt(2) + s[1] * sqrt(3) + s[2] * sqrt(5) + s[3] * sqrt(6) + s[4] * sqrt(7)
+*
+* with integer coefficients (sqrt(4) = 2, sqrt(8) = 2 sqrt(2) and sqrt(9) = 3
+* fold into the basis). Sums are exact. Since 1, sqrt(2), sqrt(3), sqrt(5), sqrt(6), sqrt(7)
+* are linearly independent over the rationals, two costs are equal iff their
+* coefficients are equal. When the sqrt coefficients are the same (the common
+* case when comparing paths with the same steps) the order is decided on the
+* integers. Otherwise the difference is evaluated in extended precision from
+* the exact integer coefficients together with a bound on its rounding error,
+* and only when it is within that bound of 0 is its sign computed exactly, by
+* squaring away the square roots one prime at a time with wide integers. The
+* order is therefore exact for any coefficients (ball searches and full tour
+* totals alike).
+*
+* Conversion to double is only needed for display and output.
+**/
+class ExactCost
+    {
+
+    public:
+
+        static constexpr int NB_SQRT = 5;   // number of irrational basis elements
+
+
+        /** Zero cost. */
+        ExactCost() : _r(0), _inf(false)
+            {
+            for (int k = 0; k < NB_SQRT; k++) _s[k] = 0;
+            }
+
+
+        /** Infinite cost (forbidden move). */
+        static ExactCost infinity()
+            {
+            ExactCost C;
+            C._inf = true;
+            return C;
+            }
+
+
+        /** Cost sqrt(u) of a step moving u arms (u in [0, 9]). */
+        static ExactCost sqrtL1(int u)
+            {
+            ExactCost C;
+            switch (u)
+                {
+                case 0: break;
+                case 1: C._r = 255; break;
+                case 2: C._s[0] = 1; break;
+                case 3: C._s[1] = 1; break;
+                case 4: C._r = 510; break;
+                case 5: C._s[2] = 1; break;
+                case 6: C._s[3] = 1; break;
+                case 7: C._s[4] = 1; break;
+                case 8: C._s[0] = 2; break;
+                case 9: C._r = 765; break;
+                default: C._inf = true;
+                }
+            return C;
+            }
+
+
+        /** Color cost of 'units' color units (see distcolUnits()). */
+        static ExactCost color(int units)
+            {
+            ExactCost C;
+            C._r = 3 * units;
+            return C;
+            }
+
+
+        /** Query if the cost is infinite. */
+        bool isInf() const
+            {
+            return _inf;
+            }
+
+
+        /** Add a number of color units. */
+        void addColor(int units)
+            {
+            _r += 3 * units;
+            }
+
+
+        ExactCost& operator+=(const ExactCost& C)
+            {
+            _inf = (_inf || C._inf);
+            _r += C._r;
+            for (int k = 0; k < NB_SQRT; k++) _s[k] += C._s[k];
+            return *this;
+            }
+
+
+        ExactCost operator+(const ExactCost& C) const
+            {
+            ExactCost R(*this);
+            R += C;
+            return R;
+            }
+
+
+        /** Difference (must not be called with an infinite cost). */
+        ExactCost operator-(const ExactCost& C) const
+            {
+            MTOOLS_ASSERT((!_inf) && (!C._inf));
+            ExactCost R(*this);
+            R._r -= C._r;
+            for (int k = 0; k < NB_SQRT; k++) R._s[k] -= C._s[k];
+            return R;
+            }
+
+
+        /**
+        * Compare with C: return -1, 0, 1 if this cost is smaller, equal or larger.
+        **/
+        int compare(const ExactCost& C) const
+            {
+            if (_inf || C._inf) return (_inf == C._inf) ? 0 : (_inf ? 1 : -1);
+            bool same = true;
+            for (int k = 0; k < NB_SQRT; k++) { if (_s[k] != C._s[k]) { same = false; break; } }
+            if (same) return (_r < C._r) ? -1 : ((_r > C._r) ? 1 : 0);
+            return (*this - C)._sign(); // cannot be 0 (linear independence)
+            }
+
+
+        bool operator==(const ExactCost& C) const { return (compare(C) == 0); }
+        bool operator!=(const ExactCost& C) const { return (compare(C) != 0); }
+        bool operator<(const ExactCost& C) const { return (compare(C) < 0); }
+        bool operator<=(const ExactCost& C) const { return (compare(C) <= 0); }
+        bool operator>(const ExactCost& C) const { return (compare(C) > 0); }
+        bool operator>=(const ExactCost& C) const { return (compare(C) >= 0); }
+
+
+        /**
+        * Largest number of color units u such that base + color(u) <= this cost
+        * (INT_MAX if this cost is infinite, -1 if base is). Used to prune the
+        * paths with a fixed sqrt part on integers only.
+        **/
+        int colorBudget(const ExactCost& base) const
+            {
+            if (_inf) return std::numeric_limits<int>::max();
+            if (base._inf) return -1;
+            bool same = true;
+            for (int k = 0; k < NB_SQRT; k++) { if (_s[k] != base._s[k]) { same = false; break; } }
+            if (same)
+                {
+                const int d = _r - base._r;
+                return (d >= 0) ? (d / 3) : -((2 - d) / 3); // floor(d / 3)
+                }
+            const ExactCost d = *this - base;
+            const long double v = d._value() * 85.0L; // never an integer (linear independence)
+            if (v < -1) return -1;
+            if (v > 1000000000.0L) return 1000000000;
+            int u = (int)floorl(v);
+            const long double err = 85.0L * d._error();
+            if ((v - u <= err) || (u + 1 - v <= err))
+                { // too close to an integer for the extended precision: correct u with exact comparisons
+                while ((u >= 0) && (base + color(u) > *this)) u--;
+                while (base + color(u + 1) <= *this) u++;
+                }
+            return u;
+            }
+
+
+        /** Value as a double (INF if infinite). */
+        double toDouble() const
+            {
+            return (_inf) ? mtools::INF : ((double)_value());
+            }
+
+
+        /** Print the cost and its coefficients into a string. */
+        std::string toString() const
+            {
+            if (_inf) return "inf";
+            mtools::ostringstream oss;
+            oss << mtools::doubleToStringHighPrecision(toDouble()) << " = " << _r << "/255";
+            const char* name[NB_SQRT] = { "sqrt2", "sqrt3", "sqrt5", "sqrt6", "sqrt7" };
+            for (int k = 0; k < NB_SQRT; k++) { if (_s[k] != 0) oss << " + " << _s[k] << " " << name[k]; }
+            return oss.toString();
+            }
+
+
+    private:
+
+        static constexpr long double SQ[NB_SQRT] = { 1.41421356237309504880L, 1.73205080756887729353L, 2.23606797749978969641L, 2.44948974278317809820L, 2.64575131106459059050L };
+
+        long double _value() const
+            {
+            long double v = ((long double)_r) / 255.0L;
+            for (int k = 0; k < NB_SQRT; k++) v += _s[k] * SQ[k];
+            return v;
+            }
+
+
+        /** Bound on the rounding error of _value() (a few ulps of the sum of the absolute values of the terms). */
+        long double _error() const
+            {
+            long double m = fabsl((long double)_r) / 255.0L;
+            for (int k = 0; k < NB_SQRT; k++) m += std::abs(_s[k]) * SQ[k];
+            return 16 * std::numeric_limits<long double>::epsilon() * m;
+            }
+
+
+        /** Sign of the cost (finite): extended precision if it is conclusive, exact otherwise. */
+        int _sign() const
+            {
+            const long double v = _value();
+            const long double err = _error();
+            if (v > err) return 1;
+            if (v < -err) return -1;
+            // 255 times the cost in the basis sqrt(m) for the products m of the primes 2, 3, 5, 7 (bit k of the index <-> k-th prime)
+            _Wide c[16];
+            c[0] = _Wide(_r);
+            c[1] = _Wide(255 * (int64_t)_s[0]);    // sqrt(2)
+            c[2] = _Wide(255 * (int64_t)_s[1]);    // sqrt(3)
+            c[4] = _Wide(255 * (int64_t)_s[2]);    // sqrt(5)
+            c[3] = _Wide(255 * (int64_t)_s[3]);    // sqrt(6)
+            c[8] = _Wide(255 * (int64_t)_s[4]);    // sqrt(7)
+            return _fieldSign(c, 4);
+            }
+
+
+        /**
+        * Signed integer with 1280 bits (two's complement). The coefficients start
+        * with at most 40 bits and each of the 4 squarings of _fieldSign() at most
+        * doubles their size plus 12 bits, so the results stay below 850 bits.
+        **/
+        struct _Wide
+            {
+            static constexpr int N = 40;   // number of 32 bits words
+            uint32_t w[N];
+
+            explicit _Wide(int64_t x = 0)
+                {
+                const uint64_t u = (uint64_t)x;
+                w[0] = (uint32_t)u;
+                w[1] = (uint32_t)(u >> 32);
+                const uint32_t f = (x < 0) ? 0xFFFFFFFF : 0;
+                for (int i = 2; i < N; i++) w[i] = f;
+                }
+
+            bool isNeg() const { return ((w[N - 1] >> 31) != 0); }
+
+            int sign() const
+                {
+                if (isNeg()) return -1;
+                for (int i = 0; i < N; i++) { if (w[i] != 0) return 1; }
+                return 0;
+                }
+
+            _Wide operator+(const _Wide& B) const
+                {
+                _Wide R;
+                uint64_t c = 0;
+                for (int i = 0; i < N; i++) { const uint64_t t = (uint64_t)w[i] + B.w[i] + c; R.w[i] = (uint32_t)t; c = t >> 32; }
+                return R;
+                }
+
+            _Wide operator-() const
+                {
+                _Wide R;
+                uint64_t c = 1;
+                for (int i = 0; i < N; i++) { const uint64_t t = (uint64_t)(~w[i]) + c; R.w[i] = (uint32_t)t; c = t >> 32; }
+                return R;
+                }
+
+            _Wide operator-(const _Wide& B) const { return (*this) + (-B); }
+
+            _Wide operator*(const _Wide& B) const
+                { // product of the absolute values (skipping the zero words) then sign
+                const _Wide X = isNeg() ? -(*this) : (*this);
+                const _Wide Y = B.isNeg() ? -B : B;
+                _Wide R;
+                for (int i = 0; i < N; i++)
+                    {
+                    if (X.w[i] == 0) continue;
+                    uint64_t c = 0;
+                    for (int j = 0; i + j < N; j++) { const uint64_t t = (uint64_t)X.w[i] * Y.w[j] + R.w[i + j] + c; R.w[i + j] = (uint32_t)t; c = t >> 32; }
+                    }
+                return (isNeg() != B.isNeg()) ? -R : R;
+                }
+            };
+
+
+        /**
+        * Exact sign of sum_m c[m] sqrt(m) where m runs over the products of the
+        * first nbp primes of (2, 3, 5, 7). Writing the sum a + b sqrt(p) with p
+        * the last prime and a, b free of sqrt(p), the sign is that of a or b when
+        * they agree and that of a times the sign of a^2 - p b^2 otherwise.
+        **/
+        static int _fieldSign(const _Wide* c, int nbp)
+            {
+            if (nbp == 0) return c[0].sign();
+            static const int PR[4] = { 2, 3, 5, 7 };
+            const int j = nbp - 1;
+            const int D = 1 << j;
+            const _Wide* a = c;        // the words without sqrt(PR[j])
+            const _Wide* b = c + D;    // the coefficients of sqrt(PR[j])
+            const int sb = _fieldSign(b, j);
+            const int sa = _fieldSign(a, j);
+            if (sb == 0) return sa;
+            if ((sa == 0) || (sa == sb)) return sb;
+            _Wide t[8];
+            for (int m1 = 0; m1 < D; m1++)
+                {
+                for (int m2 = 0; m2 < D; m2++)
+                    {
+                    int64_t f = 1; // sqrt(m1) sqrt(m2) = f sqrt(m1 ^ m2)
+                    for (int k = 0; k < j; k++) { if ((m1 & m2) & (1 << k)) f *= PR[k]; }
+                    t[m1 ^ m2] = t[m1 ^ m2] + (a[m1] * a[m2] - _Wide(PR[j]) * b[m1] * b[m2]) * _Wide(f);
+                    }
+                }
+            return sa * _fieldSign(t, j);
+            }
+
+        int32_t _r;             // rational part, in units of 1/255
+        int32_t _s[NB_SQRT];    // coefficients of sqrt(2), sqrt(3), sqrt(5), sqrt(6), sqrt(7)
+        bool    _inf;           // infinite cost
+    };
+
+
+
+/** end of file */
@@ -0,0 +1,592 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include <bitset>
+
+#include "Arm.h"
+#include "Solution.h"
+
+
+
+/**
+* Two scale search for lifting a pixel tour (lossless moves only).
+*
+* The arms are split in two groups:
+*
+* - the coarse arms 3..NB_ARMS-1 whose angles are planned by a randomized depth first
+*   search. The only constraint on the coarse plan is that the pixel of the tour
+*   stays inside the bounding box of arm 3 (boundingBox(3)), i.e. within reach
+*   of the small arms. Candidate moves are ordered using anglesToReach() on
+*   pixels further along the tour so that each large arm starts rotating before
+*   its box stops containing the tour.
+*
+* - the fine arms 0..2 which are never enumerated one by one: for each index of
+*   the tour we keep the set of all the angles (a0,a1,a2) (1024 states) that can
+*   be reached losslessly given the coarse plan. This set is updated in constant
+*   time at each step.
+*
+* The coarse plan is backtracked only when the set of fine states becomes empty.
+* Once the end of the tour is reached, the fine angles are chosen by walking the
+* sets backward.
+*
+* The paths produced are lossless and can be saved with save() and loaded back
+* in a TreeSearch object with TreeSearch::loadPartial().
+**/
+class HierarchicalSearch
+    {
+
+    public:
+
+
+        /**
+        * Ctor.
+        *
+        * tour : the tour to lift (must start at the origin or a corner).
+        * gen  : RNG used by the search.
+        **/
+        HierarchicalSearch(const std::vector<iVec2>& tour, MT2004_64& gen) : _tour(tour), _gen(gen), _G(0.5), _th(nullptr), _ison(false), _request_stop(false), _failed(false), _nbsteps(0), _nbbacktracks(0)
+            {
+            MTOOLS_INSURE(tour.size() > 1);
+            _createFineTables();
+            setParameters();
+            _reset(std::vector<Arm>(1, Arm(tour[0]))); // must be the origin or a corner.
+            }
+
+
+        /**
+        * Dtor
+        **/
+        ~HierarchicalSearch()
+            {
+            stopSearch();
+            }
+
+
+        /**
+        * Set the parameters of the search.
+        *
+        * strength  : maximum multiplicative bias given to a coarse arm rotating toward the future pixels.
+        * jump_prob : probability that a backtrack drops more than one level. The
+        *             plan is then restarted (with fresh candidates) from an index
+        *             a geometric number of levels below, of mean jump_len.
+        **/
+        void setParameters(double strength = 20.0, double jump_prob = 0.01, int jump_len = 64)
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            _strength = strength;
+            _jump_prob = jump_prob;
+            _G.setParam(1.0 / std::max(1, jump_len));
+            }
+
+
+        /**
+        * Start the search thread.
+        **/
+        void search()
+            {
+            MTOOLS_INSURE(!isSearchOn());
+            if (_th != nullptr)
+                {
+                _th->join();
+                delete _th;
+                }
+            _request_stop = false;
+            _ison = true;
+            _th = new std::thread(&HierarchicalSearch::_work, this);
+            }
+
+
+        /**
+        * Stop the search and return when it has ended.
+        **/
+        void stopSearch()
+            {
+            _request_stop = true;
+            if (_th != nullptr)
+                {
+                _th->join();
+                delete _th;
+                _th = nullptr;
+                }
+            _request_stop = false;
+            }
+
+
+        /**
+        * Query if the search is currently ongoing
+        **/
+        bool isSearchOn()
+            {
+            return (bool)_ison;
+            }
+
+
+        /**
+        * Query if we have a full solution.
+        **/
+        bool solved()
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            return (_best_coarse.size() == _tour.size());
+            }
+
+
+        /**
+        * Query if the search gave up because every coarse move from the first
+        * index was tried (with jump_prob > 0 this is not a proof that no lift exists
+        * since the long backtracks forget part of the tree).
+        **/
+        bool failed()
+            {
+            return (bool)_failed;
+            }
+
+
+        /**
+        * Current position being studied
+        **/
+        int pos()
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            return (int)_coarse.size() - 1;
+            }
+
+
+        /**
+        * Best position yet
+        **/
+        int bestpos()
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            return (int)_best_coarse.size() - 1;
+            }
+
+
+        /**
+        * Total number of coarse moves tried.
+        **/
+        int64 nbsteps()
+            {
+            return (int64)_nbsteps;
+            }
+
+
+        /**
+        * Number of times the coarse plan was backtracked.
+        **/
+        int64 nbbacktracks()
+            {
+            return (int64)_nbbacktracks;
+            }
+
+
+        /**
+        * Return the best (partial) solution found. Lossless so there is nothing to expand.
+        **/
+        const std::vector<Arm> bestPath()
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            return _extract(_best_coarse, _best_fine);
+            }
+
+
+        /**
+        * Return the current path.
+        **/
+        const std::vector<Arm> currentPath()
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            return _extract(_coarse, _fine);
+            }
+
+
+        /**
+        * Save the best path into a file in csv format (same format as TreeSearch::save()).
+        **/
+        std::string save(std::string filename)
+            {
+            saveSolution(bestPath(), filename.c_str(), false);
+            return filename;
+            }
+
+
+        /**
+        * Restart the search from a partial (lossless) solution.
+        * The search may backtrack into the loaded path.
+        **/
+        void loadPartial(const std::vector<Arm>& Varm)
+            {
+            MTOOLS_INSURE(Varm.size() > 0);
+            MTOOLS_INSURE(Varm.size() <= _tour.size());
+            std::lock_guard<std::mutex> lock(_mut);
+            _reset(Varm);
+            }
+
+
+        void loadPartial(const std::string& filename)
+            {
+            auto V = loadSolution(filename.c_str());
+            loadPartial(V);
+            }
+
+
+        /**
+        * Print formattted info about the search (one line).
+        **/
+        std::string toString()
+            {
+            int p, bp;
+                {
+                std::lock_guard<std::mutex> lock(_mut);
+                p = (int)_coarse.size() - 1;
+                bp = (int)_best_coarse.size() - 1;
+                }
+            mtools::ostringstream oss;
+            oss << justify_left(mtools::toString(nbsteps()), 11) << "| "
+                << justify_right(mtools::toString(p), 5) << " / "
+                << justify_left(mtools::toString(bp), 5) << " | "
+                << justify_right(mtools::toString(nbbacktracks()), 10) << "\n";
+            return oss.toString();
+            }
+
+
+        /**
+        * Header for the toString function
+        **/
+        std::string header()
+            {
+            return "nb steps   |   pos  maxpos | backtracks\n";
+            }
+
+
+        std::string hrule()
+            {
+            return "                                        \n";
+            }
+
+
+    private:
+
+
+        static constexpr int NB_FINE = 1024;       // number of angles (a0,a1,a2) = 8 x 8 x 16
+        static constexpr int FINE_RANGE = 4;        // arms 0..2 reach [-4,4]^2 around centerBox(3)
+        static constexpr int NB_COARSE_STEPS = ArmDims<Arm::NB_ARMS>::nbSteps() / 27; // rotations -1/0/+1 of the coarse arms
+
+        static_assert(Arm::NB_ARMS >= 4, "HierarchicalSearch needs at least one coarse arm");
+
+        typedef std::bitset<NB_FINE> FineSet;
+
+
+        /** index of the fine state (a0,a1,a2) */
+        static int _fineIndex(int a0, int a1, int a2)
+            {
+            return a0 + 8 * a1 + 64 * a2;
+            }
+
+
+        /** Coarse part of an arm (angles of the arms 0..2 set to 0). */
+        static Arm _coarsePart(Arm a)
+            {
+            a.setAngle(0, 0);
+            a.setAngle(1, 0);
+            a.setAngle(2, 0);
+            return a;
+            }
+
+
+        /** Full arm from its coarse part and a fine state. */
+        static Arm _fullArm(Arm c, int s)
+            {
+            c.setAngle(0, s & 7);
+            c.setAngle(1, (s >> 3) & 7);
+            c.setAngle(2, (s >> 6) & 15);
+            return c;
+            }
+
+
+        /** Number of coarse arms whose angle differ. */
+        static int _coarseMoves(const Arm& a, const Arm& b)
+            {
+            int m = 0;
+            for (int k = 3; k < Arm::NB_ARMS; k++) { if (a.angle(k) != b.angle(k)) m++; }
+            return m;
+            }
+
+
+        /**
+        * Create the tables describing the fine states: their offset w.r.t.
+        * centerBox(3), the list of states for each offset and the list of fine
+        * rotations sorted by the number of arms moved.
+        **/
+        void _createFineTables()
+            {
+            const int W = 2 * FINE_RANGE + 1;
+            _byoff.resize(W * W);
+            for (int a2 = 0; a2 < 16; a2++)
+                for (int a1 = 0; a1 < 8; a1++)
+                    for (int a0 = 0; a0 < 8; a0++)
+                        {
+                        Arm t;
+                        t.setAngle(0, a0);
+                        t.setAngle(1, a1);
+                        t.setAngle(2, a2);
+                        const iVec2 P = t.pos(0) + t.pos(1) + t.pos(2);
+                        _byoff[(int)(P.X() + FINE_RANGE) + W * (int)(P.Y() + FINE_RANGE)].push_back(_fineIndex(a0, a1, a2));
+                        }
+            for (int m = 0; m < 4; m++) _rot[m].clear();
+            for (int r2 = -1; r2 <= 1; r2++)
+                for (int r1 = -1; r1 <= 1; r1++)
+                    for (int r0 = -1; r0 <= 1; r0++)
+                        {
+                        const int m = (r0 != 0) + (r1 != 0) + (r2 != 0);
+                        _rot[m].push_back({ r0, r1, r2 });
+                        }
+            }
+
+
+        /**
+        * Fine states compatible with the coarse move c -> c2 when going from
+        * tour[n] to tour[n+1], knowing the set S of fine states at index n.
+        **/
+        FineSet _fineStep(const Arm& c, const FineSet& S, const Arm& c2, int n) const
+            {
+            FineSet R;
+            const iVec2 D = _tour[n + 1] - _tour[n];
+            const int L = (int)(abs(D.X()) + abs(D.Y()));
+            const int mf = L - _coarseMoves(c, c2); // number of fine arms that must move
+            if ((mf < 0) || (mf > 3)) return R;
+            const iVec2 Q = _tour[n + 1] - c2.centerBox(3);
+            if ((abs(Q.X()) > FINE_RANGE) || (abs(Q.Y()) > FINE_RANGE)) return R;
+            const int W = 2 * FINE_RANGE + 1;
+            for (int s2 : _byoff[(int)(Q.X() + FINE_RANGE) + W * (int)(Q.Y() + FINE_RANGE)])
+                {
+                const int a0 = s2 & 7, a1 = (s2 >> 3) & 7, a2 = (s2 >> 6) & 15;
+                for (auto& r : _rot[mf])
+                    {
+                    if (S[_fineIndex((a0 - r[0]) & 7, (a1 - r[1]) & 7, (a2 - r[2]) & 15)]) { R.set(s2); break; }
+                    }
+                }
+            return R;
+            }
+
+
+        /**
+        * Generate the coarse candidates for index n+1 ordered by a weighted random
+        * permutation (the next one to try is at the back).
+        **/
+        void _candidates(int n, std::vector<Arm>& res)
+            {
+            res.clear();
+            const int N = (int)_tour.size() - 1;
+            const Arm c = _coarse[n];
+            const iVec2 D = _tour[n + 1] - _tour[n];
+            const int L = (int)(abs(D.X()) + abs(D.Y()));
+            if (L > Arm::NB_ARMS) return;
+
+            // preferred direction of rotation for each coarse arm.
+            int dir[Arm::NB_ARMS];
+            double boost[Arm::NB_ARMS];
+            for (int k = 3; k < Arm::NB_ARMS; k++)
+                {
+                dir[k] = 0;
+                boost[k] = 1.0;
+                const int h = 2 * c.lenArm(k);
+                const int m = std::min(n + 1 + h, N);
+                bool err = false;
+                auto R = c.anglesToReach(_tour[m], k, err);
+                if ((err) || ((R.first == 0) && (R.second == 0))) continue;
+                const int need = std::min(abs(R.first), abs(R.second));
+                dir[k] = (abs(R.first) <= abs(R.second)) ? 1 : -1;
+                double u = ((double)need) / (m - n);
+                if (u > 1) u = 1;
+                boost[k] = 1.0 + _strength * u;
+                }
+
+            std::vector<std::pair<double, Arm>> V;
+            const iVec2 C0 = c.centerBox(3);
+            for (int i = 0; i < NB_COARSE_STEPS; i++)
+                {
+                Arm c2 = c;
+                int mc = 0;
+                double w = 1.0;
+                int x = i;
+                for (int k = 3; k < Arm::NB_ARMS; k++)
+                    {
+                    const int r = (x % 3) - 1;
+                    x /= 3;
+                    if (r == 0) continue;
+                    mc++;
+                    c2.addAngle(k, r);
+                    if (r == dir[k]) w *= boost[k]; else if (r == -dir[k]) w /= boost[k];
+                    }
+                if (mc > L) continue;
+                // the coarse arms must move the tip in the direction of the tour without cancelling each other.
+                const iVec2 E = c2.centerBox(3) - C0;
+                if (abs(E.X()) + abs(E.Y()) != mc) continue;
+                if ((E.X() * D.X() < 0) || (E.Y() * D.Y() < 0) || (abs(E.X()) > abs(D.X())) || (abs(E.Y()) > abs(D.Y()))) continue;
+                const iVec2 Q = _tour[n + 1] - c2.centerBox(3);
+                if ((abs(Q.X()) > FINE_RANGE) || (abs(Q.Y()) > FINE_RANGE)) continue;
+                // weighted random permutation: sort by u^(1/w).
+                double u = Unif(_gen);
+                if (u <= 0) u = 1e-300;
+                V.push_back({ log(u) / w, c2 });
+                }
+            std::sort(V.begin(), V.end(), [](const std::pair<double, Arm>& a, const std::pair<double, Arm>& b) { return a.first < b.first; });
+            for (auto& p : V) res.push_back(p.second);
+            }
+
+
+        /**
+        * Restart from a given partial path.
+        **/
+        void _reset(const std::vector<Arm>& V)
+            {
+            const int L = (int)V.size();
+            _coarse.clear();
+            _fine.clear();
+            _cand.clear();
+            _coarse.reserve(_tour.size());
+            _fine.reserve(_tour.size());
+            _cand.resize(_tour.size());
+            for (int n = 0; n < L; n++)
+                {
+                MTOOLS_INSURE(V[n].pos() == _tour[n]);
+                _coarse.push_back(_coarsePart(V[n]));
+                FineSet S;
+                S.set(_fineIndex(V[n].angle(0), V[n].angle(1), V[n].angle(2)));
+                _fine.push_back(S);
+                }
+            // candidates not yet tried along the loaded path.
+            for (int n = 0; n + 1 < L; n++)
+                {
+                _candidates(n, _cand[n]);
+                auto it = std::find_if(_cand[n].begin(), _cand[n].end(), [&](const Arm& a) { return a.val() == _coarse[n + 1].val(); });
+                if (it != _cand[n].end()) _cand[n].erase(it);
+                }
+            if (L < (int)_tour.size()) _candidates(L - 1, _cand[L - 1]);
+            _best_coarse = _coarse;
+            _best_fine = _fine;
+            _sync = L;
+            _failed = false;
+            }
+
+
+        /**
+        * Choose the fine angles by walking the sets backward and return the full path.
+        **/
+        std::vector<Arm> _extract(const std::vector<Arm>& C, const std::vector<FineSet>& F) const
+            {
+            const int L = (int)C.size();
+            std::vector<Arm> V(L);
+            int s = 0;
+            while (!F[L - 1][s]) s++;
+            V[L - 1] = _fullArm(C[L - 1], s);
+            for (int n = L - 2; n >= 0; n--)
+                {
+                const iVec2 D = _tour[n + 1] - _tour[n];
+                const int mf = (int)(abs(D.X()) + abs(D.Y())) - _coarseMoves(C[n], C[n + 1]);
+                MTOOLS_INSURE((mf >= 0) && (mf <= 3));
+                const int a0 = s & 7, a1 = (s >> 3) & 7, a2 = (s >> 6) & 15;
+                int p = -1;
+                for (auto& r : _rot[mf])
+                    {
+                    const int q = _fineIndex((a0 - r[0]) & 7, (a1 - r[1]) & 7, (a2 - r[2]) & 15);
+                    if (F[n][q]) { p = q; break; }
+                    }
+                MTOOLS_INSURE(p >= 0);
+                s = p;
+                V[n] = _fullArm(C[n], s);
+                }
+            return V;
+            }
+
+
+        /** Thread working method */
+        void _work()
+            {
+            const int N = (int)_tour.size() - 1;
+            std::unique_lock<std::mutex> lock(_mut);
+            int n = (int)_coarse.size() - 1;
+            while (n < N)
+                {
+                if (((++_nbsteps) & 1023) == 0)
+                    { // let the other threads query the object.
+                    lock.unlock();
+                    if ((bool)_request_stop) { _ison = false; return; }
+                    lock.lock();
+                    n = (int)_coarse.size() - 1; // in case a path was loaded.
+                    }
+                std::vector<Arm>& cand = _cand[n];
+                if (cand.size() == 0)
+                    { // coarse plan exhausted at this index: backtrack.
+                    if (n == 0) { _failed = true; break; }
+                    _nbbacktracks++;
+                    int m = n - 1;
+                    if (Unif(_gen) < _jump_prob)
+                        { // drop several levels and restart the plan from there.
+                        m -= (int)_G(_gen);
+                        if (m < 0) m = 0;
+                        _candidates(m, _cand[m]);
+                        }
+                    _coarse.resize(m + 1);
+                    _fine.resize(m + 1);
+                    if (m + 1 < _sync) _sync = m + 1;
+                    n = m;
+                    continue;
+                    }
+                const Arm c2 = cand.back();
+                cand.pop_back();
+                FineSet S = _fineStep(_coarse[n], _fine[n], c2, n);
+                if (S.none()) continue; // the fine arms cannot follow: try the next coarse move.
+                _coarse.push_back(c2);
+                _fine.push_back(S);
+                n++;
+                if (n < N) _candidates(n, _cand[n]);
+                if (n >= (int)_best_coarse.size())
+                    { // new best: copy the part that changed since the last copy.
+                    _best_coarse.resize(n + 1);
+                    _best_fine.resize(n + 1);
+                    for (int i = _sync; i <= n; i++)
+                        {
+                        _best_coarse[i] = _coarse[i];
+                        _best_fine[i] = _fine[i];
+                        }
+                    _sync = n + 1;
+                    }
+                }
+            _ison = false;
+            }
+
+
+        const std::vector<iVec2>    _tour;              // the tour to lift
+        MT2004_64&                  _gen;               // random generator
+
+        std::vector<std::vector<int>>       _byoff;     // fine states for each offset w.r.t. centerBox(3)
+        std::vector<std::array<int, 3>>     _rot[4];    // fine rotations by number of arms moved
+
+        std::vector<Arm>                    _coarse;    // current coarse plan (angles of arms 3..NB_ARMS-1)
+        std::vector<FineSet>                _fine;      // reachable fine states along the current plan
+        std::vector<std::vector<Arm>>       _cand;      // coarse moves not yet tried at each index
+        std::vector<Arm>                    _best_coarse;
+        std::vector<FineSet>                _best_fine;
+        int                                 _sync;      // current and best plans agree below this index
+
+        double                  _strength;              // bias toward the rotations given by anglesToReach()
+        double                  _jump_prob;             // probability of a long backtrack
+        GeometricLaw            _G;                     // extra levels dropped when backtracking
+
+        std::mutex              _mut;                   // protect the plan
+        std::thread*            _th;                    // the thread object
+        std::atomic<bool>       _ison;                  // is the thread currently working
+        std::atomic<bool>       _request_stop;          // flag used to request the thread to stop
+        std::atomic<bool>       _failed;                // true if the whole tree was explored
+        std::atomic<int64>      _nbsteps;               // number of coarse moves tried
+        std::atomic<int64>      _nbbacktracks;          // number of backtracks
+    };
+
+
+
+/** end of file */
@@ -0,0 +1,328 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include <functional>
+
+#include "Arm.h"
+#include "PotSon.h"
+#include "TreeSearch.h"
+
+
+
+/**
+* Population of searches on the same tour that share their best prefixes
+* (island model).
+*
+* Every 'period' seconds, each search that made no progress since the last
+* migration and lags behind the leader (bestpos < lag * leader) adopts the
+* prefix of a better search. The donor is chosen at random among the better
+* searches, with a weight proportional to its rank, and a donor gives to at
+* most 'max_receivers' searches per migration so that the population does not
+* collapse on a single path. The receiver keeps a random part of the donor
+* prefix, between its own best position and the donor's.
+*
+* The prefixes are read from the snapshots published by the searches
+* (TreeSearch::bestSnapshot()) so the donors are never paused. Only lossless
+* prefixes are migrated.
+*
+* A search whose best position did not improve for 'stagnation' seconds is
+* deleted and replaced by a new one (new RNG) that starts from a random prefix
+* of the best path of the population.
+**/
+class IslandSearch
+    {
+
+    public:
+
+        typedef std::function<Arm(int, Arm, iVec2, PotSon&, bool, TreeSearch*)> Heuristic;
+
+
+        /**
+        * Ctor.
+        *
+        * tour       : the tour to lift.
+        * nb_islands : number of searches (one thread each).
+        * seed       : seed for the RNGs.
+        **/
+        IslandSearch(const std::vector<iVec2>& tour, int nb_islands, uint64 seed) : _tour(tour), _ptour(PixelTour::make(tour)), _gen(seed), _started(false), _solved(false), _nbmigrations(0), _nbrestarts(0)
+            {
+            _isl.resize((nb_islands < 1) ? 1 : nb_islands);
+            setMigration();
+            }
+
+
+        /**
+        * Dtor. Stop and delete all the searches.
+        **/
+        ~IslandSearch()
+            {
+            _isl.clear();
+            }
+
+
+        /**
+        * Set the migration parameters.
+        *
+        * period_sec     : time between two migrations.
+        * lag            : a search migrates only if its best position is below lag * (best position of the leader).
+        * stagnation_sec : a search without progress for that long is restarted.
+        * max_receivers  : maximum number of searches receiving from the same donor at each migration.
+        **/
+        void setMigration(int period_sec = 30, double lag = 0.9, int stagnation_sec = 600, int max_receivers = 2)
+            {
+            _period = 1000 * (uint64)((period_sec < 1) ? 1 : period_sec);
+            _lag = lag;
+            _stagnation = 1000 * (uint64)((stagnation_sec < 1) ? 1 : stagnation_sec);
+            _max_receivers = (max_receivers < 1) ? 1 : max_receivers;
+            }
+
+
+        /**
+        * Function called on each new TreeSearch object before it is started
+        * (to set its parameters).
+        **/
+        void setSetup(std::function<void(TreeSearch&)> setup)
+            {
+            _setup = setup;
+            }
+
+
+        /**
+        * Start the searches.
+        **/
+        void start(Heuristic fun)
+            {
+            MTOOLS_INSURE(!_started);
+            _fun = fun;
+            _started = true;
+            for (size_t i = 0; i < _isl.size(); i++) _restart(i, nullptr);
+            _chmig.reset();
+            }
+
+
+        /**
+        * Collect a lossless lift, migrate and restart the searches when needed.
+        * Return true once the tour is lifted.
+        **/
+        bool update()
+            {
+            MTOOLS_INSURE(_started);
+            if (_solved) return true;
+            for (size_t i = 0; i < _isl.size(); i++)
+                {
+                Island& I = _isl[i];
+                TreeSearch& TS = *(I.ts);
+                if (TS.bestpos() > I.bestpos) { I.bestpos = TS.bestpos(); I.ch.reset(); }
+                if (!TS.solved()) continue;
+                TS.stopSearch();
+                if (TS.cumulative_loss() == 0)
+                    {
+                    _path = TS.bestPath();
+                    _solved = true;
+                    _isl.clear();
+                    return true;
+                    }
+                // solved with a loss: the thread has ended, start again from the best lossless path.
+                _restart(i, _bestSnapshot());
+                _nbrestarts++;
+                }
+            if (_chmig.elapsed() > _period)
+                {
+                _migrate();
+                _chmig.reset();
+                }
+            return false;
+            }
+
+
+        /**
+        * Query if the tour is lifted.
+        **/
+        bool solved() const
+            {
+            return _solved;
+            }
+
+
+        /**
+        * The lossless lift (must be solved).
+        **/
+        const std::vector<Arm>& solution() const
+            {
+            MTOOLS_INSURE(_solved);
+            return _path;
+            }
+
+
+        /**
+        * Print formattted info about the population (one line per search).
+        **/
+        std::string toString()
+            {
+            mtools::ostringstream oss;
+            if (_solved) { oss << "*** solved ***\n"; return oss.toString(); }
+            oss << "island |  maxpos |    pos | stagnation\n";
+            for (size_t i = 0; i < _isl.size(); i++)
+                {
+                auto& I = _isl[i];
+                oss << justify_right(mtools::toString(i), 6) << " | "
+                    << justify_right(mtools::toString(I.bestpos), 7) << " | "
+                    << justify_right(mtools::toString(I.ts->pos()), 6) << " | "
+                    << mtools::toString(I.ch.elapsed() / 1000) << "s\n";
+                }
+            oss << "migrations : " << _nbmigrations << "   restarts : " << _nbrestarts << "\n";
+            return oss.toString();
+            }
+
+
+    private:
+
+
+        /** a search and its RNG (the RNG must outlive the search). */
+        struct Island
+            {
+            std::unique_ptr<MT2004_64>  gen;
+            std::unique_ptr<TreeSearch> ts;
+            int                         bestpos;    // best position
+            int                         lastpos;    // best position at the last migration
+            Chrono                      ch;         // time since bestpos last improved
+            };
+
+
+        /**
+        * Replace search i by a new one. It starts from a random prefix (between 1/4
+        * and 3/4) of P if P is not null and from scratch otherwise.
+        **/
+        void _restart(size_t i, std::shared_ptr<const std::vector<Arm>> P)
+            {
+            Island& I = _isl[i];
+            I.ts.reset();
+            I.gen.reset(new MT2004_64(Unif_64(_gen)));
+            I.ts.reset(new TreeSearch(_ptour, *(I.gen)));
+            if (_setup) _setup(*(I.ts));
+            if ((P) && (P->size() > 4))
+                {
+                const int L = 1 + (int)((0.25 + 0.5 * Unif(_gen)) * (P->size() - 1));
+                I.ts->loadPartial(std::vector<Arm>(P->begin(), P->begin() + L));
+                }
+            I.bestpos = I.ts->bestpos();
+            I.lastpos = I.bestpos;
+            I.ch.reset();
+            I.ts->search(_fun);
+            }
+
+
+        /**
+        * Longest lossless snapshot of the population (null if none).
+        **/
+        std::shared_ptr<const std::vector<Arm>> _bestSnapshot()
+            {
+            std::shared_ptr<const std::vector<Arm>> B;
+            for (auto& I : _isl)
+                {
+                double loss = 0;
+                auto P = I.ts->bestSnapshot(&loss);
+                if ((P) && (loss == 0) && ((!B) || (P->size() > B->size()))) B = P;
+                }
+            return B;
+            }
+
+
+        /**
+        * Migration step.
+        **/
+        void _migrate()
+            {
+            const size_t N = _isl.size();
+            std::vector<std::shared_ptr<const std::vector<Arm>>> snap(N);
+            std::vector<int> len(N, 0);
+            for (size_t i = 0; i < N; i++)
+                {
+                double loss = 0;
+                snap[i] = _isl[i].ts->bestSnapshot(&loss);
+                if ((snap[i]) && (loss == 0)) len[i] = (int)snap[i]->size() - 1; else snap[i].reset();
+                }
+            std::vector<size_t> order(N);
+            for (size_t i = 0; i < N; i++) order[i] = i;
+            std::sort(order.begin(), order.end(), [&](size_t a, size_t b) { return len[a] > len[b]; });
+            const int leader = len[order[0]];
+
+            std::vector<int> given(N, 0);
+            for (size_t r = 1; r < N; r++)
+                {
+                const size_t i = order[r];
+                Island& I = _isl[i];
+                const bool progressed = (I.bestpos > I.lastpos);
+                I.lastpos = I.bestpos;
+
+                if (I.ch.elapsed() > _stagnation)
+                    { // stagnation: restart from the best path of the population
+                    _restart(i, snap[order[0]]);
+                    _nbrestarts++;
+                    continue;
+                    }
+                if ((progressed) || (I.bestpos >= _lag * leader)) continue;
+
+                // choose a donor among the better searches (weight = rank from the end).
+                double w[1024];
+                double tot = 0;
+                const size_t nd = std::min<size_t>(r, 1024);
+                for (size_t d = 0; d < nd; d++)
+                    {
+                    const size_t j = order[d];
+                    const bool ok = (snap[j]) && (len[j] > I.bestpos) && (given[j] < _max_receivers);
+                    tot += (ok ? (double)(nd - d) : 0.0);
+                    w[d] = tot;
+                    }
+                if (tot <= 0) continue;
+                const double u = Unif(_gen) * tot;
+                size_t d = 0;
+                while ((d + 1 < nd) && (w[d] <= u)) d++;
+                const size_t j = order[d];
+                given[j]++;
+
+                // keep a random part of the donor prefix beyond our own maximum.
+                const int L = I.bestpos + 1 + (int)(Unif(_gen) * (len[j] - I.bestpos));
+                I.ts->loadPartial(std::vector<Arm>(snap[j]->begin(), snap[j]->begin() + std::min(L, len[j]) + 1));
+                I.bestpos = I.ts->bestpos();
+                I.lastpos = I.bestpos;
+                I.ch.reset();
+                _nbmigrations++;
+                }
+
+            // the leader restarts too if it stagnates (from a prefix of its own path).
+            Island& B = _isl[order[0]];
+            B.lastpos = B.bestpos;
+            if (B.ch.elapsed() > _stagnation)
+                {
+                _restart(order[0], snap[order[0]]);
+                _nbrestarts++;
+                }
+            }
+
+
+        const std::vector<iVec2>    _tour;          // the tour to lift
+        std::shared_ptr<const PixelTour> _ptour;    // the same, shared by the searches
+        MT2004_64                   _gen;           // RNG for the migrations and the seeds
+        bool                        _started;
+        bool                        _solved;
+        std::vector<Arm>            _path;          // lossless lift once solved
+        Heuristic                   _fun;           // heuristic used by all the searches
+        std::function<void(TreeSearch&)> _setup;    // called on each new search
+        std::vector<Island>         _isl;           // the population
+
+        uint64                      _period;        // time between migrations (ms)
+        double                      _lag;           // lag ratio for migrating
+        uint64                      _stagnation;    // time before a restart (ms)
+        int                         _max_receivers; // receivers per donor per migration
+        Chrono                      _chmig;         // time since the last migration
+        int64                       _nbmigrations;  // number of prefixes adopted
+        int64                       _nbrestarts;    // number of restarts
+    };
+
+
+
+/** end of file */
@@ -1,6 +1,13 @@
 
 #include "LKHtour.h"
 #include "SantaImage.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cstring>
+#include <filesystem>
+#include <thread>
 
 
 
@@ -42,16 +49,16 @@ double score(const std::vector<iVec2>& tour, bool strict)
         for (auto Q : tour)
             {
             ss.insert(Q);
-            if ((Q.X() < -128) || (Q.X() > 128))
+            if ((Q.X() < -SANTA_IMAGE_CX) || (Q.X() > SANTA_IMAGE_CX))
                 {
-                MTOOLS_ERROR("X value out of range [-128,128]");
+                MTOOLS_ERROR(std::string("X value out of range [-") << SANTA_IMAGE_CX << "," << SANTA_IMAGE_CX << "]");
                 }
-            if ((Q.Y() < -128) || (Q.Y() > 128))
+            if ((Q.Y() < -SANTA_IMAGE_CY) || (Q.Y() > SANTA_IMAGE_CY))
                 {
-                MTOOLS_ERROR("Y value out of range [-128,128]");
+                MTOOLS_ERROR(std::string("Y value out of range [-") << SANTA_IMAGE_CY << "," << SANTA_IMAGE_CY << "]");
                 }
             }
-        if (ss.size() != 257 * 257)
+        if (ss.size() != SANTA_IMAGE_LX * SANTA_IMAGE_LY)
             {
             MTOOLS_ERROR("Tour does not visit all points !");
             }
@@ -60,6 +67,25 @@ double score(const std::vector<iVec2>& tour, bool strict)
     }
 
 
+bool checkTour(const std::vector<iVec2>& tour, std::string& err)
+    {
+    const size_t N = (size_t)SANTA_IMAGE_LX * SANTA_IMAGE_LY;
+    if (tour.size() != N + 1) { err = std::string("Wrong tour length ") + mtools::toString(tour.size()) + " (expected " + mtools::toString(N + 1) + ").."; return false; }
+    if ((tour.front() != iVec2(0, 0)) || (tour.back() != iVec2(0, 0))) { err = "Tour does not start and end at the origin.."; return false; }
+    std::vector<char> seen(N, 0);
+    for (size_t i = 0; i < N; i++)
+        {
+        const iVec2 P = tour[i];
+        if ((P.X() < -SANTA_IMAGE_CX) || (P.X() > SANTA_IMAGE_CX) || (P.Y() < -SANTA_IMAGE_CY) || (P.Y() > SANTA_IMAGE_CY)) { err = std::string("Point out of range at index ") + mtools::toString(i) + ".."; return false; }
+        const int id = coord2id(P);
+        if (seen[id]) { err = std::string("Point visited twice at index ") + mtools::toString(i) + ".."; return false; }
+        seen[id] = 1;
+        if (distim(P, tour[i + 1]) == mtools::INF) { err = std::string("Forbidden move at index ") + mtools::toString(i) + ".."; return false; }
+        }
+    return true;
+    }
+
+
 
 void splitTour(const std::vector<mtools::iVec2>& tour,
     std::vector<mtools::iVec2>& A,
@@ -122,69 +148,140 @@ void splitTour(const std::vector<mtools::iVec2>& tour,
 
 
 
-std::vector<mtools::iVec2> loadLKHTour(const std::string filename)
+/**
+* Parse the TOUR_SECTION of an LKH tour file in [p, end) and rotate the tour so
+* that it starts and ends at the origin. Return false and set err if the file
+* is invalid.
+**/
+static bool parseLKHTour(const char* p, const char* end, std::vector<mtools::iVec2>& tour, std::string& err)
     {
-    std::vector<mtools::iVec2> vec;
-    auto S = mtools::loadStringFromFile(filename);
-    if (S.size() == 0)
-        {
-        MTOOLS_ERROR(std::string("Cannot open :") << filename);
-        }
-    auto V = mtools::tokenize(S, "", "\n \t");
-    size_t i = 0;
-    while (i < V.size())
+    static const char KEY[] = "TOUR_SECTION";
+    const char* s = std::search(p, end, KEY, KEY + 12);
+    if (s == end) { err = "No TOUR_SECTION found.."; return false; }
+    p = s + 12;
+    const int N = SANTA_IMAGE_LX * SANTA_IMAGE_LY;
+    const int origin = coord2id(iVec2(0, 0)) + 1;
+    std::vector<char> seen(N + 1, 0);
+    std::vector<int> ids;
+    ids.reserve(std::min<size_t>(N, (size_t)(end - p) / 2));
+    int ori = -1;
+    while (true)
         {
-        auto s = V[i];
-        if (strcmp(s.c_str(), "TOUR_SECTION") == 0) break;
-        i++;
-        }
-    if (i == V.size())
-        {
-        MTOOLS_ERROR(std::string("No TOUR_SECTION found.."));
-        }
-    int ori = -1; 
-    for (i; i < V.size(); i++)
-        {
-        auto s = V[i];
-        int v;
-        mtools::fromString(s, v);
-        if (v >= 1)
+        while ((p < end) && ((*p == ' ') || (*p == '\n') || (*p == '\r') || (*p == '\t'))) p++;
+        if (p == end) break;
+        const bool neg = (*p == '-');
+        if (neg) p++;
+        const char* q = p;
+        int v = 0;
+        while ((p < end) && (*p >= '0') && (*p <= '9') && (p - q < 9)) { v = 10 * v + (*p - '0'); p++; }
+        if ((p == q) || ((p < end) && (*p != ' ') && (*p != '\n') && (*p != '\r') && (*p != '\t')))
             {
-            auto C = id2coord(v);
-            if (C == iVec2(0, 0))
-                {
-                if (ori != -1) MTOOLS_ERROR(std::string("Multiple ORIGIN found.."));
-                ori = (int)vec.size();
-                }
-            vec.push_back(C);
+            err = std::string("Invalid token in TOUR_SECTION after ") + mtools::toString(ids.size()) + " ids..";
+            return false;
             }
+        if (neg) v = -v;
         if (v == -1) break;
+        if ((v < 1) || (v > N)) { err = std::string("Invalid id ") + mtools::toString(v) + " in TOUR_SECTION.."; return false; }
+        if (seen[v]) { err = std::string("Id ") + mtools::toString(v) + " appears twice.."; return false; }
+        seen[v] = 1;
+        if (v == origin) ori = (int)ids.size();
+        ids.push_back(v);
         }
-    if (ori == -1)
+    if (ori == -1) { err = "No ORIGIN found.."; return false; }
+    const int l = (int)ids.size();
+    tour.resize(l + 1);
+    for (int i = 0; i < l + 1; i++)
         {
-        MTOOLS_ERROR(std::string("No ORIGIN found.."));
+        const int j = i + ori;
+        tour[i] = id2coord(ids[(j < l) ? j : (j - l)]);
         }
-    std::vector<mtools::iVec2> vec2;
-    vec2.reserve(vec.size()+ 1);
-    const int l = (int)vec.size();
-    for (int i = 0; i < l + 1; i++)
+    return true;
+    }
+
+
+std::vector<mtools::iVec2> loadLKHTour(const std::string filename)
+    {
+    std::vector<mtools::iVec2> tour;
+    std::string err;
+    if (!loadLKHTour(filename, tour, err))
         {
-        vec2.push_back(vec[(i + ori) % l]);
+        MTOOLS_ERROR(std::string("loadLKHTour() [") + filename + "] : " + err);
         }
-    return vec2;
+    return tour;
+    }
+
+
+bool loadLKHTour(const std::string& filename, std::vector<mtools::iVec2>& tour, std::string& err)
+    {
+    tour.clear();
+    MappedFile F(filename);
+    if (!F.isOpen()) { err = "cannot open the file."; return false; }
+    if (!parseLKHTour(F.data(), F.data() + F.size(), tour, err)) { tour.clear(); return false; }
+    return true;
     }
 
 
 void saveLKHTour(std::vector<mtools::iVec2> & tour, const std::string filename)
     {
-    LogFile f(filename, false, false, false);
-    f << "TOUR_SECTION\n";
-    for (auto P : tour)
+    std::vector<char> buf(tour.size() * 8 + 32);
+    char* p = buf.data();
+    memcpy(p, "TOUR_SECTION\n", 13); p += 13;
+    const size_t l = ((tour.size() > 1) && (tour.front() == tour.back())) ? (tour.size() - 1) : tour.size(); // each node once
+    for (size_t i = 0; i < l; i++)
         {
-        f << coord2id(P) << "\n";
+        int v = coord2id(tour[i]) + 1; // LKH ids start at 1 (see id2coord())
+        char tmp[12];
+        int n = 0;
+        do { tmp[n++] = (char)('0' + v % 10); v /= 10; } while (v > 0);
+        while (n > 0) *(p++) = tmp[--n];
+        *(p++) = '\n';
         }
-    f << "-1\n";
-    f << "EOF";
+    memcpy(p, "-1\nEOF", 6); p += 6;
+    FILE* f = fopen(filename.c_str(), "wb");
+    if (f == nullptr) { MTOOLS_ERROR(std::string("Cannot write :") << filename); }
+    const size_t n = (size_t)(p - buf.data());
+    const bool ok = (fwrite(buf.data(), 1, n, f) == n);
+    if ((fclose(f) != 0) || (!ok)) { MTOOLS_ERROR(std::string("Cannot write :") << filename); }
+    }
+
+
+std::vector<LKHTourFile> loadLKHTours(const std::string& directory, int nb_threads, std::function<void(LKHTourFile&)> process)
+    {
+    std::vector<LKHTourFile> res;
+    std::error_code ec;
+    for (std::filesystem::directory_iterator it(directory, ec), iend; (!ec) && (it != iend); it.increment(ec))
+        {
+        if ((it->is_regular_file()) && (it->path().extension() == ".tour"))
+            {
+            LKHTourFile T;
+            T.filename = it->path().string();
+            T.score = mtools::INF;
+            res.push_back(T);
+            }
+        }
+    if (ec) { MTOOLS_ERROR(std::string("loadLKHTours() : cannot read directory ") + directory); }
+    if (nb_threads <= 0) nb_threads = (int)std::thread::hardware_concurrency();
+    if (nb_threads < 1) nb_threads = 1;
+    if (nb_threads > (int)res.size()) nb_threads = (int)res.size();
+    std::atomic<size_t> next(0);
+    auto worker = [&]()
+        {
+        size_t i;
+        while ((i = next++) < res.size())
+            {
+            LKHTourFile& T = res[i];
+            MappedFile F(T.filename);
+            if (!F.isOpen()) { T.error = "Cannot open.."; continue; }
+            if (!parseLKHTour(F.data(), F.data() + F.size(), T.tour, T.error)) { T.tour.clear(); continue; }
+            T.score = score(T.tour);
+            if (process) process(T);
+            }
+        };
+    std::vector<std::thread> th;
+    for (int i = 0; i < nb_threads; i++) th.push_back(std::thread(worker));
+    for (auto& t : th) t.join();
+    std::sort(res.begin(), res.end(), [](const LKHTourFile& A, const LKHTourFile& B) { return (A.score != B.score) ? (A.score < B.score) : (A.filename < B.filename); });
+    return res;
     }
 
 
@@ -194,7 +291,7 @@ void cornerTour(const std::vector<mtools::iVec2>& tour)
     for (size_t i = 1; i < tour.size(); i++)
         {
         auto P = tour[i];
-        if ((P == iVec2(128, 128)) || (P == iVec2(-128, 128)) || (P == iVec2(128, -128)) || (P == iVec2(-128, -128)))
+        if ((abs(P.X()) == SANTA_IMAGE_CX) && (abs(P.Y()) == SANTA_IMAGE_CY))
             {
             cout << "Corner (" << P.X() << "," << P.Y() << ") at index " << i << "\n";            
             }
@@ -4,6 +4,8 @@
 #include <mtools/mtools.hpp>
 using namespace mtools;
 
+#include <functional>
+
 #include "SantaImage.h"
 
 
@@ -13,19 +15,62 @@ using namespace mtools;
 double score(const std::vector<iVec2>& tour, bool strict = false);
 
 
+/**
+* Check that a tour can be lifted: it starts and ends at the origin, visits
+* every pixel of the image exactly once and no step is a forbidden move.
+* Return false and set err otherwise (same checks as score(tour, true) but
+* without raising an error).
+*/
+bool checkTour(const std::vector<iVec2>& tour, std::string& err);
+
+
 /**
 * Load a tour file output from LKH.
 * -> starts and finishes at the origin. 
+* The file is memory mapped and the ids of the TOUR_SECTION are decoded
+* directly (error if an id is invalid or repeated, or if the origin is missing).
 */
 std::vector<mtools::iVec2> loadLKHTour(const std::string filename);
 
 
+/**
+* Same as above but does not throw: return false and set err if the file
+* cannot be opened or parsed (tour is then empty).
+**/
+bool loadLKHTour(const std::string& filename, std::vector<mtools::iVec2>& tour, std::string& err);
+
+
 /**
 * Save a tour in LKH file format
 **/
 void saveLKHTour(std::vector<mtools::iVec2>& tour, const std::string filename);
 
 
+/**
+* A tour file loaded by loadLKHTours().
+**/
+struct LKHTourFile
+    {
+    std::string                 filename;
+    std::vector<mtools::iVec2>  tour;       // the tour (empty if the file could not be loaded)
+    double                      score;      // score(tour) (INF if the file could not be loaded)
+    std::string                 error;      // why the file could not be loaded (empty if ok)
+    };
+
+
+/**
+* Load and score all the '.tour' files of a directory, in parallel with
+* nb_threads threads (0 = all cores). A file that cannot be loaded does not
+* stop the batch, its error is set instead. The result is sorted by score
+* (best first, then by file name).
+*
+* process : if set, called by the worker thread on each file loaded without
+*           error, after its score is computed (e.g. to analyze the tour and
+*           release it when the directory is too large to keep all the tours).
+**/
+std::vector<LKHTourFile> loadLKHTours(const std::string& directory, int nb_threads = 0, std::function<void(LKHTourFile&)> process = nullptr);
+
+
 
 /**
 * Split a tour in five part.
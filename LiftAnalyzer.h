@@ -0,0 +1,325 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include <functional>
+
+#include "Arm.h"
+#include "PotSon.h"
+#include "LKHtour.h"
+#include "cutTime.h"
+#include "CutHeuristic.h"
+#include "Segmentation.h"
+#include "TreeSearch.h"
+
+
+
+/**
+* A window of a part of the tour probed by LiftAnalyzer.
+*
+* The indices are those of the part (as returned by splitTour()) so a window
+* where the probe stalled can be given to TreeSearch::pushException() for the
+* search of that part, with the jump at index start + reached + 1.
+**/
+struct LiftWindow
+    {
+    int     part;       // index of the part (0 = A, ..., 4 = E)
+    int     start;      // first index of the window in the part
+    int     end;        // last index of the window in the part
+    int     reached;    // best position of the probe (relative to start)
+    bool    stalled;    // the probe stopped progressing before the end of its budget
+    double  loss;       // cumulative loss of the probe
+    double  jump_loss;  // minimum loss found to cross the best position (INF if none)
+    int64   steps;      // number of search steps of the probe
+    double  budget;     // time budget of the probe (ms)
+    double  time;       // time used by the probe (ms), more than budget if its last slice overran
+    };
+
+
+/**
+* Statistics of the cut times seen by one arm along the probes (see CutHeuristic).
+* u = rotation needed / number of steps before the crossing.
+**/
+struct ArmScaleStats
+    {
+    int     nb = 0;         // number of samples with a crossing within a full rotation
+    int     tight = 0;      // number of samples with u >= 1
+    double  sum_u = 0;
+    double  max_u = 0;
+
+    double mean() const { return (nb > 0) ? (sum_u / nb) : 0.0; }
+    };
+
+
+/**
+* Result of LiftAnalyzer::analyze().
+**/
+struct LiftReport
+    {
+    double  difficulty = 0;     // nb of flagged windows + unlifted fraction + against fraction
+    double  unlifted = 0;       // fraction of the tour the probes did not reach
+    int     nb_cuts = 0;        // number of primary cut times (parts A and E)
+    int     nb_against = 0;     // cuts where the tour moves more against the rotation than with it
+    double  min_slack = 1.0;    // smallest (good - bad) / length over the cuts
+    int     min_cut_len = 0;    // shortest cut (number of steps between the two crossings)
+    ArmScaleStats scale[Arm::NB_ARMS];  // cut statistics of each arm (arms >= LiftAnalyzer::MIN_SCALE_ARM)
+    std::vector<LiftWindow> windows;    // all the windows probed, in tour order
+    std::vector<int> flagged;   // indices in 'windows' of those likely to need a lossy exception
+    double  time_ms = 0;        // time spent in the analysis
+    double  overrun_ms = 0;     // total time used by the probes beyond their budgets
+
+
+    /**
+    * Print the report.
+    **/
+    std::string toString() const
+        {
+        mtools::ostringstream oss;
+        oss << "difficulty : " << mtools::doubleToStringNice(difficulty) << "   (" << flagged.size() << " flagged windows / " << windows.size()
+            << ", unlifted " << mtools::doubleToStringNice(((int)(1000 * unlifted)) / 10.0) << "%)\n";
+        oss << "cuts       : " << nb_cuts << "   against : " << nb_against << "   min slack : " << mtools::doubleToStringNice(((int)(1000 * min_slack)) / 1000.0)
+            << "   shortest : " << min_cut_len << "\n";
+        oss << "arm | samples | tight |  mean u |  max u\n";
+        for (int k = Arm::NB_ARMS - 1; k >= 0; k--)
+            {
+            const ArmScaleStats& S = scale[k];
+            if (S.nb == 0) continue;
+            oss << justify_right(mtools::toString(k), 3) << " | " << justify_right(mtools::toString(S.nb), 7) << " | " << justify_right(mtools::toString(S.tight), 5) << " | "
+                << justify_right(mtools::doubleToStringNice(((int)(1000 * S.mean())) / 1000.0), 7) << " | "
+                << justify_right(mtools::doubleToStringNice(((int)(1000 * S.max_u)) / 1000.0), 6) << "\n";
+            }
+        for (int i : flagged)
+            {
+            const LiftWindow& W = windows[i];
+            oss << "flagged : part " << (char)('A' + W.part) << " [" << W.start << ", " << W.end << "] stalled at " << W.start + W.reached;
+            if (W.loss > 0) oss << " (loss " << mtools::doubleToStringNice(((int)(1000 * W.loss)) / 1000.0) << ")";
+            if (W.jump_loss < mtools::INF) oss << " (jump loss " << mtools::doubleToStringNice(((int)(1000 * W.jump_loss)) / 1000.0) << ")";
+            oss << "\n";
+            }
+        oss << "time       : " << (int)time_ms << "ms   (probes over budget by " << (int)overrun_ms << "ms)\n";
+        return oss.toString();
+        }
+    };
+
+
+
+/**
+* Quick estimate of how hard a tour is to lift (time_ms per tour, 800 ms by
+* default, plus the overrun of the probes reported in LiftReport::overrun_ms).
+*
+* Each of the five parts of the tour (splitTour()) is cut into windows at its
+* primary cut times (SegmentedLift::chooseCuts()) and each window gets a short
+* cooperative TreeSearch. Its budget is its share (proportional to its length)
+* of the time left, but never less than its share of the total time: the time
+* saved by the probes that went through goes to the next windows while a probe
+* whose last slice overran does not eat the budget of the next ones. The first
+* window of a part starts at the origin or the corner. The next ones start at
+* the end of the previous probe when it went through, and otherwise at the
+* extremal configuration reaching the boundary pixel that rotates the arms the
+* least from the last configuration of the previous probe
+* (SegmentedLift::closestCandidates()). A probe is 'stalled' when its best
+* position did not improve during the second half of its budget: the window is
+* flagged as likely to need a lossy exception, as is a window lifted with a
+* loss. The probes do not explore the ball of radius 4 when looking for a
+* jump at a dead end (too slow for a pre-screen): a window whose jump needs 4
+* steps reports an infinite jump loss.
+*
+* The analysis also collects the statistics of the primary cut times of the
+* parts starting at the origin (slack between the good and bad moves) and,
+* along the paths found by the probes, the cut statistics of each large arm as
+* seen by CutHeuristic.
+*
+* The difficulty is the number of flagged windows, plus the fraction of the
+* tour the probes could not reach and the fraction of the primary cuts where
+* the tour moves against the rotation (both in [0,1], to rank the tours with
+* the same number of flagged windows).
+**/
+class LiftAnalyzer
+    {
+
+    public:
+
+        typedef std::function<Arm(int, Arm, iVec2, PotSon&, bool, TreeSearch*)> Heuristic;
+
+        static constexpr int MIN_SCALE_ARM = 3;     // smallest arm in the per arm statistics (as CutHeuristic)
+        static constexpr int SCALE_STRIDE = 8;      // the arm statistics are sampled every SCALE_STRIDE indices
+        static constexpr int SLICE = 4;             // steps per slice of the probes (a step may take a few ms)
+        static constexpr double MIN_BUDGET = 2.0;   // minimum time of a probe (ms)
+
+
+        /**
+        * Ctor.
+        *
+        * seed    : seed of the probes.
+        * time_ms : total time budget of the probes.
+        * win_len : target length of the windows.
+        **/
+        LiftAnalyzer(uint64 seed = 1, int time_ms = 800, int win_len = 1000) : _gen(seed), _time_ms((time_ms < 1) ? 1 : time_ms), _win_len((win_len < 16) ? 16 : win_len)
+            {
+            }
+
+
+        /**
+        * Function called on each probe before it is started (to set its parameters).
+        **/
+        void setSetup(std::function<void(TreeSearch&)> setup)
+            {
+            _setup = setup;
+            }
+
+
+        /**
+        * Analyze a tour (starting and ending at the origin). The probes use the
+        * heuristic fun (uniform choice among the sons if not set).
+        **/
+        LiftReport analyze(const std::vector<iVec2>& tour, Heuristic fun = nullptr)
+            {
+            Chrono ch;
+            ch.reset();
+            if (!fun) fun = [](int, Arm, iVec2, PotSon& potson, bool, TreeSearch*) { return potson.unif(); };
+            LiftReport R;
+            std::vector<iVec2> part[5];
+            splitTour(tour, part[0], part[1], part[2], part[3], part[4]);
+
+            // primary cut times (only meaningful for the parts starting at the origin).
+            for (int p = 0; p < 5; p++)
+                {
+                if (part[p][0] != iVec2(0, 0)) continue;
+                for (auto& C : cutTimes(part[p]))
+                    {
+                    const int len = C.n1 - C.n0;
+                    if (len <= 0) continue;
+                    const double slack = ((double)(C.good - C.bad)) / len;
+                    R.nb_cuts++;
+                    if (C.bad > C.good) R.nb_against++;
+                    if (slack < R.min_slack) R.min_slack = slack;
+                    if ((R.min_cut_len == 0) || (len < R.min_cut_len)) R.min_cut_len = len;
+                    }
+                }
+
+            // windows.
+            int64 tot = 0;
+            for (int p = 0; p < 5; p++)
+                {
+                const auto cuts = SegmentedLift::chooseCuts(part[p], _win_len);
+                for (size_t k = 0; k + 1 < cuts.size(); k++)
+                    {
+                    LiftWindow W;
+                    W.part = p;
+                    W.start = cuts[k];
+                    W.end = cuts[k + 1];
+                    W.reached = 0;
+                    W.stalled = false;
+                    W.loss = 0;
+                    W.jump_loss = mtools::INF;
+                    W.steps = 0;
+                    W.budget = 0;
+                    W.time = 0;
+                    R.windows.push_back(W);
+                    tot += W.end - W.start;
+                    }
+                }
+
+            // probes.
+            int64 unreached = 0;
+            int64 left = tot;
+            Arm a;
+            for (size_t i = 0; i < R.windows.size(); i++)
+                {
+                LiftWindow& W = R.windows[i];
+                if (W.start == 0) a = Arm(part[W.part][0]);
+                const double share = ((double)_time_ms) * (W.end - W.start) / ((tot > 0) ? tot : 1);
+                const double budget = std::max(MIN_BUDGET, std::max(share, ((double)_time_ms - (double)ch.elapsed()) * (W.end - W.start) / ((left > 0) ? left : 1)));
+                a = _probe(part[W.part], W, a, budget, fun, R);
+                if (W.time > W.budget) R.overrun_ms += W.time - W.budget;
+                left -= W.end - W.start;
+                unreached += (W.end - W.start) - W.reached;
+                if ((W.stalled) || (W.loss > 0)) R.flagged.push_back((int)i);
+                }
+            R.unlifted = (tot > 0) ? (((double)unreached) / tot) : 0.0;
+            R.difficulty = R.flagged.size() + R.unlifted + ((R.nb_cuts > 0) ? (((double)R.nb_against) / R.nb_cuts) : 0.0);
+            R.time_ms = (double)ch.elapsed();
+            return R;
+            }
+
+
+    private:
+
+
+        /**
+        * Probe window W of the part ptour from configuration a during budget ms.
+        * Return the starting configuration of the next window.
+        **/
+        Arm _probe(const std::vector<iVec2>& ptour, LiftWindow& W, Arm a, double budget, Heuristic& fun, LiftReport& R)
+            {
+            MT2004_64 gen(Unif_64(_gen));
+            std::shared_ptr<const std::vector<Arm>> P;
+                {
+                TreeSearch TS(std::vector<iVec2>(ptour.begin() + W.start, ptour.begin() + W.end + 1), gen, a);
+                TS.searchPrecision(3, 2, 3); // skip the ball of radius 4: a step at a dead end stays cheap
+                if (_setup) _setup(TS);
+                auto run = TS.cooperativeSearch(fun);
+                Chrono ch;
+                ch.reset();
+                int bp = 0;
+                double last = 0; // time of the last improvement
+                bool over = false;
+                while ((!over) && (ch.elapsed() < budget))
+                    {
+                    over = run(SLICE);
+                    if (TS.bestpos() > bp) { bp = TS.bestpos(); last = (double)ch.elapsed(); }
+                    }
+                W.reached = TS.bestpos();
+                W.stalled = (!TS.solved()) && (ch.elapsed() - last >= budget / 2);
+                W.loss = TS.cumulative_loss();
+                W.jump_loss = TS.jump_loss();
+                W.steps = TS.nbsteps();
+                W.budget = budget;
+                W.time = (double)ch.elapsed();
+                P = TS.bestSnapshot();
+                TS.stopSearch();
+                }
+            _scaleStats(ptour, W.start, *P, R);
+            if ((int)P->size() == W.end - W.start + 1) return P->back(); // went through
+            return SegmentedLift::closestCandidates(P->back(), ptour[W.end], 1)[0];
+            }
+
+
+        /**
+        * Add the cut statistics of the large arms along path P (the lift of
+        * ptour from index offset).
+        **/
+        void _scaleStats(const std::vector<iVec2>& ptour, int offset, const std::vector<Arm>& P, LiftReport& R)
+            {
+            for (size_t i = 0; i < P.size(); i += SCALE_STRIDE)
+                {
+                const int n = offset + (int)i;
+                const Arm& a = P[i];
+                for (int k = MIN_SCALE_ARM; k < Arm::NB_ARMS; k++)
+                    {
+                    const CutTime C = timeEnter(CutHeuristic::halfPlane(a, k), ptour, n, a.centerBox(k + 1), n + 8 * a.lenArm(k));
+                    if (C.sign == 0) continue;
+                    const int dist = C.n1 - n;
+                    if (dist <= 0) continue;
+                    const double u = ((double)CutHeuristic::rotationNeeded(a, k, C.sign)) / dist;
+                    ArmScaleStats& S = R.scale[k];
+                    S.nb++;
+                    S.sum_u += u;
+                    if (u > S.max_u) S.max_u = u;
+                    if (u >= 1.0) S.tight++;
+                    }
+                }
+            }
+
+
+        MT2004_64               _gen;       // RNG used to seed the probes
+        int                     _time_ms;   // total budget of the probes
+        int                     _win_len;   // target length of the windows
+        std::function<void(TreeSearch&)> _setup; // called on each probe
+    };
+
+
+
+/** end of file */
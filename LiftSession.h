@@ -0,0 +1,417 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include <functional>
+
+#include "Arm.h"
+#include "PotSon.h"
+#include "LKHtour.h"
+#include "Solution.h"
+#include "TreeSearch.h"
+
+
+
+/**
+* Lift the five parts of a tour concurrently under a global thread budget.
+*
+* The tour is split with splitTour() and each part gets its own pool of
+* TreeSearch objects (one thread each). Periodically, the threads are
+* redistributed: a part that is solved releases all its searches and the
+* budget goes preferably to the parts that are furthest from solved, measured
+* by bestpos() / tour size and by the time elapsed since the best position
+* last improved. A search added to a part starts from a random prefix of the
+* best path found so far for that part (read from the published snapshot, so
+* the donor is not paused).
+*
+* The session owns all the TreeSearch and RNG objects. Each lossless part is
+* saved in the binary path file [basename].X.lossless.skp (with the tour hash,
+* the part index and the seed of the search, see savePartial()) as soon as it
+* is found and solution() joins the five parts with patch().
+**/
+class LiftSession
+    {
+
+    public:
+
+        typedef std::function<Arm(int, Arm, iVec2, PotSon&, bool, TreeSearch*)> Heuristic;
+
+
+        /**
+        * Ctor.
+        *
+        * tour       : the complete LKH tour.
+        * basename   : prefix of the files where the lifted parts are saved.
+        * nb_threads : total number of search threads.
+        * seed       : seed for the RNGs of the searches.
+        **/
+        LiftSession(const std::vector<iVec2>& tour, const std::string& basename, int nb_threads, uint64 seed) : _basename(basename), _nb_threads(nb_threads), _gen(seed), _started(false)
+            {
+            if (_nb_threads < 1) _nb_threads = 1;
+            splitTour(tour, _part[0].tour, _part[1].tour, _part[2].tour, _part[3].tour, _part[4].tour);
+            for (int i = 0; i < 5; i++)
+                {
+                _part[i].ptour = PixelTour::make(_part[i].tour);
+                _part[i].name = std::string(1, (char)('A' + i));
+                _part[i].solved = false;
+                _part[i].bestpos = 0;
+                _part[i].ch.reset();
+                }
+            setRebalance();
+            }
+
+
+        /**
+        * Dtor. Stop and delete all the searches.
+        **/
+        ~LiftSession()
+            {
+            for (int i = 0; i < 5; i++) _part[i].inst.clear();
+            }
+
+
+        /**
+        * Set how often the threads are redistributed and the time without
+        * progress after which a part is considered stagnating.
+        **/
+        void setRebalance(int period_sec = 10, int stagnation_sec = 60)
+            {
+            _period = 1000 * ((period_sec < 1) ? 1 : period_sec);
+            _stagnation = (stagnation_sec < 1) ? 1.0 : ((double)stagnation_sec);
+            }
+
+
+        /**
+        * Change the thread budget. The threads are redistributed immediately
+        * if the session is started (the searches in excess are deleted).
+        **/
+        void setThreads(int nb_threads)
+            {
+            _nb_threads = (nb_threads < 1) ? 1 : nb_threads;
+            if (!_started) return;
+            _rebalance();
+            _chrebal.reset();
+            }
+
+
+        /**
+        * Number of threads of the session.
+        **/
+        int nbThreads() const
+            {
+            return _nb_threads;
+            }
+
+
+        /**
+        * Function called on each new TreeSearch object before it is started
+        * (to set its parameters).
+        **/
+        void setSetup(std::function<void(TreeSearch&)> setup)
+            {
+            _setup = setup;
+            }
+
+
+        /**
+        * Start the searches.
+        **/
+        void start(Heuristic fun)
+            {
+            MTOOLS_INSURE(!_started);
+            _fun = fun;
+            _started = true;
+            _rebalance();
+            _chrebal.reset();
+            }
+
+
+        /**
+        * Collect the solved parts and redistribute the threads when needed.
+        * Return true once all the parts are solved.
+        **/
+        bool update()
+            {
+            MTOOLS_INSURE(_started);
+            bool changed = false;
+            for (int i = 0; i < 5; i++)
+                {
+                if (_collect(i)) changed = true;
+                }
+            if (solved()) return true;
+            if ((changed) || (_chrebal.elapsed() > _period))
+                {
+                _rebalance();
+                _chrebal.reset();
+                }
+            return false;
+            }
+
+
+        /**
+        * Query if all the parts are lifted.
+        **/
+        bool solved() const
+            {
+            for (int i = 0; i < 5; i++) { if (!_part[i].solved) return false; }
+            return true;
+            }
+
+
+        /**
+        * The full solution (all the parts must be solved).
+        **/
+        std::vector<Arm> solution() const
+            {
+            MTOOLS_INSURE(solved());
+            return patch(_part[0].path.toVector(), _part[1].path.toVector(), _part[2].path.toVector(), _part[3].path.toVector(), _part[4].path.toVector());
+            }
+
+
+        /**
+        * Number of searches currently running.
+        **/
+        int nbRunning() const
+            {
+            int n = 0;
+            for (int i = 0; i < 5; i++) n += (int)_part[i].inst.size();
+            return n;
+            }
+
+
+        /**
+        * Print formattted info about the session (one line per part).
+        **/
+        std::string toString()
+            {
+            mtools::ostringstream oss;
+            oss << "part | length | threads |  maxpos | progress | stagnation\n";
+            for (int i = 0; i < 5; i++)
+                {
+                Part& P = _part[i];
+                oss << "  " << P.name << "  | "
+                    << justify_right(mtools::toString(P.tour.size()), 6) << " | ";
+                if (P.solved)
+                    {
+                    oss << "*** solved ***\n";
+                    continue;
+                    }
+                oss << justify_right(mtools::toString(P.inst.size()), 7) << " | "
+                    << justify_right(mtools::toString(P.bestpos), 7) << " | "
+                    << justify_right(mtools::doubleToStringNice(((int)(1000 * _progress(i))) / 10.0), 7) << "% | "
+                    << mtools::toString(P.ch.elapsed() / 1000) << "s\n";
+                }
+            oss << "threads : " << nbRunning() << " / " << _nb_threads << "\n";
+            return oss.toString();
+            }
+
+
+    private:
+
+
+        /** a search and its RNG (the RNG must outlive the search). */
+        struct Instance
+            {
+            std::unique_ptr<MT2004_64>  gen;
+            std::unique_ptr<TreeSearch> ts;
+            uint64                      seed;   // seed of gen
+            };
+
+
+        /** a part of the tour */
+        struct Part
+            {
+            std::string                 name;
+            std::vector<iVec2>          tour;
+            std::shared_ptr<const PixelTour> ptour; // the same, shared by the searches
+            std::vector<Instance>       inst;       // running searches
+            bool                        solved;
+            ArmPath                     path;       // the lossless lift once solved (packed)
+            int                         bestpos;    // best position over all the searches
+            Chrono                      ch;         // time since bestpos last improved
+            };
+
+
+        double _progress(int i) const
+            {
+            return ((double)_part[i].bestpos) / (_part[i].tour.size() - 1);
+            }
+
+
+        /**
+        * Update the best position of part i and collect its solution.
+        * Return true if the part was just solved.
+        **/
+        bool _collect(int i)
+            {
+            Part& P = _part[i];
+            if (P.solved) return false;
+            for (size_t k = 0; k < P.inst.size(); k++)
+                {
+                TreeSearch& TS = *(P.inst[k].ts);
+                if (TS.bestpos() > P.bestpos) { P.bestpos = TS.bestpos(); P.ch.reset(); }
+                if (!TS.solved()) continue;
+                const double l = TS.cumulative_loss();
+                if (l == 0)
+                    {
+                    TS.stopSearch();
+                    P.path = ArmPath(TS.bestPath());
+                    P.path.pack();
+                    TS.savePartial(_basename + "." + P.name + ".lossless.skp", i, P.inst[k].seed);
+                    P.solved = true;
+                    P.inst.clear(); // stop and delete all the searches of this part.
+                    return true;
+                    }
+                // solved with a loss: keep the file and free the thread.
+                TS.stopSearch();
+                TS.savePartial(_basename + "." + P.name + ".loss " + doubleToStringNice(((int)(l * 1000)) / 1000.0) + ".skp", i, P.inst[k].seed);
+                P.inst.erase(P.inst.begin() + k);
+                return true;
+                }
+            return false;
+            }
+
+
+        /**
+        * Create a new search for part i. It starts from a random prefix of the
+        * best path of the part (or from scratch if the part has no search yet).
+        **/
+        void _add(int i)
+            {
+            Part& P = _part[i];
+            Instance I;
+            I.seed = Unif_64(_gen);
+            I.gen.reset(new MT2004_64(I.seed));
+            I.ts.reset(new TreeSearch(P.ptour, *(I.gen)));
+            if (_setup) _setup(*(I.ts));
+            int ib = -1;
+            for (size_t k = 0; k < P.inst.size(); k++)
+                {
+                if ((ib < 0) || (P.inst[k].ts->bestpos() > P.inst[ib].ts->bestpos())) ib = (int)k;
+                }
+            if ((ib >= 0) && (P.inst[ib].ts->bestpos() > 0))
+                { // copy the published best path: the donor keeps running.
+                double loss = 0;
+                auto V = P.inst[ib].ts->bestSnapshot(&loss);
+                if ((V) && (V->size() > 1) && (V->size() < P.tour.size()) && (loss == 0))
+                    { // only lossless partial paths can be loaded.
+                    I.ts->loadPartial(*V);
+                    I.ts->resetAtBestRatio((float)(0.5 + 0.5 * Unif(_gen)));
+                    }
+                }
+            I.ts->search(_fun);
+            P.inst.push_back(std::move(I));
+            }
+
+
+        /**
+        * Remove the search of part i with the smallest best position.
+        **/
+        void _remove(int i)
+            {
+            Part& P = _part[i];
+            if (P.inst.size() == 0) return;
+            size_t iw = 0;
+            for (size_t k = 1; k < P.inst.size(); k++)
+                {
+                if (P.inst[k].ts->bestpos() < P.inst[iw].ts->bestpos()) iw = k;
+                }
+            P.inst.erase(P.inst.begin() + iw); // the dtor stops the search.
+            }
+
+
+        /**
+        * Compute the number of threads each part should get and move the
+        * threads accordingly.
+        **/
+        void _rebalance()
+            {
+            // how much each unsolved part needs more threads.
+            double need[5];
+            int target[5];
+            int nbu = 0;
+            double tot = 0;
+            for (int i = 0; i < 5; i++)
+                {
+                target[i] = 0;
+                need[i] = 0;
+                if (_part[i].solved) continue;
+                nbu++;
+                const double stag = (_part[i].ch.elapsed() / 1000.0) / _stagnation;
+                need[i] = (1.0 - _progress(i)) * (1.0 + stag) + 0.000001;
+                tot += need[i];
+                }
+            if (nbu == 0) return;
+
+            // one thread for each part (most needy first if the budget is too small)
+            // then the rest proportionally to the need (largest remainder).
+            int order[5] = { 0,1,2,3,4 };
+            std::sort(order, order + 5, [&](int a, int b) { return need[a] > need[b]; });
+            int left = _nb_threads;
+            for (int j = 0; (j < 5) && (left > 0); j++)
+                {
+                if (_part[order[j]].solved) continue;
+                target[order[j]] = 1;
+                left--;
+                }
+            const int R = left;
+            double rem[5];
+            for (int i = 0; i < 5; i++)
+                {
+                rem[i] = -1;
+                if (_part[i].solved) continue;
+                const double x = R * need[i] / tot;
+                target[i] += (int)x;
+                left -= (int)x;
+                rem[i] = x - (int)x;
+                }
+            while (left > 0)
+                {
+                int ib = 0;
+                for (int i = 1; i < 5; i++) { if (rem[i] > rem[ib]) ib = i; }
+                if (rem[ib] < 0) break;
+                target[ib]++;
+                rem[ib] = -1;
+                left--;
+                }
+
+            // remove the threads in excess (with some hysteresis) and add the missing ones.
+            for (int i = 0; i < 5; i++)
+                {
+                const int excess = (int)_part[i].inst.size() - target[i];
+                if ((excess > 1) || ((excess > 0) && (target[i] == 0)))
+                    {
+                    for (int k = 0; k < excess; k++) _remove(i);
+                    }
+                }
+            while (nbRunning() > _nb_threads)
+                { // budget lowered by setThreads(): no hysteresis.
+                int iw = 0;
+                for (int i = 1; i < 5; i++) { if ((int)_part[i].inst.size() - target[i] > (int)_part[iw].inst.size() - target[iw]) iw = i; }
+                _remove(iw);
+                }
+            for (int j = 0; j < 5; j++)
+                {
+                const int i = order[j];
+                while (((int)_part[i].inst.size() < target[i]) && (nbRunning() < _nb_threads)) _add(i);
+                }
+            }
+
+
+        std::string             _basename;      // prefix of the saved files
+        int                     _nb_threads;    // thread budget
+        MT2004_64               _gen;           // RNG used to seed the searches
+        bool                    _started;
+        Heuristic               _fun;           // heuristic used by all the searches
+        std::function<void(TreeSearch&)> _setup; // called on each new search
+        uint64                  _period;        // rebalance period (ms)
+        double                  _stagnation;    // stagnation time scale (s)
+        Chrono                  _chrebal;       // time since the last rebalance
+        Part                    _part[5];       // the five parts of the tour
+    };
+
+
+
+/** end of file */
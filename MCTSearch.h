@@ -0,0 +1,700 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include <shared_mutex>
+#include <unordered_set>
+
+#include "Arm.h"
+#include "PotSon.h"
+#include "Solution.h"
+
+
+
+/**
+* Monte-Carlo tree search for lifting a pixel tour (lossless moves only).
+*
+* The search keeps a committed prefix of the path. Below the last committed arm
+* we grow a tree of arm configurations: nodes are selected with the UCT rule and
+* evaluated with short random rollouts (built on PotSon::add()) measuring how
+* deep a random descent goes. Once the root has been visited enough, the most
+* visited son is committed and becomes the new root (tree reuse, the other
+* subtrees are reclaimed when the node arena is full). When every son of the
+* root is a dead end, the committed prefix is shortened and the dead
+* configuration is remembered.
+*
+* Rollouts are performed in parallel by several worker threads sharing the tree
+* without a global lock: the statistics of the nodes are atomics, a node is
+* expanded by the first worker that reaches it, and virtual loss spreads the
+* workers over distinct branches. Only the rare operations that rebuild the
+* tree (backtrack, compaction of the arena) wait for the workers to finish
+* their current rollout.
+*
+* The paths produced are lossless and can be saved with save() and loaded back
+* in a TreeSearch object with TreeSearch::loadPartial().
+**/
+class MCTSearch
+    {
+
+    public:
+
+
+        /**
+        * Ctor.
+        *
+        * tour        : the tour to lift (must start at the origin or a corner).
+        * gen         : RNG used to seed the workers.
+        * nb_threads  : number of worker threads.
+        **/
+        MCTSearch(const std::vector<iVec2>& tour, MT2004_64& gen, int nb_threads = 4) : _tour(tour), _gen(gen), _nb_threads(nb_threads), _nbnodes(0), _root(0), _full(false), _pending(false), _nbrollouts(0), _nbsteps(0), _nbrunning(0), _request_stop(false)
+            {
+            MTOOLS_INSURE(tour.size() > 1);
+            if (_nb_threads < 1) _nb_threads = 1;
+            _path.reserve(tour.size() + 10);
+            _path.push_back(Arm(tour[0])); // must be the origin or a corner.
+            _best = _path;
+            _bestsize = 1;
+            setParameters();
+            }
+
+
+        /**
+        * Dtor
+        **/
+        ~MCTSearch()
+            {
+            stopSearch();
+            }
+
+
+        /**
+        * Set the parameters of the search (the search must not be running).
+        *
+        * rollout_len   : maximum length of a rollout.
+        * commit_visits : number of visits of the root before committing its best son.
+        * uct_c         : exploration constant of the UCT rule.
+        * max_nodes     : size of the node arena (expansion stops when it is full).
+        **/
+        void setParameters(int rollout_len = 100, int commit_visits = 64, double uct_c = 0.7, int max_nodes = 2000000)
+            {
+            MTOOLS_INSURE(!isSearchOn());
+            _rollout_len = std::max(1, rollout_len);
+            _commit_visits = std::max(1, commit_visits);
+            _uct_c = uct_c;
+            _max_nodes = std::max(1000, max_nodes);
+            _chunks.clear();
+            _chunks.resize(((size_t)_max_nodes >> CHUNK_BITS) + 1);
+            _resetTree();
+            }
+
+
+        /**
+        * Start the worker threads.
+        **/
+        void search()
+            {
+            MTOOLS_INSURE(!isSearchOn());
+            _request_stop = false;
+            _nbrunning = _nb_threads; // set before the threads start so isSearchOn() is true on return.
+            for (int i = 0; i < _nb_threads; i++)
+                {
+                const uint64 seed = Unif_64(_gen) + i;
+                _workers.emplace_back(&MCTSearch::_threadproc, this, seed);
+                }
+            }
+
+
+        /**
+        * Stop the search and return when all the workers have ended.
+        **/
+        void stopSearch()
+            {
+            _request_stop = true;
+            for (auto& th : _workers) th.join();
+            _workers.clear();
+            _request_stop = false;
+            }
+
+
+        /**
+        * Query if the search is currently ongoing
+        **/
+        bool isSearchOn()
+            {
+            return ((int)_nbrunning > 0);
+            }
+
+
+        /**
+        * Query if we have a full solution.
+        **/
+        bool solved()
+            {
+            return (_bestsize == (int)_tour.size());
+            }
+
+
+        /**
+        * Length of the committed prefix (minus one).
+        **/
+        int pos()
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            return (int)_path.size() - 1;
+            }
+
+
+        /**
+        * Best position yet
+        **/
+        int bestpos()
+            {
+            return _bestsize - 1;
+            }
+
+
+        /**
+        * Total number of rollout steps performed.
+        **/
+        int64 nbsteps()
+            {
+            return (int64)_nbsteps;
+            }
+
+
+        /**
+        * Total number of rollouts performed.
+        **/
+        int64 nbrollouts()
+            {
+            return (int64)_nbrollouts;
+            }
+
+
+        /**
+        * Number of nodes in the arena (including the discarded subtrees not yet reclaimed).
+        **/
+        int treesize()
+            {
+            return std::min<int>(_nbnodes, _max_nodes);
+            }
+
+
+        /**
+        * Return the best (partial) solution found. Lossless so there is nothing to expand.
+        **/
+        const std::vector<Arm> bestPath()
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            return _best;
+            }
+
+
+        /**
+        * Return the currently committed prefix.
+        **/
+        const std::vector<Arm> currentPath()
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            return _path;
+            }
+
+
+        /**
+        * Save the best path into a file in csv format (same format as TreeSearch::save()).
+        **/
+        std::string save(std::string filename)
+            {
+            saveSolution(bestPath(), filename.c_str(), false);
+            return filename;
+            }
+
+
+        /**
+        * Restart the search from a partial (lossless) solution.
+        **/
+        void loadPartial(const std::vector<Arm>& Varm)
+            {
+            MTOOLS_INSURE(Varm.size() > 0);
+            MTOOLS_INSURE(Varm.size() <= _tour.size());
+            std::lock_guard<std::mutex> clock(_commitmut);
+            _exclusive([&]()
+                {
+                    {
+                    std::lock_guard<std::mutex> lock(_mut);
+                    _path = Varm;
+                    if (_path.size() > _best.size()) { _best = _path; _bestsize = (int)_best.size(); }
+                    }
+                    {
+                    std::lock_guard<std::mutex> lock(_deadmut);
+                    _dead.clear();
+                    }
+                _resetTree();
+                });
+            }
+
+
+        void loadPartial(const std::string& filename)
+            {
+            auto V = loadSolution(filename.c_str());
+            loadPartial(V);
+            }
+
+
+        /**
+        * Print formattted info about the search (one line).
+        **/
+        std::string toString()
+            {
+            int p, bp;
+                {
+                std::lock_guard<std::mutex> lock(_mut);
+                p = (int)_path.size() - 1;
+                bp = (int)_best.size() - 1;
+                }
+            mtools::ostringstream oss;
+            oss << justify_left(mtools::toString(nbsteps()), 11) << "| "
+                << justify_right(mtools::toString(p), 5) << " / "
+                << justify_left(mtools::toString(bp), 5) << " | "
+                << justify_right(mtools::toString(nbrollouts()), 10) << " | "
+                << justify_right(mtools::toString(treesize()), 8) << "\n";
+            return oss.toString();
+            }
+
+
+        /**
+        * Header for the toString function
+        **/
+        std::string header()
+            {
+            return "nb steps   |   pos  maxpos |  rollouts  |  nodes\n";
+            }
+
+
+        std::string hrule()
+            {
+            return "                                                  \n";
+            }
+
+
+    private:
+
+
+        static constexpr int CHUNK_BITS = 16;                   // the arena is allocated by chunks of 2^16 nodes
+        static constexpr int CHUNK_MASK = (1 << CHUNK_BITS) - 1;
+        static constexpr int64 VALUE_ONE = ((int64)1) << 20;     // fixed point unit for the rollout values
+
+        static constexpr int UNEXPANDED = -1;   // value of nbchild before the expansion
+        static constexpr int EXPANDING = -2;    // value of nbchild during the expansion
+
+
+        /** node of the search tree */
+        struct Node
+            {
+            Arm                 arm;        // configuration
+            int                 parent;     // index of the parent (-1 for the root of the arena)
+            int                 pos;        // index in the tour
+            std::atomic<int>    first;      // index of the first child (children are contiguous)
+            std::atomic<int>    nbchild;    // number of children (UNEXPANDED or EXPANDING before the expansion)
+            std::atomic<int>    visits;     // number of rollouts through this node
+            std::atomic<int>    vloss;      // virtual loss (rollouts in progress)
+            std::atomic<int64>  value;      // sum of the rollout values (fixed point)
+            std::atomic<bool>   dead;       // true if no lossless path goes through this node
+            };
+
+
+        /** worker thread */
+        void _threadproc(uint64 seed)
+            {
+            MT2004_64 gen(seed);
+            PotSon potson(gen);
+            std::vector<int> branch;
+            branch.reserve(1024);
+            while (!(bool)_request_stop)
+                {
+                if (solved()) break;
+                if ((bool)_pending) { std::this_thread::yield(); continue; } // the tree is being rebuilt.
+                    {
+                    std::shared_lock<std::shared_mutex> lock(_treemut);
+                    if (_select(potson, branch))
+                        {
+                        const int leaf = branch.back();
+                        const int startpos = _node(leaf).pos;
+                        for (int i : branch) _node(i).vloss++;
+                        const int len = _rollout(potson, _node(leaf).arm, startpos);
+                        _nbrollouts++;
+                        _nbsteps += len;
+                        const int64 v = (startpos + len == (int)_tour.size() - 1) ? VALUE_ONE : (VALUE_ONE * len) / _rollout_len;
+                        for (int i : branch)
+                            {
+                            Node& N = _node(i);
+                            N.vloss--;
+                            N.visits++;
+                            N.value += v;
+                            }
+                        if ((len == 0) && (startpos < (int)_tour.size() - 1) && (_node(leaf).nbchild.load() == 0)) _markDead(leaf); // fully expanded with no son: dead end
+                        }
+                    }
+                _commit();
+                }
+            _nbrunning--;
+            }
+
+
+        /**
+        * Select a leaf with the UCT rule from the root, expanding the nodes on the
+        * way. Return false if a dead node was found instead (the root may be dead).
+        * Must be called with the shared lock held.
+        **/
+        bool _select(PotSon& potson, std::vector<int>& branch)
+            {
+            branch.clear();
+            int u = _root;
+            while (1)
+                {
+                branch.push_back(u);
+                Node& N = _node(u);
+                if (N.pos == (int)_tour.size() - 1) return true; // reached the end of the tour.
+                int nc = N.nbchild.load(std::memory_order_acquire);
+                if (nc == UNEXPANDED)
+                    {
+                    _expand(u, potson);
+                    nc = N.nbchild.load(std::memory_order_acquire);
+                    }
+                if (nc < 0) return true; // tree full or expanded by another worker: rollout from here.
+                if (nc == 0) { _markDead(u); return false; }
+                if (N.dead) return false;
+                // UCT
+                const int first = N.first.load(std::memory_order_relaxed);
+                const double lnN = log((double)(N.visits + N.vloss) + 1.0);
+                double best = -1.0;
+                int ib = -1;
+                for (int k = 0; k < nc; k++)
+                    {
+                    const int c = first + k;
+                    const Node& C = _node(c);
+                    if (C.dead) continue;
+                    const int nv = C.visits + C.vloss;
+                    const double s = (nv == 0) ? (1.0e9 + Unif(potson.rng())) : ((((double)C.value) / VALUE_ONE) / nv + _uct_c * sqrt(lnN / nv)); // unvisited sons first, in random order
+                    if ((ib < 0) || (s > best)) { best = s; ib = c; }
+                    }
+                if (ib < 0) { _markDead(u); return false; }
+                if (_node(ib).visits + _node(ib).vloss == 0)
+                    { // first visit of this node: rollout from it.
+                    branch.push_back(ib);
+                    return true;
+                    }
+                u = ib;
+                }
+            }
+
+
+        /**
+        * Create the children of node u. Only the worker that switches the node from
+        * UNEXPANDED to EXPANDING does the work. The node is left unexpanded if the
+        * arena is full.
+        **/
+        void _expand(int u, PotSon& potson)
+            {
+            Node& N = _node(u);
+            int e = UNEXPANDED;
+            if (!N.nbchild.compare_exchange_strong(e, EXPANDING)) return;
+            potson.clear();
+            potson.add(N.arm, _tour[N.pos + 1], 0);
+            std::vector<Arm> sons;
+            sons.reserve(potson.size());
+                {
+                std::lock_guard<std::mutex> lock(_deadmut);
+                for (int i = 0; i < potson.size(); i++)
+                    {
+                    const Arm s = potson[i];
+                    if (_dead.find(_deadKey(s, N.pos + 1)) == _dead.end()) sons.push_back(s); // skip known dead ends.
+                    }
+                }
+            const int nb = (int)sons.size();
+            const int first = _alloc(nb);
+            if (first < 0) { N.nbchild.store(UNEXPANDED); return; }
+            for (int k = 0; k < nb; k++) _initNode(first + k, sons[k], u, N.pos + 1);
+            N.first.store(first, std::memory_order_relaxed);
+            N.nbchild.store(nb, std::memory_order_release);
+            }
+
+
+        /**
+        * Random descent from arm at index pos. Return the number of steps performed.
+        **/
+        int _rollout(PotSon& potson, Arm arm, int pos)
+            {
+            const int N = (int)_tour.size() - 1;
+            int len = 0;
+            while ((len < _rollout_len) && (pos < N))
+                {
+                potson.clear();
+                potson.add(arm, _tour[pos + 1], 0);
+                if (potson.size() == 0) break;
+                arm = potson.unif();
+                pos++;
+                len++;
+                }
+            return len;
+            }
+
+
+        /**
+        * Mark a node as dead and propagate to its ancestors when all their children
+        * are dead (a propagation missed because of a concurrent update is redone by
+        * _select() when it finds no live son).
+        **/
+        void _markDead(int u)
+            {
+            const int r = _root;
+            while (u >= 0)
+                {
+                Node& N = _node(u);
+                N.dead = true;
+                    {
+                    std::lock_guard<std::mutex> lock(_deadmut);
+                    _dead.insert(_deadKey(N.arm, N.pos));
+                    }
+                if (u == r) return;
+                const int p = N.parent;
+                if (p < 0) return;
+                const Node& P = _node(p);
+                const int first = P.first.load(std::memory_order_relaxed);
+                const int nc = P.nbchild.load(std::memory_order_acquire);
+                for (int k = 0; k < nc; k++)
+                    {
+                    if (!_node(first + k).dead) return;
+                    }
+                u = p;
+                }
+            }
+
+
+        /**
+        * Commit the best son of the root when it has been visited enough, or
+        * backtrack when the root is dead. Done by one worker at a time, the others
+        * skip it.
+        **/
+        void _commit()
+            {
+            std::unique_lock<std::mutex> clock(_commitmut, std::try_to_lock);
+            if (!clock.owns_lock()) return;
+            const Node& R = _node(_root);
+            if (R.dead)
+                { // backtrack
+                _exclusive([&]()
+                    {
+                        {
+                        std::lock_guard<std::mutex> lock(_mut);
+                        const int b = 1 + (int)Unif_int(0, 16, _gen);
+                        int L = (int)_path.size() - b;
+                        if (L < 1) L = 1;
+                        _path.resize(L);
+                        }
+                    _resetTree();
+                    });
+                return;
+                }
+            const int nc = R.nbchild.load(std::memory_order_acquire);
+            if (nc <= 0) return;
+            const int first = R.first.load(std::memory_order_relaxed);
+            int ib = -1;
+            int nblive = 0;
+            for (int k = 0; k < nc; k++)
+                {
+                const int c = first + k;
+                if (_node(c).dead) continue;
+                nblive++;
+                if ((ib < 0) || (_node(c).visits > _node(ib).visits)) ib = c;
+                }
+            if (ib < 0) return;
+            if ((nblive > 1) && (R.visits < _commit_visits)) return; // a single live son is committed at once.
+            bool clear_dead = false;
+                {
+                std::lock_guard<std::mutex> lock(_mut);
+                _path.push_back(_node(ib).arm);
+                if (_path.size() > _best.size())
+                    {
+                    _best = _path;
+                    _bestsize = (int)_best.size();
+                    clear_dead = true;
+                    }
+                }
+            if (clear_dead)
+                {
+                std::lock_guard<std::mutex> lock(_deadmut);
+                if (_dead.size() > 1000000) _dead.clear(); // keep memory bounded.
+                }
+            _root = ib; // reroot in place
+            if (_full) _exclusive([&]() { _compact(); });
+            }
+
+
+        /**
+        * Run f() once all the workers have finished their current rollout (and
+        * before they start a new one).
+        **/
+        template<typename F> void _exclusive(F f)
+            {
+            _pending = true;
+                {
+                std::unique_lock<std::shared_mutex> lock(_treemut);
+                f();
+                }
+            _pending = false;
+            }
+
+
+        /**
+        * Reclaim the arena: move the subtree of the root at the start of the arena.
+        * Must be called with the exclusive lock held.
+        **/
+        void _compact()
+            {
+            struct NodeCopy { Arm arm; int parent, pos, first, nbchild, visits; int64 value; bool dead; };
+            std::vector<NodeCopy> nn;
+            auto copy = [&](int i, int parent)
+                {
+                const Node& N = _node(i);
+                int nb = N.nbchild;
+                if (nb == EXPANDING) nb = UNEXPANDED;
+                nn.push_back({ N.arm, parent, N.pos, N.first, nb, N.visits, N.value, N.dead });
+                };
+            copy(_root, -1);
+            // breadth first copy: children stay contiguous.
+            for (size_t i = 0; i < nn.size(); i++)
+                {
+                const int of = nn[i].first;
+                const int nb = nn[i].nbchild;
+                if (nb <= 0) continue;
+                nn[i].first = (int)nn.size();
+                for (int k = 0; k < nb; k++) copy(of + k, (int)i);
+                }
+            for (size_t i = 0; i < nn.size(); i++)
+                {
+                const NodeCopy& C = nn[i];
+                _initNode((int)i, C.arm, C.parent, C.pos);
+                Node& N = _node((int)i);
+                N.first = C.first;
+                N.nbchild = C.nbchild;
+                N.visits = C.visits;
+                N.value = C.value;
+                N.dead = C.dead;
+                }
+            _nbnodes = (int)nn.size();
+            _root = 0;
+            _full = false;
+            }
+
+
+        /** Start a new tree at the end of the committed path. */
+        void _resetTree()
+            {
+            _nbnodes = 0;
+            _full = false;
+            std::lock_guard<std::mutex> lock(_mut);
+            const int r = _alloc(1);
+            _initNode(r, _path.back(), -1, (int)_path.size() - 1);
+            _root = r;
+            }
+
+
+        /** Reserve nb contiguous nodes in the arena. Return -1 (and set _full) if the arena is full. */
+        int _alloc(int nb)
+            {
+            const int i = _nbnodes.fetch_add(nb);
+            if (i + nb > _max_nodes) { _full = true; return -1; }
+            std::lock_guard<std::mutex> lock(_chunkmut);
+            for (int c = (i >> CHUNK_BITS); c <= ((i + nb - 1) >> CHUNK_BITS); c++)
+                {
+                if (_chunks[c] == nullptr) _chunks[c].reset(new Node[((size_t)1) << CHUNK_BITS]);
+                }
+            return i;
+            }
+
+
+        /** Initialize node i of the arena. */
+        void _initNode(int i, const Arm& arm, int parent, int pos)
+            {
+            Node& N = _node(i);
+            N.arm = arm;
+            N.parent = parent;
+            N.pos = pos;
+            N.first.store(-1, std::memory_order_relaxed);
+            N.nbchild.store(UNEXPANDED, std::memory_order_relaxed);
+            N.visits.store(0, std::memory_order_relaxed);
+            N.vloss.store(0, std::memory_order_relaxed);
+            N.value.store(0, std::memory_order_relaxed);
+            N.dead.store(false, std::memory_order_relaxed);
+            }
+
+
+        /** node at index i of the arena */
+        Node& _node(int i)
+            {
+            return _chunks[i >> CHUNK_BITS][i & CHUNK_MASK];
+            }
+
+
+        /** key for the set of dead configurations: the (configuration, index) pair itself */
+        typedef std::pair<uint64_t, int> DeadKey;
+
+        static DeadKey _deadKey(const Arm& a, int pos)
+            {
+            return DeadKey(a.val(), pos);
+            }
+
+        /** hash of a key (splitmix64 finalizer on the mixed pair) */
+        struct DeadKeyHash
+            {
+            size_t operator()(const DeadKey& k) const
+                {
+                uint64_t h = k.first ^ (((uint64_t)(uint32_t)k.second) * 0x9E3779B97F4A7C15ULL);
+                h = (h ^ (h >> 30)) * 0xBF58476D1CE4E5B9ULL;
+                h = (h ^ (h >> 27)) * 0x94D049BB133111EBULL;
+                return (size_t)(h ^ (h >> 31));
+                }
+            };
+
+
+        std::vector<iVec2>  _tour;          // the tour to lift
+        MT2004_64&          _gen;           // RNG (used by the committing worker)
+        int                 _nb_threads;    // number of workers
+
+        std::mutex          _mut;           // protects _path and _best.
+        std::vector<Arm>    _path;          // committed prefix
+        std::vector<Arm>    _best;          // longest committed prefix seen
+        std::atomic<int>    _bestsize;      // size of _best
+
+        std::vector<std::unique_ptr<Node[]>> _chunks;   // the node arena
+        std::mutex          _chunkmut;      // protects the allocation of the chunks
+        std::atomic<int>    _nbnodes;       // number of nodes allocated in the arena
+        std::atomic<int>    _root;          // index of the root in the arena
+        std::atomic<bool>   _full;          // true when an allocation failed
+
+        std::shared_mutex   _treemut;       // shared by the workers, exclusive to rebuild the tree
+        std::atomic<bool>   _pending;       // true while a thread waits for the exclusive lock
+        std::mutex          _commitmut;     // one commit at a time
+
+        std::mutex          _deadmut;       // protects _dead
+        std::unordered_set<DeadKey, DeadKeyHash> _dead; // dead (configuration, index) pairs
+
+        int                 _rollout_len;
+        int                 _commit_visits;
+        double              _uct_c;
+        int                 _max_nodes;
+
+        std::atomic<int64>  _nbrollouts;    // number of rollouts
+        std::atomic<int64>  _nbsteps;       // number of rollout steps
+        std::atomic<int>    _nbrunning;     // number of running workers
+        std::atomic<bool>   _request_stop;  // true to stop the workers
+
+        std::vector<std::thread> _workers;  // the worker threads
+    };
+
+
+
+/** end of file */
@@ -0,0 +1,68 @@
+#include "MappedFile.h"
+
+#if defined(_WIN32)
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile(const std::string& filename) : _data(nullptr), _size(0), _handle(nullptr)
+    {
+    HANDLE f = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+    if (f == INVALID_HANDLE_VALUE) return;
+    LARGE_INTEGER sz;
+    if ((!GetFileSizeEx(f, &sz)) || (sz.QuadPart == 0)) { CloseHandle(f); return; }
+    HANDLE m = CreateFileMappingA(f, NULL, PAGE_READONLY, 0, 0, NULL);
+    CloseHandle(f); // the mapping keeps the file open
+    if (m == NULL) return;
+    void* p = MapViewOfFile(m, FILE_MAP_READ, 0, 0, 0);
+    if (p == NULL) { CloseHandle(m); return; }
+    _data = (const char*)p;
+    _size = (size_t)sz.QuadPart;
+    _handle = (void*)m;
+    }
+
+
+MappedFile::~MappedFile()
+    {
+    if (_data) UnmapViewOfFile(_data);
+    if (_handle) CloseHandle((HANDLE)_handle);
+    }
+
+#else
+
+MappedFile::MappedFile(const std::string& filename) : _data(nullptr), _size(0), _handle(nullptr)
+    {
+    const int fd = open(filename.c_str(), O_RDONLY);
+    if (fd < 0) return;
+    struct stat st;
+    if ((fstat(fd, &st) != 0) || (st.st_size == 0)) { close(fd); return; }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps the file open
+    if (p == MAP_FAILED) return;
+    madvise(p, (size_t)st.st_size, MADV_SEQUENTIAL);
+    _data = (const char*)p;
+    _size = (size_t)st.st_size;
+    }
+
+
+MappedFile::~MappedFile()
+    {
+    if (_data) munmap((void*)_data, _size);
+    }
+
+#endif
+
+
+
+/** end of file */
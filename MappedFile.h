@@ -0,0 +1,48 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+
+
+/**
+* Read-only memory mapping of a whole file.
+*
+* The file is mapped with mmap() (or MapViewOfFile() on Windows) so reading it
+* does not copy it into a buffer first. The mapping is released by the dtor.
+* An empty or missing file gives an object with isOpen() false.
+**/
+class MappedFile
+    {
+
+    public:
+
+        /** Map a file (check isOpen()). */
+        explicit MappedFile(const std::string& filename);
+
+        /** Unmap the file. */
+        ~MappedFile();
+
+        MappedFile(const MappedFile&) = delete;
+        MappedFile& operator=(const MappedFile&) = delete;
+
+        /** Query if the file is mapped. */
+        bool isOpen() const { return (_data != nullptr); }
+
+        /** Start of the file. */
+        const char* data() const { return _data; }
+
+        /** Size of the file in bytes. */
+        size_t size() const { return _size; }
+
+    private:
+
+        const char* _data;
+        size_t      _size;
+        void*       _handle;    // file mapping handle (Windows only)
+    };
+
+
+
+/** end of file */
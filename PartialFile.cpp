@@ -0,0 +1,255 @@
+#include <mtools/mtools.hpp>
+using namespace mtools;
+
+#include "PartialFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+/* header of the binary path file */
+struct PartialBinaryHeader
+    {
+    char        magic[8];       // "SKPATH3"
+    uint32_t    nb_arms;        // Arm::NB_ARMS
+    uint32_t    code_bytes;     // sizeof(ArmPath::StepCode)
+    uint64_t    size;           // number of configurations
+    uint64_t    nb_escapes;     // number of steps stored in full
+    uint64_t    nb_inserted;    // number of configurations inserted by the expansion of the jumps
+    uint64_t    tour_hash;
+    int64_t     segment;
+    int64_t     start;
+    int64_t     end;
+    double      loss;
+    uint64_t    seed;
+    uint64_t    checksum;       // FNV-1a of the header (with checksum = 0) and of the body
+    };
+
+static const char PARTIAL_BINARY_MAGIC[8] = { 'S', 'K', 'P', 'A', 'T', 'H', '3', 0 };
+
+static const uint64_t FNV_OFFSET = 14695981039346656037ULL;
+static const uint64_t FNV_PRIME = 1099511628211ULL;
+
+
+
+/**
+* FNV-1a hash of a buffer, continuing from h.
+**/
+static uint64_t fnv1a(uint64_t h, const void* data, size_t len)
+    {
+    const unsigned char* p = (const unsigned char*)data;
+    for (size_t i = 0; i < len; i++) { h ^= p[i]; h *= FNV_PRIME; }
+    return h;
+    }
+
+
+/** size of the body parts (padded to 8 bytes) */
+static size_t nbKeys(size_t size) { return (size + PartialFile::KEY_PERIOD - 1) / PartialFile::KEY_PERIOD; }
+static size_t codesBytes(size_t size) { return ((size * sizeof(ArmPath::StepCode) + 7) / 8) * 8; }
+
+
+uint64 tourHash(const std::vector<iVec2>& tour)
+    {
+    uint64_t h = FNV_OFFSET;
+    for (const auto& P : tour)
+        {
+        const int32_t v[2] = { (int32_t)P.X(), (int32_t)P.Y() };
+        h = fnv1a(h, v, sizeof(v));
+        }
+    return h;
+    }
+
+
+void savePartial(const std::vector<Arm>& path, const std::string& filename, const PartialInfo& info, const std::vector<uint64>& inserted)
+    {
+    for (size_t i = 0; i < inserted.size(); i++) { MTOOLS_INSURE((inserted[i] < path.size()) && ((i == 0) || (inserted[i - 1] < inserted[i]))); }
+    const size_t N = path.size();
+    const size_t nk = nbKeys(N);
+    std::vector<uint64_t> keys(nk);
+    std::vector<ArmPath::StepCode> codes(codesBytes(N) / sizeof(ArmPath::StepCode), 0);
+    std::vector<uint64_t> esc;
+    for (size_t i = 0; i < N; i++)
+        {
+        if ((i % PartialFile::KEY_PERIOD) == 0) { keys[i / PartialFile::KEY_PERIOD] = path[i].val(); continue; }
+        codes[i] = ArmPath::encodeStep(path[i - 1], path[i]);
+        if (codes[i] == ArmPath::ESCAPE) { esc.push_back(i); esc.push_back(path[i].val()); }
+        }
+    PartialBinaryHeader H;
+    memset(&H, 0, sizeof(H));
+    memcpy(H.magic, PARTIAL_BINARY_MAGIC, 8);
+    H.nb_arms = Arm::NB_ARMS;
+    H.code_bytes = sizeof(ArmPath::StepCode);
+    H.size = N;
+    H.nb_escapes = esc.size() / 2;
+    H.nb_inserted = inserted.size();
+    H.tour_hash = info.tour_hash;
+    H.segment = info.segment;
+    H.start = info.start;
+    H.end = info.end;
+    H.loss = info.loss;
+    H.seed = info.seed;
+    H.checksum = 0;
+    uint64_t h = fnv1a(FNV_OFFSET, &H, sizeof(H));
+    h = fnv1a(h, keys.data(), keys.size() * sizeof(uint64_t));
+    h = fnv1a(h, codes.data(), codes.size() * sizeof(ArmPath::StepCode));
+    h = fnv1a(h, esc.data(), esc.size() * sizeof(uint64_t));
+    h = fnv1a(h, inserted.data(), inserted.size() * sizeof(uint64_t));
+    H.checksum = h;
+    FILE* f = fopen(filename.c_str(), "wb");
+    if (f == nullptr) { MTOOLS_ERROR(std::string("savePartial(): ERROR, CANNOT WRITE: ") + filename); }
+    bool ok = (fwrite(&H, sizeof(H), 1, f) == 1);
+    ok = ok && (fwrite(keys.data(), sizeof(uint64_t), keys.size(), f) == keys.size());
+    ok = ok && (fwrite(codes.data(), sizeof(ArmPath::StepCode), codes.size(), f) == codes.size());
+    ok = ok && (fwrite(esc.data(), sizeof(uint64_t), esc.size(), f) == esc.size());
+    ok = ok && (fwrite(inserted.data(), sizeof(uint64_t), inserted.size(), f) == inserted.size());
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) { MTOOLS_ERROR(std::string("savePartial(): ERROR, CANNOT WRITE: ") + filename); }
+    }
+
+
+bool isPartialFile(const std::string& filename)
+    {
+    FILE* f = fopen(filename.c_str(), "rb");
+    if (f == nullptr) return false;
+    char m[8];
+    const bool ok = (fread(m, 1, 8, f) == 8) && (memcmp(m, PARTIAL_BINARY_MAGIC, 8) == 0);
+    fclose(f);
+    return ok;
+    }
+
+
+PartialFile::PartialFile(const std::string& filename) : _file(filename), _size(0), _nbesc(0), _nbins(0), _keys(nullptr), _codes(nullptr), _esc(nullptr), _ins(nullptr)
+    {
+    if (!_file.isOpen()) return;
+    PartialBinaryHeader H;
+    if (_file.size() < sizeof(H)) { MTOOLS_ERROR(std::string("PartialFile [") << filename << "] : file too short."); }
+    memcpy(&H, _file.data(), sizeof(H));
+    if (memcmp(H.magic, PARTIAL_BINARY_MAGIC, 8) != 0) { MTOOLS_ERROR(std::string("PartialFile [") << filename << "] : not a binary path file."); }
+    if ((H.nb_arms != (uint32_t)Arm::NB_ARMS) || (H.code_bytes != sizeof(ArmPath::StepCode))) { MTOOLS_ERROR(std::string("PartialFile [") << filename << "] : wrong number of arms (" << H.nb_arms << ")."); }
+    const size_t N = (size_t)H.size;
+    const size_t lkeys = nbKeys(N) * sizeof(uint64_t);
+    const size_t lcodes = codesBytes(N);
+    const size_t lesc = (size_t)H.nb_escapes * 2 * sizeof(uint64_t);
+    const size_t lins = (size_t)H.nb_inserted * sizeof(uint64_t);
+    if (_file.size() != sizeof(H) + lkeys + lcodes + lesc + lins) { MTOOLS_ERROR(std::string("PartialFile [") << filename << "] : wrong file size."); }
+    _keys = _file.data() + sizeof(H);
+    _codes = _keys + lkeys;
+    _esc = _codes + lcodes;
+    _ins = _esc + lesc;
+    const uint64_t checksum = H.checksum;
+    H.checksum = 0;
+    if (fnv1a(fnv1a(FNV_OFFSET, &H, sizeof(H)), _keys, lkeys + lcodes + lesc + lins) != checksum) { MTOOLS_ERROR(std::string("PartialFile [") << filename << "] : checksum mismatch."); }
+    _size = N;
+    _nbesc = (size_t)H.nb_escapes;
+    _nbins = (size_t)H.nb_inserted;
+    _info.tour_hash = H.tour_hash;
+    _info.segment = H.segment;
+    _info.start = H.start;
+    _info.end = H.end;
+    _info.loss = H.loss;
+    _info.seed = H.seed;
+    }
+
+
+Arm PartialFile::_key(size_t k) const
+    {
+    uint64_t v;
+    memcpy(&v, _keys + k * sizeof(uint64_t), sizeof(v));
+    Arm a;
+    a.setVal(v);
+    return a;
+    }
+
+
+ArmPath::StepCode PartialFile::_code(size_t i) const
+    {
+    ArmPath::StepCode c;
+    memcpy(&c, _codes + i * sizeof(c), sizeof(c));
+    return c;
+    }
+
+
+Arm PartialFile::_escape(size_t i) const
+    {
+    size_t lo = 0, hi = _nbesc; // binary search on the (sorted) indices
+    while (lo < hi)
+        {
+        const size_t mid = (lo + hi) / 2;
+        uint64_t e[2];
+        memcpy(e, _esc + mid * sizeof(e), sizeof(e));
+        if (e[0] == i) { Arm a; a.setVal(e[1]); return a; }
+        if (e[0] < i) lo = mid + 1; else hi = mid;
+        }
+    MTOOLS_ERROR("PartialFile : missing escape step.");
+    return Arm();
+    }
+
+
+Arm PartialFile::operator[](size_t i) const
+    {
+    MTOOLS_ASSERT(i < _size);
+    size_t j = (i / KEY_PERIOD) * KEY_PERIOD;
+    Arm a = _key(j / KEY_PERIOD);
+    for (j++; j <= i; j++)
+        {
+        const ArmPath::StepCode c = _code(j);
+        a = (c == ArmPath::ESCAPE) ? _escape(j) : ArmPath::decodeStep(a, c);
+        }
+    return a;
+    }
+
+
+std::vector<Arm> PartialFile::toVector() const
+    {
+    std::vector<Arm> V(_size);
+    size_t e = 0; // next escape
+    Arm a;
+    for (size_t i = 0; i < _size; i++)
+        {
+        if ((i % KEY_PERIOD) == 0) { a = _key(i / KEY_PERIOD); }
+        else
+            {
+            const ArmPath::StepCode c = _code(i);
+            if (c == ArmPath::ESCAPE)
+                {
+                uint64_t x[2];
+                MTOOLS_INSURE(e < _nbesc);
+                memcpy(x, _esc + (e++) * sizeof(x), sizeof(x));
+                MTOOLS_INSURE(x[0] == i);
+                a.setVal(x[1]);
+                }
+            else a = ArmPath::decodeStep(a, c);
+            }
+        V[i] = a;
+        }
+    return V;
+    }
+
+
+
+std::vector<uint64> PartialFile::inserted() const
+    {
+    std::vector<uint64> I(_nbins);
+    if (_nbins > 0) memcpy(I.data(), _ins, _nbins * sizeof(uint64_t));
+    return I;
+    }
+
+
+std::vector<Arm> PartialFile::toTourVector() const
+    {
+    const std::vector<Arm> V = toVector();
+    std::vector<Arm> W;
+    W.reserve(V.size() - _nbins);
+    size_t j = 0; // next inserted configuration
+    for (size_t i = 0; i < V.size(); i++)
+        {
+        uint64_t x = 0;
+        if (j < _nbins) memcpy(&x, _ins + j * sizeof(x), sizeof(x));
+        if ((j < _nbins) && (x == i)) { j++; continue; }
+        W.push_back(V[i]);
+        }
+    return W;
+    }
+
+
+/** end of file */
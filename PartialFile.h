@@ -0,0 +1,118 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include "Arm.h"
+#include "ArmPath.h"
+#include "MappedFile.h"
+
+
+
+/**
+* Metadata stored in the header of a binary path file.
+**/
+struct PartialInfo
+    {
+    uint64  tour_hash = 0;      // tourHash() of the pixel tour lifted (0 = unknown)
+    int64   segment = -1;       // index of the part / segment of the tour (-1 = unknown)
+    int64   start = 0;          // index in the tour of the first configuration
+    int64   end = -1;           // index in the tour of the last configuration reached (-1 = unknown). The path has end - start + 1 configurations plus the ones inserted by the expansion of its lossy jumps.
+    double  loss = 0.0;         // cumulative loss of the path
+    uint64  seed = 0;           // seed of the search that found the path (0 = unknown)
+    };
+
+
+/**
+* Hash of a pixel tour (FNV-1a over the coordinates), used to check that a
+* partial path belongs to a given tour.
+**/
+uint64 tourHash(const std::vector<iVec2>& tour);
+
+
+/**
+* Save a (partial) path in the binary format: a header with the metadata,
+* followed by a full keyframe every KEY_PERIOD configurations and a step code
+* (2 bits per arm, see ArmPath::encodeStep()) for each configuration. The
+* steps that do not fit in a code (jumps) are stored in full at the end,
+* followed by the (sorted) indices of the configurations of 'path' inserted by
+* the expansion of the lossy jumps (see TreeSearch::savePartial()), so the
+* path with one configuration per tour index can be recovered exactly. The
+* header and the body are protected by a checksum.
+*
+* A lossless path takes about 2 bytes per configuration instead of ~30 in the
+* kaggle format.
+**/
+void savePartial(const std::vector<Arm>& path, const std::string& filename, const PartialInfo& info, const std::vector<uint64>& inserted = std::vector<uint64>());
+
+
+/**
+* Query if a file is a binary path file (checks the magic number only).
+**/
+bool isPartialFile(const std::string& filename);
+
+
+/**
+* Read-only access to a binary path file.
+*
+* The file is memory mapped and the configurations are decoded directly from
+* the mapping (no copy of the body). The header and the checksum are verified
+* by the ctor (MTOOLS_ERROR if the file is malformed). Random access decodes
+* at most KEY_PERIOD steps from the previous keyframe.
+**/
+class PartialFile
+    {
+
+    public:
+
+        static constexpr int KEY_PERIOD = ArmPath::KEY_PERIOD;      // distance between keyframes
+
+
+        /** Map and check a file (check isOpen(): false if the file does not exist). */
+        explicit PartialFile(const std::string& filename);
+
+        PartialFile(const PartialFile&) = delete;
+        PartialFile& operator=(const PartialFile&) = delete;
+
+        /** Query if the file is mapped. */
+        bool isOpen() const { return _file.isOpen(); }
+
+        /** Metadata of the path. */
+        const PartialInfo& info() const { return _info; }
+
+        /** Number of configurations. */
+        size_t size() const { return _size; }
+
+        /** Configuration i. */
+        Arm operator[](size_t i) const;
+
+        /** Decode the whole path. */
+        std::vector<Arm> toVector() const;
+
+        /** Indices of the configurations inserted by the expansion of the jumps (sorted). */
+        std::vector<uint64> inserted() const;
+
+        /** Decode the path without the inserted configurations (one per tour index). */
+        std::vector<Arm> toTourVector() const;
+
+    private:
+
+        Arm _key(size_t k) const;
+        Arm _escape(size_t i) const;
+        ArmPath::StepCode _code(size_t i) const;
+
+        MappedFile      _file;
+        PartialInfo     _info;
+        size_t          _size;      // number of configurations
+        size_t          _nbesc;     // number of steps stored in full
+        size_t          _nbins;     // number of inserted configurations
+        const char*     _keys;      // keyframes (uint64)
+        const char*     _codes;     // step codes
+        const char*     _esc;       // escapes: pairs (index, val) sorted by index
+        const char*     _ins;       // indices of the inserted configurations
+    };
+
+
+
+/** end of file */
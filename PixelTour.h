@@ -0,0 +1,159 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include <memory>
+
+#include "SantaImage.h"
+
+
+
+/**
+* Immutable pixel tour shared by all the searches lifting it.
+*
+* The coordinates are packed as int16 with the pixel id (index in the image)
+* and, for each edge (i -> i+1), the object keeps its L1 length, its color cost
+* (in color units, see ExactCost) and the length of the straight run of unit
+* moves starting there. The search loop reads the target id and the color of
+* the edge from here instead of recomputing them at each step.
+*
+* The object is created once with make() and passed to the searches as a
+* shared pointer so 10-50 searches on the same tour do not each hold a copy.
+**/
+class PixelTour
+    {
+
+    public:
+
+
+        /**
+        * Build the tour (the coordinates must fit the image).
+        **/
+        explicit PixelTour(const std::vector<iVec2>& tour)
+            {
+            const size_t N = tour.size();
+            _node.resize(N);
+            for (size_t i = 0; i < N; i++)
+                {
+                MTOOLS_INSURE((abs(tour[i].X()) <= SANTA_IMAGE_CX) && (abs(tour[i].Y()) <= SANTA_IMAGE_CY));
+                _node[i].x = (int16_t)tour[i].X();
+                _node[i].y = (int16_t)tour[i].Y();
+                _node[i].id = coord2id(tour[i]);
+                }
+            _edge.resize((N > 0) ? (N - 1) : 0);
+            for (int i = (int)N - 2; i >= 0; i--)
+                {
+                const iVec2 D = tour[i + 1] - tour[i];
+                Edge& E = _edge[i];
+                E.l1 = (int)(abs(D.X()) + abs(D.Y()));
+                E.col = distcolUnits(_node[i].id, _node[i + 1].id);
+                E.run = 0;
+                if (E.l1 != 1) continue;
+                E.run = ((i + 2 < (int)N) && (tour[i + 2] - tour[i + 1] == D)) ? (_edge[i + 1].run + 1) : 1;
+                }
+            }
+
+
+        /**
+        * Create a shared tour.
+        **/
+        static std::shared_ptr<const PixelTour> make(const std::vector<iVec2>& tour)
+            {
+            return std::make_shared<const PixelTour>(tour);
+            }
+
+
+        /** Number of pixels. */
+        size_t size() const
+            {
+            return _node.size();
+            }
+
+
+        /** Pixel i. */
+        iVec2 operator[](size_t i) const
+            {
+            return iVec2(_node[i].x, _node[i].y);
+            }
+
+
+        /** Pixel id of pixel i (index in the image arrays). */
+        int id(size_t i) const
+            {
+            return _node[i].id;
+            }
+
+
+        /** Move from pixel i to pixel i+1. */
+        iVec2 step(size_t i) const
+            {
+            return iVec2(_node[i + 1].x - _node[i].x, _node[i + 1].y - _node[i].y);
+            }
+
+
+        /** L1 length of the edge i -> i+1. */
+        int stepL1(size_t i) const
+            {
+            return _edge[i].l1;
+            }
+
+
+        /** Color cost of the edge i -> i+1 in color units (same as distcolUnits()). */
+        int colorUnits(size_t i) const
+            {
+            return _edge[i].col;
+            }
+
+
+        /** Cost of the edge i -> i+1 (same as distim()). */
+        double cost(size_t i) const
+            {
+            const int u = _edge[i].l1;
+            return (u > EDGE_L1_MAX) ? mtools::INF : (sqrt((double)u) + distcol(_node[i].id, _node[i + 1].id));
+            }
+
+
+        /**
+        * Length of the straight run starting at i: number of consecutive unit
+        * moves in the same direction from pixel i (0 if the edge i -> i+1 is not
+        * a unit move).
+        **/
+        int runLength(size_t i) const
+            {
+            return _edge[i].run;
+            }
+
+
+        /** Copy of the tour as a vector. */
+        std::vector<iVec2> toVector() const
+            {
+            std::vector<iVec2> V(_node.size());
+            for (size_t i = 0; i < _node.size(); i++) V[i] = (*this)[i];
+            return V;
+            }
+
+
+    private:
+
+        struct Node
+            {
+            int16_t x, y;   // coordinates
+            int32_t id;     // pixel id
+            };
+
+        struct Edge
+            {
+            int32_t col;    // color cost in color units
+            int32_t l1;     // L1 length
+            int32_t run;    // straight run length
+            };
+
+        std::vector<Node>   _node;  // packed pixels (read by the search loops)
+        std::vector<Edge>   _edge;  // precomputed edges
+    };
+
+
+
+/** end of file */
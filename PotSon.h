@@ -9,17 +9,21 @@ using namespace mtools;
 
 /**
 * Manage the potential son of an arm. 
+* 
+* Templated on the number of arms (PotSon is the instance for the arms of the
+* challenge).
 **/
-class PotSon
+template<int NARMS> class PotSonT
     {
 
+        typedef ArmT<NARMS> Arm;
 
     public:
 
         /**
         * Ctor, set the RNG. 
         **/
-        PotSon(MT2004_64  & gen) : _gen(gen)
+        PotSonT(MT2004_64  & gen) : _gen(gen)
             {
             _createNeighbour();
             clear();
@@ -48,7 +52,7 @@ class PotSon
             const iVec2 P = arm.pos() - target;
             _moveL1 = (int)(abs(P.X()) + abs(P.Y()));
             const int nb = _moveL1 + 2*detour;
-            if (nb > 8) return 0; 
+            if (nb > NARMS) return 0; 
             for (auto& m : _neig[nb])
                 {
                 const Arm s = arm + m;
@@ -67,7 +71,7 @@ class PotSon
         **/
         double penaltyL1(int detour)
             {
-            if (detour + 2 * detour > 8) return mtools::INF;
+            if (detour + 2 * detour > NARMS) return mtools::INF;
             return (sqrt((double)(_moveL1 + 2 * detour)) - sqrt((double)_moveL1));
             }
 
@@ -136,30 +140,26 @@ class PotSon
         int _moveL1; 
 
         // number of neighours depending on the number of non-zero angles. 
-        //  1  2   3    4    5    6    7   8
-        // 16 112 448 1120 1792 1792 1024 256
+        // (for 8 arms)  1  2   3    4    5    6    7   8
+        //              16 112 448 1120 1792 1792 1024 256
         void _createNeighbour()
             {
-            for (int u = 0; u < 6561; u++)
+            for (int u = 0; u < ArmDims<NARMS>::nbSteps(); u++)
                 {
-                int nb = 0;
-                int i = u;
-                int A7 = i % 3; i /= 3; if (A7 == 2) A7 = -1; if (A7 != 0) nb++;
-                int A6 = i % 3; i /= 3; if (A6 == 2) A6 = -1; if (A6 != 0) nb++;
-                int A5 = i % 3; i /= 3; if (A5 == 2) A5 = -1; if (A5 != 0) nb++;
-                int A4 = i % 3; i /= 3; if (A4 == 2) A4 = -1; if (A4 != 0) nb++;
-                int A3 = i % 3; i /= 3; if (A3 == 2) A3 = -1; if (A3 != 0) nb++;
-                int A2 = i % 3; i /= 3; if (A2 == 2) A2 = -1; if (A2 != 0) nb++;
-                int A1 = i % 3; i /= 3; if (A1 == 2) A1 = -1; if (A1 != 0) nb++;
-                int A0 = i % 3; i /= 3; if (A0 == 2) A0 = -1; if (A0 != 0) nb++;
-                _neig[nb].push_back(Arm(A7, A6, A5, A4, A3, A2, A1, A0));
+                int nb;
+                const Arm a = Arm::stepIncrement(u, nb);
+                _neig[nb].push_back(a);
                 }
             }
 
-        std::vector<Arm> _neig[9];
+        std::vector<Arm> _neig[NARMS + 1];
     };
 
 
+/** PotSon for the arms of the challenge. */
+typedef PotSonT<SANTA_NB_ARMS> PotSon;
+
+
 
 
     /** end of file */
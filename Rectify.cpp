@@ -6,7 +6,11 @@
 
 
 
-bool _rectok(std::vector<Arm>& vec, Arm e, int ind)
+inline void _setArm(std::vector<Arm>& vec, int i, const Arm& a) { vec[i] = a; }
+inline void _setArm(ArmPath& vec, int i, const Arm& a) { vec.set(i, a); }
+
+
+template<typename PATH> bool _rectok(PATH& vec, Arm e, int ind)
     {
     for (int i = ind + 1; i < (int)vec.size(); i++)
         {
@@ -15,7 +19,7 @@ bool _rectok(std::vector<Arm>& vec, Arm e, int ind)
     // ok, we can rectify !
     for (int i = ind + 1; i < (int)vec.size(); i++)
         {
-        vec[i] = vec[i] + e;
+        _setArm(vec, i, vec[i] + e);
         }
     return true;
     }
@@ -25,7 +29,7 @@ bool _rectok(std::vector<Arm>& vec, Arm e, int ind)
 * Try to insert a dir*1 for arm arm_index somewhere in the path
 * without changing the pixel visited.
 **/
-bool _insertmove(std::vector<Arm>& vec, int dir, int arm_index)
+template<typename PATH> bool _insertmove(PATH& vec, int dir, int arm_index)
     {
     for (int i = (int)vec.size() - 2; i >= 0; i--)
         {
@@ -73,12 +77,12 @@ bool _insertmove(std::vector<Arm>& vec, int dir, int arm_index)
 /**
 * Try to rectify a path to get closer to P at the end.
 **/
-int rectify(std::vector<Arm>& vec, iVec2 P)
+template<typename PATH> int _rectify(PATH& vec, iVec2 P)
     {
     int totmove = 0;
     Arm ada;
     ada.setZero();
-    for (int arm_index = 7; arm_index >= 0; arm_index--)
+    for (int arm_index = Arm::NB_ARMS - 1; arm_index >= 0; arm_index--)
         { // we are working with arm i, 
         Arm tip = vec.back() + ada; // make sure the arm with larger index contain the point
 
@@ -111,4 +115,17 @@ int rectify(std::vector<Arm>& vec, iVec2 P)
 
 
 
+int rectify(std::vector<Arm>& vec, iVec2 P)
+    {
+    return _rectify(vec, P);
+    }
+
+
+int rectify(ArmPath& vec, iVec2 P)
+    {
+    return _rectify(vec, P);
+    }
+
+
+
 /** end of file */
@@ -5,6 +5,7 @@
 using namespace mtools;
 
 #include "Arm.h"
+#include "ArmPath.h"
 
 
     /**
@@ -15,5 +16,11 @@ using namespace mtools;
     int rectify(std::vector<Arm>& vec, iVec2 P);
 
 
+    /**
+    * Same as above for a persistent path (only the blocks modified are copied).
+    **/
+    int rectify(ArmPath& vec, iVec2 P);
+
+
 
 /** end of file */
@@ -0,0 +1,59 @@
+#include <mtools/mtools.hpp>
+using namespace mtools;
+
+#include "SantaImage.h"
+
+#include <algorithm>
+
+
+PackedColor imPacked[SANTA_IMAGE_LX * SANTA_IMAGE_LY];
+
+double imPal[3][256];
+
+int imPalUnit[3][256];
+
+
+/**
+* Build the palettes and the packed color table from imR, imG, imB. The
+* palette values are also converted to integers (multiples of 1/255).
+* 
+* The compiled-in image arrays are constant initialized so they are already
+* set when this runs (during the dynamic initialization).
+**/
+static bool buildPackedColors()
+    {
+    const int N = SANTA_IMAGE_LX * SANTA_IMAGE_LY;
+    const double* im[3] = { imR, imG, imB };
+    for (int c = 0; c < 3; c++)
+        {
+        std::vector<double> V(im[c], im[c] + N);
+        std::sort(V.begin(), V.end());
+        V.erase(std::unique(V.begin(), V.end()), V.end());
+        MTOOLS_INSURE(V.size() <= 256);
+        for (int k = 0; k < 256; k++)
+            {
+            imPal[c][k] = V[std::min<size_t>(k, V.size() - 1)];
+            imPalUnit[c][k] = (int)std::lround(255 * imPal[c][k]);
+            MTOOLS_INSURE(fabs(255 * imPal[c][k] - imPalUnit[c][k]) < 0.000001); // the colors are multiples of 1/255
+            }
+        for (int i = 0; i < N; i++)
+            {
+            const uint8_t k = (uint8_t)(std::lower_bound(V.begin(), V.end(), im[c][i]) - V.begin());
+            if (c == 0) imPacked[i].r = k; else if (c == 1) imPacked[i].g = k; else imPacked[i].b = k;
+            imPacked[i].pad = 0;
+            }
+        }
+    return true;
+    }
+
+
+void buildImageTables()
+    {
+    buildPackedColors();
+    }
+
+
+static const bool image_tables_built = (buildImageTables(), true);
+
+
+/** end of file */
@@ -1,6 +1,9 @@
 #include "SantaImage.h"
 
 
+/* compiled-in image (fallback when no image is loaded at runtime, see loadImage()), only for 8 arms */
+#if (!defined(SANTA_NO_COMPILED_IMAGE)) && (SANTA_NB_ARMS == 8)
+
 double imB[SANTA_IMAGE_LX * SANTA_IMAGE_LY] = { 0.7137254901960784,0.8784313725490196,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177
     ,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177
     ,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177,0.8705882352941177
@@ -6199,6 +6202,14 @@ double imR[SANTA_IMAGE_LX * SANTA_IMAGE_LY] = { 0.403921568627451,0.427450980392
     ,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7098039215686275,0.7137254901960784
     ,0.6392156862745098 };
 
+#else
+
+double imB[SANTA_IMAGE_LX * SANTA_IMAGE_LY];
+double imG[SANTA_IMAGE_LX * SANTA_IMAGE_LY];
+double imR[SANTA_IMAGE_LX * SANTA_IMAGE_LY];
+
+#endif
+
 
 
 /** end of file */
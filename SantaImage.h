@@ -3,15 +3,57 @@
 #include <mtools/mtools.hpp>
 using namespace mtools;
 
-#define SANTA_IMAGE_LX 257
-#define SANTA_IMAGE_LY 257
-#define SANTA_IMAGE_CX 128
-#define SANTA_IMAGE_CY 128
+
+/**
+* Dimensions of the problem. The number of arms is a compile time parameter
+* (8 for the challenge, at most 9) and the image is [-C, C]^2 with
+* C = 2^(SANTA_NB_ARMS - 1) (257 x 257 for 8 arms, 129 x 129 for 7 arms,
+* 513 x 513 for 9 arms). The compiled-in image only exists for 8 arms: other
+* sizes load their image at runtime (see loadImage()).
+**/
+#ifndef SANTA_NB_ARMS
+#define SANTA_NB_ARMS 8
+#endif
+
+#define SANTA_IMAGE_CX (1 << (SANTA_NB_ARMS - 1))
+#define SANTA_IMAGE_CY (1 << (SANTA_NB_ARMS - 1))
+#define SANTA_IMAGE_LX (2 * SANTA_IMAGE_CX + 1)
+#define SANTA_IMAGE_LY (2 * SANTA_IMAGE_CY + 1)
 
 extern double imR[SANTA_IMAGE_LX * SANTA_IMAGE_LY];
 extern double imG[SANTA_IMAGE_LX * SANTA_IMAGE_LY];
 extern double imB[SANTA_IMAGE_LX * SANTA_IMAGE_LY];
 
+
+/**
+* Load the image at runtime, replacing the compiled-in one, and rebuild the
+* tables derived from it (packed colors and palettes). Must be called at
+* startup, before any tour or search is created.
+*
+* - loadImageCSV()    : competition CSV file (header line then x,y,r,g,b).
+* - loadImageBinary() : memory-mapped binary blob written by saveImageBinary()
+*                       (header then the three planar arrays of doubles).
+* - loadImage()       : either one, chosen from the extension.
+*
+* The channels must be 8-bit (multiples of 1/255). Return false if the file
+* cannot be opened (the current image is kept) and stop with an error if it is
+* malformed. Compile with SANTA_NO_COMPILED_IMAGE to leave the compiled-in
+* image out of the binary: an image must then be loaded before use.
+**/
+bool loadImageCSV(const std::string& filename);
+bool loadImageBinary(const std::string& filename);
+bool loadImage(const std::string& filename);
+
+/** Save the current image as a binary blob (for loadImageBinary()). */
+bool saveImageBinary(const std::string& filename);
+
+/** Where the current image comes from ("compiled-in", a filename or "" if none). */
+std::string imageSource();
+
+/** Rebuild the packed colors and the palettes from imR, imG, imB. */
+void buildImageTables();
+
+
 /*
 inline double colR(int x, int y) { return imR[(x + SANTA_IMAGE_CX) + SANTA_IMAGE_LX * (y + SANTA_IMAGE_CY)]; }
 inline double colG(int x, int y) { return imG[(x + SANTA_IMAGE_CX) + SANTA_IMAGE_LX * (y + SANTA_IMAGE_CY)]; }
@@ -19,6 +61,64 @@ inline double colB(int x, int y) { return imB[(x + SANTA_IMAGE_CX) + SANTA_IMAGE
 */
 
 
+/**
+* Packed color of a pixel: index of its red, green and blue values in the
+* palettes imPal[0], imPal[1], imPal[2]. Each channel of the image has at most
+* 256 distinct values so the palettes hold the exact doubles of imR, imG, imB.
+* The table is 4 bytes per pixel (264KB) instead of 3 x 8 bytes in three
+* separate arrays so a pixel is read from a single cache line.
+**/
+struct PackedColor
+    {
+    uint8_t r, g, b, pad;
+    };
+
+extern PackedColor imPacked[SANTA_IMAGE_LX * SANTA_IMAGE_LY];
+extern double imPal[3][256];
+extern int imPalUnit[3][256];   // the palette values as multiples of 1/255
+
+
+/**
+* Return the "color" distance between two pixels given by their ids (see
+* coord2id()). Same value (bit for bit) as the computation from imR, imG, imB.
+**/
+inline double distcol(int id1, int id2)
+    {
+    const PackedColor c1 = imPacked[id1];
+    const PackedColor c2 = imPacked[id2];
+    return 3 * (fabs(imPal[0][c1.r] - imPal[0][c2.r]) + fabs(imPal[1][c1.g] - imPal[1][c2.g]) + fabs(imPal[2][c1.b] - imPal[2][c2.b]));
+    }
+
+
+/**
+* Return the "color" distance between two pixels given by their ids as an
+* integer number of color units: distcol = 3 * units / 255 (see ExactCost).
+**/
+inline int distcolUnits(int id1, int id2)
+    {
+    const PackedColor c1 = imPacked[id1];
+    const PackedColor c2 = imPacked[id2];
+    return abs(imPalUnit[0][c1.r] - imPalUnit[0][c2.r]) + abs(imPalUnit[1][c1.g] - imPalUnit[1][c2.g]) + abs(imPalUnit[2][c1.b] - imPalUnit[2][c2.b]);
+    }
+
+
+/**
+* Largest L1 length of an edge with a finite cost (the number of arms).
+**/
+#define EDGE_L1_MAX SANTA_NB_ARMS
+
+
+/**
+* Return the "color" distance between two pixels as a number of color units.
+**/
+inline int distcolUnits(iVec2 P, iVec2 Q)
+    {
+    auto a1 = (P.X() + SANTA_IMAGE_CX) + SANTA_IMAGE_LX * (P.Y() + SANTA_IMAGE_CY);
+    auto a2 = (Q.X() + SANTA_IMAGE_CX) + SANTA_IMAGE_LX * (Q.Y() + SANTA_IMAGE_CY);
+    return distcolUnits((int)a1, (int)a2);
+    }
+
+
 /**
 * Return the "color" distance between two pixels.
 **/
@@ -26,20 +126,20 @@ inline double distcol(iVec2 P, iVec2 Q)
     {
     auto a1 = (P.X() + SANTA_IMAGE_CX) + SANTA_IMAGE_LX * (P.Y() + SANTA_IMAGE_CY);
     auto a2 = (Q.X() + SANTA_IMAGE_CX) + SANTA_IMAGE_LX * (Q.Y() + SANTA_IMAGE_CY);
-    return 3 * (fabs(imR[a1] - imR[a2]) + fabs(imG[a1] - imG[a2]) + fabs(imB[a1] - imB[a2]));
+    return distcol((int)a1, (int)a2);
     }
 
 
 /**
 * Return the image distance i.e. sqrt(L1 norm) + colorDist.
+* The square roots are read from a table (same values as sqrt()).
 **/
 inline double distim(iVec2 P, iVec2 Q)
     {
     auto u = abs(P.X() - Q.X()) + abs(P.Y() - Q.Y());
-    if (u > 8) return mtools::INF;
-    double dl = sqrt((double)u);
-    double dc = distcol(P,Q);
-    return dl + dc;
+    if (u > EDGE_L1_MAX) return mtools::INF;
+    static const double SQ[10] = { 0.0, 1.0, 1.4142135623730951, 1.7320508075688772, 2.0, 2.23606797749979, 2.449489742783178, 2.6457513110645907, 2.8284271247461903, 3.0 };
+    return SQ[u] + distcol(P, Q);
     }
 
 
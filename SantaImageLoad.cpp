@@ -0,0 +1,183 @@
+#include <mtools/mtools.hpp>
+using namespace mtools;
+
+#include "SantaImage.h"
+#include "MappedFile.h"
+
+#include <cstring>
+
+
+#if (!defined(SANTA_NO_COMPILED_IMAGE)) && (SANTA_NB_ARMS == 8)
+static std::string image_source = "compiled-in";
+#else
+static std::string image_source = "";
+#endif
+
+
+/* header of the binary image file */
+struct ImageBinaryHeader
+    {
+    char    magic[8];   // "SKIMG01"
+    int32_t lx, ly;     // image size
+    };
+
+static const char IMAGE_BINARY_MAGIC[8] = { 'S', 'K', 'I', 'M', 'G', '0', '1', 0 };
+
+
+
+/**
+* Check that a channel value is an 8-bit color (multiple of 1/255 in [0,1]).
+**/
+static bool isImageChannel(double v)
+    {
+    if ((!(v >= 0)) || (v > 1)) return false;
+    return (fabs(255 * v - std::round(255 * v)) < 0.000001);
+    }
+
+
+/**
+* Copy the new image in imR, imG, imB and rebuild the derived tables.
+**/
+static void setImage(const std::vector<double>& R, const std::vector<double>& G, const std::vector<double>& B, const std::string& source)
+    {
+    const int N = SANTA_IMAGE_LX * SANTA_IMAGE_LY;
+    for (int i = 0; i < N; i++)
+        {
+        if ((!isImageChannel(R[i])) || (!isImageChannel(G[i])) || (!isImageChannel(B[i])))
+            {
+            MTOOLS_ERROR(std::string("Image [") << source << "] : pixel " << i << " is not an 8-bit color.");
+            }
+        imR[i] = R[i];
+        imG[i] = G[i];
+        imB[i] = B[i];
+        }
+    buildImageTables();
+    image_source = source;
+    }
+
+
+/**
+* Parse the next field of a CSV line (up to ',' or the end of the line) into
+* buf. Return the position after the separator.
+**/
+static const char* csvField(const char* p, const char* end, char* buf, size_t lbuf)
+    {
+    size_t n = 0;
+    while ((p < end) && (*p != ',') && (*p != '\n') && (*p != '\r'))
+        {
+        if (n + 1 < lbuf) buf[n++] = *p;
+        p++;
+        }
+    buf[n] = 0;
+    if ((p < end) && (*p == ',')) p++;
+    return p;
+    }
+
+
+bool loadImageCSV(const std::string& filename)
+    {
+    MappedFile F(filename);
+    if (!F.isOpen()) return false;
+    const int N = SANTA_IMAGE_LX * SANTA_IMAGE_LY;
+    std::vector<double> R(N), G(N), B(N);
+    std::vector<char> seen(N, 0);
+    int nb = 0;
+    const char* p = F.data();
+    const char* end = p + F.size();
+    int64 line = 0;
+    char buf[5][64];
+    while (p < end)
+        {
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (eol == nullptr) eol = end;
+        line++;
+        const char* q = p;
+        while ((q < eol) && ((*q == ' ') || (*q == '\t') || (*q == '\r'))) q++;
+        if ((q == eol) || ((line == 1) && (!isdigit((unsigned char)*q)) && (*q != '-') && (*q != '+')))
+            { // empty line or header
+            p = eol + ((eol < end) ? 1 : 0);
+            continue;
+            }
+        for (int k = 0; k < 5; k++) q = csvField(q, eol, buf[k], 64);
+        char* e[5];
+        const long x = strtol(buf[0], &e[0], 10);
+        const long y = strtol(buf[1], &e[1], 10);
+        const double r = strtod(buf[2], &e[2]);
+        const double g = strtod(buf[3], &e[3]);
+        const double b = strtod(buf[4], &e[4]);
+        for (int k = 0; k < 5; k++)
+            {
+            if ((e[k] == buf[k]) || (*e[k] != 0)) { MTOOLS_ERROR(std::string("Image [") << filename << "] : malformed line " << line); }
+            }
+        if ((labs(x) > SANTA_IMAGE_CX) || (labs(y) > SANTA_IMAGE_CY)) { MTOOLS_ERROR(std::string("Image [") << filename << "] : pixel out of range at line " << line); }
+        const int id = coord2id({ (int64)x, (int64)y });
+        if (seen[id]) { MTOOLS_ERROR(std::string("Image [") << filename << "] : duplicate pixel at line " << line); }
+        seen[id] = 1;
+        R[id] = r;
+        G[id] = g;
+        B[id] = b;
+        nb++;
+        p = eol + ((eol < end) ? 1 : 0);
+        }
+    if (nb != N) { MTOOLS_ERROR(std::string("Image [") << filename << "] : " << nb << " pixels instead of " << N); }
+    setImage(R, G, B, filename);
+    return true;
+    }
+
+
+bool loadImageBinary(const std::string& filename)
+    {
+    MappedFile F(filename);
+    if (!F.isOpen()) return false;
+    const int N = SANTA_IMAGE_LX * SANTA_IMAGE_LY;
+    ImageBinaryHeader H;
+    if (F.size() < sizeof(H)) { MTOOLS_ERROR(std::string("Image [") << filename << "] : file too short."); }
+    memcpy(&H, F.data(), sizeof(H));
+    if (memcmp(H.magic, IMAGE_BINARY_MAGIC, 8) != 0) { MTOOLS_ERROR(std::string("Image [") << filename << "] : not a binary image file."); }
+    if ((H.lx != SANTA_IMAGE_LX) || (H.ly != SANTA_IMAGE_LY)) { MTOOLS_ERROR(std::string("Image [") << filename << "] : wrong image size."); }
+    if (F.size() != sizeof(H) + 3 * sizeof(double) * N) { MTOOLS_ERROR(std::string("Image [") << filename << "] : wrong file size."); }
+    std::vector<double> R(N), G(N), B(N);
+    const char* p = F.data() + sizeof(H);
+    memcpy(R.data(), p, sizeof(double) * N);
+    memcpy(G.data(), p + sizeof(double) * N, sizeof(double) * N);
+    memcpy(B.data(), p + 2 * sizeof(double) * N, sizeof(double) * N);
+    setImage(R, G, B, filename);
+    return true;
+    }
+
+
+bool loadImage(const std::string& filename)
+    {
+    std::string ext = (filename.size() >= 4) ? filename.substr(filename.size() - 4) : std::string("");
+    for (auto& c : ext) c = (char)tolower(c);
+    if (ext == ".csv") return loadImageCSV(filename);
+    return loadImageBinary(filename);
+    }
+
+
+bool saveImageBinary(const std::string& filename)
+    {
+    const int N = SANTA_IMAGE_LX * SANTA_IMAGE_LY;
+    FILE* f = fopen(filename.c_str(), "wb");
+    if (f == nullptr) return false;
+    ImageBinaryHeader H;
+    memcpy(H.magic, IMAGE_BINARY_MAGIC, 8);
+    H.lx = SANTA_IMAGE_LX;
+    H.ly = SANTA_IMAGE_LY;
+    bool ok = (fwrite(&H, sizeof(H), 1, f) == 1);
+    ok = ok && (fwrite(imR, sizeof(double), N, f) == (size_t)N);
+    ok = ok && (fwrite(imG, sizeof(double), N, f) == (size_t)N);
+    ok = ok && (fwrite(imB, sizeof(double), N, f) == (size_t)N);
+    ok = (fclose(f) == 0) && ok;
+    return ok;
+    }
+
+
+std::string imageSource()
+    {
+    return image_source;
+    }
+
+
+
+/** end of file */
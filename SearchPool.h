@@ -0,0 +1,279 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include <functional>
+#include <mutex>
+#include <condition_variable>
+
+#include "Arm.h"
+#include "PotSon.h"
+#include "TreeSearch.h"
+
+
+
+/**
+* Run many searches on a fixed number of worker threads.
+*
+* Each search is started with TreeSearch::cooperativeSearch() and runs by
+* slices of 'slice' steps. A worker repeatedly picks the idle search with the
+* smallest virtual time, runs one slice and advances the virtual time of the
+* search by 1 / weight where
+*
+*         weight = 1 + priority * (bestpos / tour length)
+*
+* so the searches that progress the most get more slices but none of them
+* starves (weighted fair queuing). This allows hundreds of searches (different
+* seeds, temperatures, ...) with one thread per core. A paused search is parked
+* (not picked by the workers) until it is resumed or stopped.
+*
+* The pool owns the searches and their RNGs. They are deleted with the pool.
+**/
+class SearchPool
+    {
+
+    public:
+
+
+        /**
+        * Ctor. Start the workers.
+        *
+        * nb_workers : number of worker threads (0 = number of cores).
+        * slice      : number of search steps per slice.
+        * priority   : how much the progress of a search increases its share.
+        **/
+        SearchPool(int nb_workers = 0, int slice = 4096, double priority = 4.0) : _slice((slice < 1) ? 1 : slice), _priority((priority < 0) ? 0 : priority), _stop(false), _vtime(0), _nbslices(0)
+            {
+            if (nb_workers <= 0) nb_workers = (int)std::thread::hardware_concurrency();
+            if (nb_workers <= 0) nb_workers = 1;
+            for (int i = 0; i < nb_workers; i++) _workers.push_back(std::thread(&SearchPool::_workerproc, this));
+            }
+
+
+        /**
+        * Dtor. Stop the workers and delete the searches.
+        **/
+        ~SearchPool()
+            {
+                {
+                std::lock_guard<std::mutex> lock(_mut);
+                _stop = true;
+                }
+            _cv.notify_all();
+            for (auto& th : _workers) th.join();
+            for (auto& T : _tasks) T->ts->stopSearch(); // while the tasks are alive (stopping calls the resume hook)
+            _tasks.clear();
+            }
+
+
+        /**
+        * Add a search on a tour. Return its index in the pool.
+        *
+        * setup : function called on the new TreeSearch object before it is
+        *         started (to set its parameters) or nullptr.
+        **/
+        template<typename HEURISTIC> int add(const std::vector<iVec2>& tour, uint64 seed, HEURISTIC fun, std::function<void(TreeSearch&)> setup = nullptr)
+            {
+            return add(PixelTour::make(tour), seed, fun, setup);
+            }
+
+
+        /**
+        * Add a search on a shared tour (use it when many searches lift the
+        * same tour). Return its index in the pool.
+        **/
+        template<typename HEURISTIC> int add(std::shared_ptr<const PixelTour> tour, uint64 seed, HEURISTIC fun, std::function<void(TreeSearch&)> setup = nullptr)
+            {
+            std::unique_ptr<Task> T(new Task);
+            T->gen.reset(new MT2004_64(seed));
+            T->ts.reset(new TreeSearch(tour, *(T->gen)));
+            if (setup) setup(*(T->ts));
+            Task* P = T.get();
+            T->run = T->ts->cooperativeSearch(fun, [this, P]() { _unpark(P); });
+            T->running = false;
+            T->parked = false;
+            T->done = false;
+            int id;
+                {
+                std::lock_guard<std::mutex> lock(_mut);
+                T->vtime = _vtime; // start with the current virtual time.
+                _tasks.push_back(std::move(T));
+                id = (int)_tasks.size() - 1;
+                }
+            _cv.notify_one();
+            return id;
+            }
+
+
+        /**
+        * Number of searches in the pool.
+        **/
+        int size()
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            return (int)_tasks.size();
+            }
+
+
+        /**
+        * Search number i. It can be paused, saved, stopped... as a threaded
+        * search. The reference is valid until the pool is deleted.
+        **/
+        TreeSearch& operator[](int i)
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            return *(_tasks[i]->ts);
+            }
+
+
+        /**
+        * Number of searches not over yet.
+        **/
+        int nbActive()
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            int n = 0;
+            for (auto& T : _tasks) { if (!T->done) n++; }
+            return n;
+            }
+
+
+        /**
+        * Index of a search that solved its tour (-1 if none).
+        **/
+        int solvedIndex()
+            {
+            std::lock_guard<std::mutex> lock(_mut);
+            for (size_t i = 0; i < _tasks.size(); i++) { if ((_tasks[i]->done) && (_tasks[i]->ts->solved())) return (int)i; }
+            return -1;
+            }
+
+
+        /**
+        * Number of workers.
+        **/
+        int nbWorkers() const
+            {
+            return (int)_workers.size();
+            }
+
+
+        /**
+        * Total number of slices run.
+        **/
+        int64 nbSlices() const
+            {
+            return (int64)_nbslices;
+            }
+
+
+        /**
+        * Print formattted info about the pool (best searches first).
+        **/
+        std::string toString(int maxlines = 20)
+            {
+            std::vector<std::pair<int, int>> V; // (bestpos, index)
+            int act;
+                {
+                std::lock_guard<std::mutex> lock(_mut);
+                act = 0;
+                for (size_t i = 0; i < _tasks.size(); i++)
+                    {
+                    if (!_tasks[i]->done) act++;
+                    V.push_back({ _tasks[i]->ts->bestpos(), (int)i });
+                    }
+                }
+            std::sort(V.begin(), V.end(), [](const std::pair<int, int>& a, const std::pair<int, int>& b) { return a.first > b.first; });
+            mtools::ostringstream oss;
+            oss << "searches : " << V.size() << " (" << act << " active)   workers : " << _workers.size() << "   slices : " << nbSlices() << "\n";
+            for (int k = 0; (k < (int)V.size()) && (k < maxlines); k++)
+                {
+                oss << justify_right(mtools::toString(V[k].second), 5) << " | maxpos " << justify_right(mtools::toString(V[k].first), 7) << "\n";
+                }
+            return oss.toString();
+            }
+
+
+    private:
+
+
+        /** a cooperative search */
+        struct Task
+            {
+            std::unique_ptr<MT2004_64>      gen;        // RNG (must outlive the search)
+            std::unique_ptr<TreeSearch>     ts;         // the search
+            std::function<bool(int64)>      run;        // run a slice
+            double                          vtime;      // virtual time
+            bool                            running;    // a worker is running a slice
+            bool                            parked;     // paused: not picked until resumed
+            bool                            done;       // the search is over
+            };
+
+
+        /** pick the idle task with the smallest virtual time (lock must be held) */
+        Task* _pick()
+            {
+            Task* B = nullptr;
+            for (auto& T : _tasks)
+                {
+                if ((T->running) || (T->parked) || (T->done)) continue;
+                if ((B == nullptr) || (T->vtime < B->vtime)) B = T.get();
+                }
+            return B;
+            }
+
+
+        /** worker thread */
+        void _workerproc()
+            {
+            std::unique_lock<std::mutex> lock(_mut);
+            while (1)
+                {
+                Task* T = nullptr;
+                _cv.wait(lock, [&] { return (_stop) || ((T = _pick()) != nullptr); });
+                if (_stop) return;
+                T->running = true;
+                _vtime = T->vtime;
+                lock.unlock();
+
+                const bool over = T->run(_slice);
+                const double w = 1.0 + _priority * ((double)T->ts->bestpos()) / ((double)T->ts->tour().size());
+                _nbslices++;
+
+                lock.lock();
+                T->vtime += 1.0 / w;
+                T->running = false;
+                if (over) T->done = true;
+                else if (T->ts->isPaused()) T->parked = true; // checked under the lock: _unpark() cannot be missed.
+                else _cv.notify_one();
+                }
+            }
+
+
+        /** resume hook of a task: make it available to the workers again */
+        void _unpark(Task* T)
+            {
+                {
+                std::lock_guard<std::mutex> lock(_mut);
+                T->parked = false;
+                }
+            _cv.notify_one();
+            }
+
+
+        int                                 _slice;     // steps per slice
+        double                              _priority;  // weight of the progress
+        std::vector<std::thread>            _workers;   // worker threads
+        std::vector<std::unique_ptr<Task>>  _tasks;     // the searches
+        std::mutex                          _mut;       // protects the tasks
+        std::condition_variable             _cv;        // signals new idle tasks
+        bool                                _stop;      // workers must exit
+        double                              _vtime;     // virtual time of the last task started
+        std::atomic<int64>                  _nbslices;  // number of slices run
+    };
+
+
+
+/** end of file */
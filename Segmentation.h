@@ -0,0 +1,629 @@
+#pragma once
+
+
+#include "mtools/mtools.hpp"
+using namespace mtools;
+
+#include <functional>
+#include <set>
+
+#include "Arm.h"
+#include "PotSon.h"
+#include "cutTime.h"
+#include "distanceArm.h"
+#include "TreeSearch.h"
+#include "BridgeSearch.h"
+
+
+
+/**
+* Lift a tour (one of the five parts) by cutting it into many segments that
+* are solved in parallel and stitched together.
+*
+* The cut indices are taken among the primary cut times of the tour (where
+* the configuration of the largest arm is constrained). Cut times are rare, so
+* when two consecutive ones are too far apart, the segment is cut at evenly
+* spaced indices instead.
+*
+* The first segment starts from the configuration at tour[0] (origin or
+* corner). Every interior boundary gets a small set of candidate configurations:
+* among the extremal configurations (128 for 8 arms) reaching the boundary
+* pixel from the first candidate of the previous boundary (Arm::pathToReach),
+* we keep those that rotate the arms the least (closestCandidates()). These
+* guesses let all the segments start at once. Each time a lossless lift of a
+* segment is found, a search of the next segment is also queued 'overlap'
+* indices before the boundary, at the configuration of that lift: it can be
+* appended exactly to a prefix ending with that lift and it may backtrack
+* across the boundary. At most 'nb_threads' searches run at once, the segments
+* closest to the start first.
+*
+* The stitched prefix grows from the start of the tour. A lift of the next
+* segment is appended if its starting configuration is the configuration of
+* the prefix at the same index. Otherwise we look for a short lossless bridge
+* between the prefix 'gap' indices before the boundary and the lift 'gap'
+* indices after it (increasing gaps). If nothing works, a new search of the
+* segment is started from the prefix, 'overlap' indices before the boundary
+* (so it can always be appended) and, if lossy stitching is enabled, the end of
+* the prefix may also jump to the configuration of a lift at the next index
+* with a short lossy path (at most MAX_JUMP steps).
+**/
+class SegmentedLift
+    {
+
+    public:
+
+        typedef std::function<Arm(int, Arm, iVec2, PotSon&, bool, TreeSearch*)> Heuristic;
+
+        static constexpr int MAX_JUMP = 4; // maximum number of steps of a lossy jump.
+
+
+        /**
+        * Ctor.
+        *
+        * tour          : the tour to lift (tour[0] must be the origin or a corner).
+        * seed          : seed for the RNGs of the searches.
+        * seg_len       : target length of the segments.
+        * nb_candidates : number of candidate configurations at each interior boundary.
+        * nb_threads    : maximum number of searches running at once (0 = number of cores).
+        **/
+        SegmentedLift(const std::vector<iVec2>& tour, uint64 seed, int seg_len = 2000, int nb_candidates = 2, int nb_threads = 0) : _tour(tour), _gen(seed), _potson(_gen), _started(false), _stitched(0), _nbbridges(0), _nbrepairs(0), _nbjumps(0)
+            {
+            setThreads(nb_threads);
+            MTOOLS_INSURE(tour.size() > 1);
+            if (seg_len < 16) seg_len = 16;
+            if (nb_candidates < 1) nb_candidates = 1;
+            _cuts = chooseCuts(tour, seg_len);
+            _seg.resize(_cuts.size() - 1);
+            for (size_t k = 0; k < _seg.size(); k++)
+                {
+                _seg[k].tour = PixelTour::make(std::vector<iVec2>(tour.begin() + _cuts[k], tour.begin() + _cuts[k + 1] + 1));
+                _seg[k].repaired = false;
+                }
+            _makeCandidates(nb_candidates);
+            _prefix.reserve(tour.size());
+            _prefix.push_back(_seg[0].cand[0]);
+            setStitching();
+            }
+
+
+        /**
+        * Dtor. Stop and delete all the searches.
+        **/
+        ~SegmentedLift()
+            {
+            for (auto& S : _seg) S.inst.clear();
+            }
+
+
+        /**
+        * Set the largest bridge tried between two segments, whether two segments
+        * may be joined with a short lossy jump when no bridge is found and how
+        * many indices before a boundary the chained and repair searches start.
+        **/
+        void setStitching(int max_gap = 16, bool lossy = false, int overlap = 64)
+            {
+            _max_gap = (max_gap < 1) ? 1 : max_gap;
+            _lossy = lossy;
+            _overlap = (overlap < 0) ? 0 : overlap;
+            }
+
+
+        /**
+        * Change the maximum number of searches running at once (0 = number of
+        * cores). Searches in excess are not stopped, the queued ones wait.
+        **/
+        void setThreads(int nb_threads)
+            {
+            if (nb_threads <= 0) nb_threads = (int)std::thread::hardware_concurrency();
+            _nb_threads = (nb_threads < 1) ? 1 : nb_threads;
+            }
+
+
+        /**
+        * Function called on each new TreeSearch object before it is started
+        * (to set its parameters).
+        **/
+        void setSetup(std::function<void(TreeSearch&)> setup)
+            {
+            _setup = setup;
+            }
+
+
+        /**
+        * Queue the searches (one per candidate of each segment) and start as many
+        * as the thread budget allows.
+        **/
+        void start(Heuristic fun)
+            {
+            MTOOLS_INSURE(!_started);
+            _fun = fun;
+            _started = true;
+            for (int k = 0; k < (int)_seg.size(); k++)
+                {
+                for (size_t i = 0; i < _seg[k].cand.size(); i++) _queueStart(k, _cuts[k], _seg[k].cand[i]);
+                }
+            _launch();
+            }
+
+
+        /**
+        * Collect the lifted segments and extend the stitched prefix.
+        * Return true once the whole tour is lifted.
+        **/
+        bool update()
+            {
+            MTOOLS_INSURE(_started);
+            for (int k = _stitched; k < (int)_seg.size(); k++) _collect(k);
+            while (_stitched < (int)_seg.size())
+                {
+                if (!_stitch()) break;
+                }
+            _launch();
+            return solved();
+            }
+
+
+        /**
+        * Query if the whole tour is lifted.
+        **/
+        bool solved() const
+            {
+            return (_stitched == (int)_seg.size());
+            }
+
+
+        /**
+        * The lifted tour (must be solved).
+        **/
+        const std::vector<Arm>& solution() const
+            {
+            MTOOLS_INSURE(solved());
+            return _prefix;
+            }
+
+
+        /**
+        * The cut indices (first is 0, last is tour.size() - 1).
+        **/
+        const std::vector<int>& cuts() const
+            {
+            return _cuts;
+            }
+
+
+        /**
+        * Number of searches currently running.
+        **/
+        int nbRunning() const
+            {
+            int n = 0;
+            for (auto& S : _seg) n += (int)S.inst.size();
+            return n;
+            }
+
+
+        /**
+        * Number of searches waiting for a thread.
+        **/
+        int nbQueued() const
+            {
+            return (int)_queue.size();
+            }
+
+
+        /**
+        * The (at most) nb extremal configurations reaching pixel Q from ref
+        * (Arm::pathToReach) that rotate the arms the least, closest first.
+        **/
+        static std::vector<Arm> closestCandidates(const Arm& ref, iVec2 Q, int nb)
+            {
+            Arm A = ref;
+            if (A.centerBox(1) == Q) A.addAngle(1, 1); // the pixel cannot be reached with the current box of arm 0.
+            auto V = A.pathToReach(Q);
+            std::vector<Arm> W(V.begin(), V.end());
+            std::sort(W.begin(), W.end(), [&](const Arm& a, const Arm& b) { return BridgeSearch::dist(a, ref) < BridgeSearch::dist(b, ref); });
+            std::vector<Arm> res;
+            for (size_t i = 0; (i < W.size()) && ((int)res.size() < nb); i++)
+                {
+                if (std::find(res.begin(), res.end(), W[i]) == res.end()) res.push_back(W[i]);
+                }
+            return res;
+            }
+
+
+        /**
+        * Choose the cut indices: the primary cut times, with evenly spaced cuts
+        * added where they are more than 2*seg_len apart. No segment is shorter
+        * than seg_len/2.
+        **/
+        static std::vector<int> chooseCuts(const std::vector<iVec2>& tour, int seg_len)
+            {
+            const int N = (int)tour.size() - 1;
+            std::vector<int> ct;
+            for (auto& C : cutTimes(tour)) ct.push_back(C.n1);
+            ct.push_back(N);
+            std::vector<int> cuts;
+            cuts.push_back(0);
+            for (int c : ct)
+                {
+                const int last = cuts.back();
+                if (c - last < seg_len / 2) continue;
+                const int nb = (c - last) / seg_len; // number of pieces between last and c
+                for (int j = 1; j < nb; j++)
+                    {
+                    const int x = last + (int)(((int64)j * (c - last)) / nb);
+                    if (N - x >= seg_len / 2) cuts.push_back(x);
+                    }
+                if ((N - c >= seg_len / 2) || (c == N)) cuts.push_back(c);
+                }
+            if (cuts.back() != N)
+                {
+                if (cuts.size() > 1) cuts.back() = N; else cuts.push_back(N);
+                }
+            return cuts;
+            }
+
+
+        /**
+        * Print formattted info about the segments (one line per segment).
+        **/
+        std::string toString()
+            {
+            mtools::ostringstream oss;
+            oss << "segment |  start |  length | searches |  maxpos | lifts\n";
+            for (int k = 0; k < (int)_seg.size(); k++)
+                {
+                Segment& S = _seg[k];
+                oss << justify_right(mtools::toString(k), 7) << " | "
+                    << justify_right(mtools::toString(_cuts[k]), 6) << " | "
+                    << justify_right(mtools::toString(S.tour->size()), 7) << " | ";
+                if (k < _stitched)
+                    {
+                    oss << "*** stitched ***\n";
+                    continue;
+                    }
+                int bp = 0;
+                for (auto& I : S.inst) bp = std::max(bp, I.ts->bestpos());
+                oss << justify_right(mtools::toString(S.inst.size()), 8) << " | "
+                    << justify_right(mtools::toString(bp), 7) << " | "
+                    << S.sol.size() << (S.repaired ? " (repair)" : "") << "\n";
+                }
+            oss << "stitched : " << _stitched << " / " << _seg.size() << "   prefix : " << _prefix.size() << " / " << _tour.size()
+                << "   bridges : " << _nbbridges << "   jumps : " << _nbjumps << "   repairs : " << _nbrepairs
+                << "   queued : " << _queue.size() << "\n";
+            return oss.toString();
+            }
+
+
+    private:
+
+
+        /** a search, its RNG (the RNG must outlive the search) and where it started. */
+        struct Instance
+            {
+            std::unique_ptr<MT2004_64>  gen;
+            std::unique_ptr<TreeSearch> ts;
+            int                         offset;     // tour index of the start
+            Arm                         start;      // starting configuration
+            };
+
+
+        /** a lossless lift of tour[offset] ... tour[cuts[k+1]] */
+        struct Lift
+            {
+            int                 offset;
+            std::vector<Arm>    path;
+            };
+
+
+        /** a search waiting for a thread */
+        struct Start
+            {
+            int     k;          // segment
+            int     offset;     // tour index of the start
+            Arm     a;          // starting configuration
+            };
+
+
+        /** a segment of the tour */
+        struct Segment
+            {
+            std::shared_ptr<const PixelTour> tour;      // tour[cuts[k]] ... tour[cuts[k+1]] (shared by the searches)
+            std::vector<Arm>                cand;       // candidate starting configurations at the boundary
+            std::set<std::pair<int, uint64>> starts;    // (offset, configuration) of the searches queued so far
+            std::vector<Instance>           inst;       // running searches
+            std::vector<Lift>               sol;        // lossless lifts found (not yet stitched)
+            bool                            repaired;   // a search was started from the prefix
+            };
+
+
+        /**
+        * Compute the candidate configurations at each boundary.
+        **/
+        void _makeCandidates(int nb_candidates)
+            {
+            _seg[0].cand.push_back(Arm(_tour[0]));
+            for (size_t k = 1; k < _seg.size(); k++)
+                {
+                _seg[k].cand = closestCandidates(_seg[k - 1].cand[0], _tour[_cuts[k]], nb_candidates);
+                }
+            }
+
+
+        /**
+        * Queue a search of segment k from configuration a at index offset (unless
+        * it was already queued once).
+        **/
+        void _queueStart(int k, int offset, Arm a)
+            {
+            if (!_seg[k].starts.insert({ offset, a.val() }).second) return;
+            _queue.push_back({ k, offset, a });
+            }
+
+
+        /**
+        * Start the queued searches, segments closest to the start first, while the
+        * thread budget allows. When searches are waiting, the searches of the
+        * segments after the next one to stitch that already have a lossless lift
+        * give their thread back.
+        **/
+        void _launch()
+            {
+            std::stable_sort(_queue.begin(), _queue.end(), [](const Start& x, const Start& y) { return x.k < y.k; });
+            for (int k = (int)_seg.size() - 1; (k > _stitched) && ((int)_queue.size() > _nb_threads - nbRunning()); k--)
+                {
+                Segment& S = _seg[k];
+                if (S.sol.size() == 0) continue;
+                while ((S.inst.size() > 0) && ((int)_queue.size() > _nb_threads - nbRunning())) S.inst.pop_back();
+                }
+            size_t i = 0;
+            while ((i < _queue.size()) && (nbRunning() < _nb_threads))
+                {
+                if (_queue[i].k >= _stitched) _add(_queue[i]);
+                i++;
+                }
+            _queue.erase(_queue.begin(), _queue.begin() + i);
+            }
+
+
+        /**
+        * Start a new search.
+        **/
+        void _add(const Start& s)
+            {
+            Segment& S = _seg[s.k];
+            Instance I;
+            I.offset = s.offset;
+            I.start = s.a;
+            I.gen.reset(new MT2004_64(Unif_64(_gen)));
+            auto T = (s.offset == _cuts[s.k]) ? S.tour : PixelTour::make(std::vector<iVec2>(_tour.begin() + s.offset, _tour.begin() + _cuts[s.k + 1] + 1));
+            I.ts.reset(new TreeSearch(T, *(I.gen), s.a));
+            if (_setup) _setup(*(I.ts));
+            I.ts->search(_fun);
+            S.inst.push_back(std::move(I));
+            }
+
+
+        /**
+        * Move the lossless lifts of segment k to its list of solutions (lossy
+        * lifts are dropped) and chain a search of segment k+1 to each new lift.
+        **/
+        void _collect(int k)
+            {
+            Segment& S = _seg[k];
+            for (size_t i = 0; i < S.inst.size(); )
+                {
+                TreeSearch& TS = *(S.inst[i].ts);
+                if (!TS.solved()) { i++; continue; }
+                TS.stopSearch();
+                if (TS.cumulative_loss() == 0)
+                    {
+                    Lift L;
+                    L.offset = S.inst[i].offset;
+                    L.path = TS.bestPath();
+                    if ((int)L.path.size() == _cuts[k + 1] - L.offset + 1)
+                        {
+                        if (k + 1 < (int)_seg.size())
+                            {
+                            const int off = std::max(L.offset, _cuts[k + 1] - _overlap);
+                            _queueStart(k + 1, off, L.path[off - L.offset]);
+                            }
+                        S.sol.push_back(std::move(L));
+                        }
+                    }
+                S.inst.erase(S.inst.begin() + i);
+                }
+            }
+
+
+        /**
+        * Try to append the next segment to the prefix. Return true on success.
+        **/
+        bool _stitch()
+            {
+            const int k = _stitched;
+            Segment& S = _seg[k];
+            const int c = _cuts[k];
+            const bool aligned = ((int)_prefix.size() == c + 1); // prefix[i] is at tour[i] (no lossy jump so far).
+            for (auto& L : S.sol)
+                { // exact match
+                const bool match = (aligned) ? ((L.offset <= c) && (_prefix[L.offset] == L.path[0])) : ((L.offset == c) && (_prefix.back() == L.path[0]));
+                if (match)
+                    {
+                    _prefix.resize(_prefix.size() - (c - L.offset));
+                    _append(k, L, 1, std::vector<Arm>());
+                    return true;
+                    }
+                }
+            if (S.sol.size() == 0)
+                {
+                if (!_isRepairing(k)) _repair(k); // the searches from the prefix failed or were stopped.
+                return false;
+                }
+            for (int g = 2; g <= _max_gap; g *= 2)
+                { // bridge between prefix[c - g] and the lift at c + g.
+                if ((!aligned) || (g > c)) break;
+                for (auto& L : S.sol)
+                    {
+                    const int j = c + g - L.offset;
+                    if ((j < 1) || (j >= (int)L.path.size())) continue;
+                    std::vector<Arm> bridge;
+                    if (BridgeSearch::find(_tour, _prefix[c - g], c - g, L.path[j], c + g, bridge, _potson))
+                        {
+                        _nbbridges++;
+                        _prefix.resize(c - g + 1);
+                        _append(k, L, j, bridge);
+                        return true;
+                        }
+                    }
+                }
+            if ((_lossy) && (_jump(k))) return true;
+            if (!_isRepairing(k)) _repair(k);
+            return false;
+            }
+
+
+        /**
+        * Lossy stitch: join the end of the prefix to the configuration of a lift of
+        * segment k at the next index with the cheapest short path (at most
+        * MAX_JUMP steps, see _jumpPath()). Return false if no lift is close enough.
+        **/
+        bool _jump(int k)
+            {
+            Segment& S = _seg[k];
+            const int c = _cuts[k];
+            const Arm a = _prefix.back();
+            double bestloss = mtools::INF;
+            int ib = -1;
+            std::vector<Arm> bestpath;
+            for (int i = 0; i < (int)S.sol.size(); i++)
+                {
+                const int j = c + 1 - S.sol[i].offset;
+                const std::vector<Arm>& V = S.sol[i].path;
+                if ((j < 1) || (j >= (int)V.size())) continue;
+                ArmToArm A;
+                A.set(a, V[j]);
+                if (A.steps() > MAX_JUMP) continue;
+                std::vector<Arm> P = _jumpPath(a, V[j]);
+                const double l = lossL1(P);
+                if (l < bestloss) { bestloss = l; ib = i; bestpath = std::move(P); }
+                }
+            if (ib < 0) return false;
+            bestpath.erase(bestpath.begin()); // the first arm is the end of the prefix.
+            bestpath.pop_back();              // the last one is the one of the lift.
+            _nbjumps++;
+            _append(k, S.sol[ib], c + 1 - S.sol[ib].offset, bestpath);
+            return true;
+            }
+
+
+        /**
+        * Path from a to b where each step moves every arm that has not reached its
+        * angle in b by one unit in the shortest direction (so each step is a legal
+        * move). Contains both ends.
+        **/
+        static std::vector<Arm> _jumpPath(Arm a, const Arm& b)
+            {
+            std::vector<Arm> P(1, a);
+            while (!(a == b))
+                {
+                for (int k = 0; k < Arm::NB_ARMS; k++)
+                    {
+                    const int l = 8 * Arm::lenArm(k);
+                    const int d = (b.angle(k) - a.angle(k) + l) % l;
+                    if (d != 0) a.addAngle(k, (2 * d <= l) ? 1 : -1);
+                    }
+                P.push_back(a);
+                }
+            return P;
+            }
+
+
+        /**
+        * Append the bridge and then the lift L of segment k from its index j to the
+        * prefix. Stop the remaining searches of the segment.
+        **/
+        void _append(int k, const Lift& L, int j, const std::vector<Arm>& bridge)
+            {
+            _prefix.insert(_prefix.end(), bridge.begin(), bridge.end());
+            _prefix.insert(_prefix.end(), L.path.begin() + j, L.path.end());
+            MTOOLS_INSURE(_prefix.back().pos() == _tour[_cuts[k + 1]]);
+            _seg[k].inst.clear();
+            _seg[k].sol.clear();
+            _stitched = k + 1;
+            }
+
+
+        /**
+        * Where a search of segment k from the prefix starts: 'overlap' indices
+        * before the boundary when the prefix is aligned with the tour, at its end
+        * otherwise.
+        **/
+        Start _repairStart(int k) const
+            {
+            const int c = _cuts[k];
+            Start s;
+            s.k = k;
+            if ((int)_prefix.size() == c + 1)
+                {
+                s.offset = std::max((k > 0) ? _cuts[k - 1] : 0, c - _overlap);
+                s.a = _prefix[s.offset];
+                }
+            else
+                {
+                s.offset = c;
+                s.a = _prefix.back();
+                }
+            return s;
+            }
+
+
+        /**
+        * Query if a search of segment k from the prefix is running or queued.
+        **/
+        bool _isRepairing(int k) const
+            {
+            const Start s = _repairStart(k);
+            for (auto& I : _seg[k].inst) { if ((I.offset == s.offset) && (I.start == s.a)) return true; }
+            for (auto& q : _queue) { if ((q.k == k) && (q.offset == s.offset) && (q.a == s.a)) return true; }
+            return false;
+            }
+
+
+        /**
+        * Queue a search of segment k from the prefix.
+        **/
+        void _repair(int k)
+            {
+            const Start s = _repairStart(k);
+            _seg[k].repaired = true;
+            _seg[k].starts.insert({ s.offset, s.a.val() });
+            _nbrepairs++;
+            _queue.push_back(s);
+            }
+
+
+        const std::vector<iVec2>    _tour;          // the tour to lift
+        MT2004_64                   _gen;           // RNG used to seed the searches
+        PotSon                      _potson;        // to list the sons in the bridge search
+        int                         _nb_threads;    // maximum number of searches running at once
+        std::vector<Start>          _queue;         // searches waiting for a thread
+        bool                        _started;
+        Heuristic                   _fun;           // heuristic used by all the searches
+        std::function<void(TreeSearch&)> _setup;    // called on each new search
+        int                         _max_gap;       // largest bridge gap
+        bool                        _lossy;         // allow lossy stitching
+        int                         _overlap;       // chained and repair searches start this many indices before the boundary
+
+        std::vector<int>            _cuts;          // cut indices
+        std::vector<Segment>        _seg;           // the segments
+        int                         _stitched;      // number of segments in the prefix
+        std::vector<Arm>            _prefix;        // lift of tour[0] ... tour[cuts[_stitched]]
+        int64                       _nbbridges;     // number of bridged boundaries
+        int64                       _nbrepairs;     // number of repair searches started
+        int64                       _nbjumps;       // number of lossy jumps
+    };
+
+
+
+/** end of file */
@@ -9,23 +9,34 @@ using namespace mtools;
 #include "distanceArm.h"
 #include "LKHtour.h"
 #include "Vizualize.h"
+#include "MappedFile.h"
+#include "PartialFile.h"
+
+#include <algorithm>
+#include <cstring>
+
+
+
+ExactCost scoreExact(const std::vector<Arm>& arm_tour)
+    {
+    ExactCost tot;
+    for (size_t i = 1; i < arm_tour.size(); i++)
+        {
+        const int m = armMoves(arm_tour[i - 1], arm_tour[i]);
+        tot += (m < 0) ? ExactCost::infinity() : ExactCost::sqrtL1(m);
+        tot.addColor(distcolUnits(arm_tour[i - 1].pos(), arm_tour[i].pos()));
+        }
+    return tot;
+    }
 
 
 
 double score(const std::vector<Arm>& arm_tour, bool strict)
     {
-    double tot = 0;
-    for (int i = 1; i < arm_tour.size(); i++)
+    const ExactCost tot = scoreExact(arm_tour);
+    if ((strict) && (tot.isInf()))
         {
-        double di = penaltyL1(arm_tour[i - 1], arm_tour[i]);
-        if (strict)
-            {
-            if (di == mtools::INF)
-                {
-                MTOOLS_ERROR("Tour contains a forbidden moves.");
-                }
-            }
-        tot += di + distcol(arm_tour[i - 1].pos(), arm_tour[i].pos());
+        MTOOLS_ERROR("Tour contains a forbidden moves.");
         }
 
     if (strict)
@@ -45,21 +56,21 @@ double score(const std::vector<Arm>& arm_tour, bool strict)
             {
             iVec2 Q = a.pos();
             ss.insert(Q);
-            if ((Q.X() < -128) || (Q.X() > 128))
+            if ((Q.X() < -SANTA_IMAGE_CX) || (Q.X() > SANTA_IMAGE_CX))
                 {
-                MTOOLS_ERROR("X value out of range [-128,128]");
+                MTOOLS_ERROR(std::string("X value out of range [-") << SANTA_IMAGE_CX << "," << SANTA_IMAGE_CX << "]");
                 }
-            if ((Q.Y() < -128) || (Q.Y() > 128))
+            if ((Q.Y() < -SANTA_IMAGE_CY) || (Q.Y() > SANTA_IMAGE_CY))
                 {
-                MTOOLS_ERROR("Y value out of range [-128,128]");
+                MTOOLS_ERROR(std::string("Y value out of range [-") << SANTA_IMAGE_CY << "," << SANTA_IMAGE_CY << "]");
                 }
             }
-        if (ss.size() != 257 * 257)
+        if (ss.size() != SANTA_IMAGE_LX * SANTA_IMAGE_LY)
             {
 
-            for (int y = -128; y <= 128; y++)
+            for (int y = -SANTA_IMAGE_CY; y <= SANTA_IMAGE_CY; y++)
                 {
-                for (int x = -128; x <= 128; x++)
+                for (int x = -SANTA_IMAGE_CX; x <= SANTA_IMAGE_CX; x++)
                     {
                     if (ss.find(iVec2(x, y)) == ss.end())
                         {
@@ -78,28 +89,39 @@ double score(const std::vector<Arm>& arm_tour, bool strict)
 
             }
         }
-    return tot;
+    return tot.toDouble();
     }
 
 
 
 std::vector<Arm> loadSolution(const char* filename)
     {
-    auto S = loadStringFromFile(filename);
-    if (S.size() == 0)
+    MappedFile F(filename);
+    if (!F.isOpen())
         {
         MTOOLS_ERROR(std::string("loadSolution(): ERROR, CANNOT LOAD: ") + filename);
         }
-    auto U = tokenize(S, "", "\n");
+    const char* p = F.data();
+    const char* end = p + F.size();
+    if (isPartialFile(filename)) return PartialFile(filename).toVector(); // binary format
     std::vector<Arm> sol;
-    sol.reserve(U.size() + 1);
-    for (int i = 0; i < U.size(); i++)
+    sol.reserve(std::count(p, end, '\n') + 2);
+    int64 line = 0;
+    while (p < end)
         {
-        if ((i == 0) && (U[i] == std::string("configuration"))) continue;
+        const char* eol = (const char*)memchr(p, '\n', end - p);
+        if (eol == nullptr) eol = end;
+        line++;
+        const char* q = p;
+        p = eol + ((eol < end) ? 1 : 0);
+        const char* e = eol;
+        while ((e > q) && ((e[-1] == '\r') || (e[-1] == ' ') || (e[-1] == '\t'))) e--;
+        if (e == q) continue; // empty line
+        if ((line == 1) && (e - q == 13) && (memcmp(q, "configuration", 13) == 0)) continue; // header
         Arm a;
-        if (a.parse(U[i]) == false)
+        if (a.parse(q, e) == false)
             {
-            MTOOLS_ERROR(std::string("loadSolution(): ERROR, INVALID ARM FOR FILE: ") + filename);
+            MTOOLS_ERROR(std::string("loadSolution(): ERROR, INVALID ARM FOR FILE: ") + filename + " at line " + mtools::toString(line));
             }
         sol.push_back(a);
         }
@@ -108,13 +130,25 @@ std::vector<Arm> loadSolution(const char* filename)
 
 
 
-void saveSolution(const std::vector<Arm>& arm_tour, const char* filename)
+void saveSolution(const std::vector<Arm>& arm_tour, const char* filename, bool header)
     {
-    LogFile f(filename, false, false);
-    f << "configuration\n";
-    for (int i = 0; i < arm_tour.size(); i++)
+    std::vector<char> buf(arm_tour.size() * Arm::MAX_STR_LEN + 16);
+    char* p = buf.data();
+    if (header) { memcpy(p, "configuration\n", 14); p += 14; }
+    for (size_t i = 0; i < arm_tour.size(); i++)
         {
-        f << arm_tour[i].str();
+        p = arm_tour[i].write(p);
+        }
+    FILE* f = fopen(filename, "wb");
+    if (f == nullptr)
+        {
+        MTOOLS_ERROR(std::string("saveSolution(): ERROR, CANNOT WRITE: ") + filename);
+        }
+    const size_t n = (size_t)(p - buf.data());
+    const bool ok = (fwrite(buf.data(), 1, n, f) == n);
+    if ((fclose(f) != 0) || (!ok))
+        {
+        MTOOLS_ERROR(std::string("saveSolution(): ERROR, CANNOT WRITE: ") + filename);
         }
     return;
     }
@@ -123,39 +157,44 @@ void saveSolution(const std::vector<Arm>& arm_tour, const char* filename)
 
 std::vector<Arm> patch(const std::vector<Arm>& A, const  std::vector<Arm>& B, const  std::vector<Arm>& C, const  std::vector<Arm>& D, const  std::vector<Arm>& E)
     {
-    int U[5] = { 0,0,0,0,0 };
-    std::vector<Arm> T[5];
-    T[0] = A;
-    T[1] = B;
-    T[2] = C;
-    T[3] = D;
-    T[4] = E;
+    return patch(std::vector<std::vector<Arm>>{ A, B, C, D, E });
+    }
+
+
+std::vector<Arm> patch(const std::vector<std::vector<Arm>>& parts)
+    {
+    const int N = (int)parts.size();
+    MTOOLS_INSURE(N > 0);
+    std::vector<int> U(N, 0);
+    std::vector<std::vector<Arm>> T(parts);
 
     // find the head
     std::vector<Arm> S;
-    S.reserve(T[0].size() + T[1].size() + T[2].size() + T[3].size() + T[4].size());
+    size_t tot = 0;
+    for (int i = 0; i < N; i++) tot += T[i].size();
+    S.reserve(tot);
 
-    for (int i = 0; i < 5; i++)
+    for (int i = 0; i < N; i++)
         {
         if ((T[i]).front().pos() == iVec2(0, 0)) { S = T[i]; U[i] = 1; break; }
         if ((T[i]).back().pos() == iVec2(0, 0)) { S = getReversed(T[i]);  U[i] = 1; break; }
         }
     MTOOLS_INSURE(S.size() > 0);
 
-    for (int n = 0; n < 4; n++)
+    for (int n = 0; n < N - 1; n++)
         {
         bool e = false;
-        for (int k = 0; k < 5; k++)
+        for (int k = 0; k < N; k++)
             {
             if (U[k] == 0)
                 {
-                if (T[k].front().pos() == S.back().pos())
+                if (T[k].front() == S.back())
                     {
                     for (int i = 1; i < T[k].size(); i++) { S.push_back((T[k])[i]); }
                     U[k] = 1;
                     e = true;
                     break;
-                    } else if (T[k].back().pos() == S.back().pos())
+                    } else if (T[k].back() == S.back())
                         {
                         T[k] = getReversed(T[k]);
                         for (int i = 1; i < T[k].size(); i++) { S.push_back((T[k])[i]); }
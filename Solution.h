@@ -4,6 +4,7 @@
 using namespace mtools;
 
 #include "Arm.h"
+#include "ExactCost.h"
 
 
 
@@ -14,15 +15,24 @@ double score(const std::vector<Arm>& arm_tour, bool strict);
 
 
 /**
-* Load a solution in kaggle format
+* Exact score of a solution (infinite if it contains a forbidden move).
+**/
+ExactCost scoreExact(const std::vector<Arm>& arm_tour);
+
+
+/**
+* Load a solution in kaggle format. The file is memory mapped and each line
+* is decoded directly into an Arm (the 'configuration' header is optional).
+* Binary path files (see savePartial()) are also accepted.
 **/
 std::vector<Arm> loadSolution(const char* filename);
 
 
 /**
-* Save a solution in kaggle format
+* Save a solution in kaggle format. The whole file is formatted in a single
+* buffer and written at once. header = false omits the 'configuration' line.
 */
-void saveSolution(const std::vector<Arm>& arm_tour, const char* filename);
+void saveSolution(const std::vector<Arm>& arm_tour, const char* filename, bool header = true);
 
 
 /**
@@ -32,6 +42,15 @@ void saveSolution(const std::vector<Arm>& arm_tour, const char* filename);
 std::vector<Arm> patch(const std::vector<Arm>& A, const  std::vector<Arm>& B, const  std::vector<Arm>& C, const  std::vector<Arm>& D, const  std::vector<Arm>& E);
 
 
+/**
+* Patch any number of parts together to make a tour.
+* The order and orientation of the parts do not matter: starting from the
+* part with an end at the origin, the parts are chained by matching their
+* end configurations.
+**/
+std::vector<Arm> patch(const std::vector<std::vector<Arm>>& parts);
+
+
 
 
 
@@ -10,6 +10,14 @@ using namespace mtools;
 #include "Solution.h"
 #include "PotSon.h"
 #include "TreeSearch.h"
+#include "MCTSearch.h"
+#include "HierarchicalSearch.h"
+#include "BidirSearch.h"
+#include "Segmentation.h"
+#include "Island.h"
+#include "SearchPool.h"
+#include "PartialFile.h"
+#include "LiftAnalyzer.h"
 
 
 
@@ -74,7 +82,53 @@ inline void reverseSolution(const char * filename)
 
 
 /**
-* Program to patch 5 tour together
+* Ask for a tour and for one of its five parts. Returns the part and sets
+* filename to the base name of the files saved by the lift programs (the
+* tour filename followed by the letter of the part).
+**/
+inline std::vector<iVec2> loadPart(std::string& filename)
+    {
+    std::string tourname = arg("tour filename");
+    int part = arg("part to lift (0=A, 1=B, 2=C, 3=D, 4=E)", 0);
+    auto V = loadLKHTour(tourname);
+    std::vector<iVec2> T[5];
+    splitTour(V, T[0], T[1], T[2], T[3], T[4]);
+    if ((part < 0) || (part > 4)) part = 0;
+    filename = tourname + "." + std::string(1, (char)('A' + part));
+    return T[part];
+    }
+
+
+/**
+* Display loop of the lift programs: once per second, clear the console and
+* print the name and length of the part followed by status() (which may also
+* save a partial solution) until done() returns true.
+**/
+template<typename DONE, typename STATUS> void monitorPart(const std::string& filename, size_t length, DONE done, STATUS status)
+    {
+    while (!done())
+        {
+        cout.clear();
+        cout << "Tour   : " << filename << "\n";
+        cout << "length : " << length << "\n\n";
+        cout << status();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        }
+    }
+
+
+/**
+* Heuristic of the lift programs: uniform choice among the possible sons.
+**/
+inline Arm uniform_heuristic(int, Arm, iVec2, PotSon& potson, bool, TreeSearch*)
+    {
+    return potson.unif();
+    }
+
+
+
+/**
+* Program to patch 5 tour together (kaggle or binary path files)
 **/
 void programPatch()
     {
@@ -108,16 +162,281 @@ void programPatch()
 
 
 /**
-* Program to compute the score of a tour
+* Program to lift one of the five parts of a tour with the Monte-Carlo tree search.
+* The partial solutions are saved in the same format as those of TreeSearch.
+**/
+void programMCTS()
+    {
+    std::string filename;
+    const std::vector<iVec2> T = loadPart(filename);
+    int nbthreads = arg("number of threads", 8);
+    int seed = arg("seed", 1);
+
+    MT2004_64 gen(seed);
+    MCTSearch S(T, gen, nbthreads);
+    S.search();
+    int lastbest = -1;
+    monitorPart(filename, T.size(), [&]() { return S.solved(); }, [&]()
+        {
+        if (S.bestpos() > lastbest + 1000)
+            {
+            lastbest = S.bestpos();
+            S.save(filename + ".mcts");
+            }
+        return S.header() + S.toString() + S.hrule();
+        });
+    S.stopSearch();
+    S.save(filename + ".lossless");
+    cout << "\n*** solved ***\n";
+    cout.getKey();
+    }
+
+
+
+/**
+* Program to lift one of the five parts of a tour with the coarse-to-fine search.
+**/
+void programHierarchical()
+    {
+    std::string filename;
+    const std::vector<iVec2> T = loadPart(filename);
+    int seed = arg("seed", 1);
+
+    MT2004_64 gen(seed);
+    HierarchicalSearch S(T, gen);
+    S.search();
+    int lastbest = -1;
+    monitorPart(filename, T.size(), [&]() { return (S.solved() || S.failed()); }, [&]()
+        {
+        if (S.bestpos() > lastbest + 1000)
+            {
+            lastbest = S.bestpos();
+            S.save(filename + ".hier");
+            }
+        return S.header() + S.toString() + S.hrule();
+        });
+    S.stopSearch();
+    if (S.failed())
+        {
+        S.save(filename + ".hier");
+        cout << "\n*** no lift found ***\n";
+        cout.getKey();
+        return;
+        }
+    S.save(filename + ".lossless");
+    cout << "\n*** solved ***\n";
+    cout.getKey();
+    }
+
+
+
+/**
+* Program to lift one of the five parts of a tour from both ends at once.
+**/
+void programBidir()
+    {
+    std::string filename;
+    const std::vector<iVec2> T = loadPart(filename);
+    int nbforward = arg("number of forward searches", 4);
+    int nbbackward = arg("number of backward searches", 4);
+    int seed = arg("seed", 1);
+
+    MT2004_64 gen(seed);
+    BidirSearch S(T, gen, nbforward, nbbackward);
+    S.search(uniform_heuristic);
+    monitorPart(filename, T.size(), [&]() { return S.solved(); }, [&]() { return S.hrule() + S.header() + S.hrule() + S.toString(); });
+    S.stopSearch();
+    S.save(filename + ".lossless");
+    cout << "\n*** solved ***\n";
+    cout.getKey();
+    }
+
+
+
+/**
+* Program to lift one of the five parts of a tour by cutting it into segments
+* solved in parallel and stitched together.
+**/
+void programSegmented()
+    {
+    std::string filename;
+    const std::vector<iVec2> T = loadPart(filename);
+    int seglen = arg("segment length", 2000);
+    int nbcand = arg("number of candidates per boundary", 2);
+    int nbthreads = arg("number of threads", 8);
+    int seed = arg("seed", 1);
+
+    SegmentedLift S(T, seed, seglen, nbcand, nbthreads);
+    S.setSetup([](TreeSearch& TS) { TS.setMacroSteps(); });
+    S.start(uniform_heuristic);
+    monitorPart(filename, T.size(), [&]() { return S.update(); }, [&]() { return S.toString(); });
+    saveSolution(S.solution(), (filename + ".lossless").c_str());
+    cout << "\n*** solved ***\n";
+    cout.getKey();
+    }
+
+
+
+/**
+* Program to lift one of the five parts of a tour with a population of searches
+* sharing their best prefixes.
+**/
+void programIsland()
+    {
+    std::string filename;
+    const std::vector<iVec2> T = loadPart(filename);
+    int nbislands = arg("number of searches", 8);
+    int period = arg("migration period (seconds)", 30);
+    int stagnation = arg("restart after (seconds without progress)", 600);
+    int seed = arg("seed", 1);
+
+    IslandSearch S(T, nbislands, seed);
+    S.setMigration(period, 0.9, stagnation);
+    S.setSetup([](TreeSearch& TS) { TS.setMacroSteps(); });
+    S.start(uniform_heuristic);
+    monitorPart(filename, T.size(), [&]() { return S.update(); }, [&]() { return S.toString(); });
+    saveSolution(S.solution(), (filename + ".lossless").c_str());
+    cout << "\n*** solved ***\n";
+    cout.getKey();
+    }
+
+
+
+/**
+* Program to lift one of the five parts of a tour with a large portfolio of
+* searches (different seeds and temperatures) sharing a few worker threads.
+**/
+void programPool()
+    {
+    std::string filename;
+    const std::vector<iVec2> T = loadPart(filename);
+    int nbsearches = arg("number of searches", 200);
+    int nbworkers = arg("number of worker threads (0 = all cores)", 0);
+    int seed = arg("seed", 1);
+
+    MT2004_64 gen(seed);
+    SearchPool pool(nbworkers);
+    auto PT = PixelTour::make(T); // one copy of the tour for all the searches
+    for (int i = 0; i < nbsearches; i++)
+        {
+        const double t = 0.5 + Unif(gen); // temperature multiplier in [0.5, 1.5]
+        pool.add(PT, Unif_64(gen), uniform_heuristic,
+            [t](TreeSearch& TS) { TS.setMacroSteps(); TS.setTemperature(0.0035 * t, 0.005 * t); });
+        }
+    int k = -1;
+    monitorPart(filename, T.size(), [&]() { return ((k = pool.solvedIndex()) >= 0); }, [&]() { return pool.toString(); });
+    pool[k].save(filename + ((pool[k].cumulative_loss() == 0) ? std::string(".lossless") : std::string(".loss")));
+    cout << "\n*** solved ***\n";
+    cout.getKey();
+    }
+
+
+
+/**
+* Program to compute the score of a tour (kaggle or binary path file)
 **/
 void programScore()
     {
     std::string fA = arg("file to score : ");
+    if (isPartialFile(fA))
+        {
+        PartialFile F(fA);
+        const PartialInfo& I = F.info();
+        cout << "binary path file : " << F.size() << " configurations, tour hash " << I.tour_hash << ", segment " << I.segment
+             << ", indices [" << I.start << ", " << I.end << "], loss " << I.loss << ", seed " << I.seed << "\n";
+        }
     auto S = loadSolution(fA.c_str());
     cout << "Solution score : " << score(S, true) << "\n";
     cout.getKey();
     }
 
 
+
+/**
+* Program to convert a solution or a partial path between the kaggle format
+* and the binary path format (see savePartial()). The direction is chosen
+* from the input file.
+**/
+void programConvertSolution()
+    {
+    std::string fin = arg("input file (kaggle or binary path)");
+    const bool tobin = !isPartialFile(fin);
+    std::string fout = arg("output file", fin + (tobin ? std::string(".skp") : std::string(".csv")));
+    Chrono ch;
+    ch.reset();
+    auto V = loadSolution(fin.c_str());
+    cout << V.size() << " configurations loaded from [" << fin << "] in " << ch.elapsed() << "ms\n";
+    ch.reset();
+    if (tobin)
+        {
+        savePartial(V, fout, PartialInfo()); // no metadata in a kaggle file
+        }
+    else
+        {
+        saveSolution(V, fout.c_str());
+        }
+    cout << "saved in [" << fout << "] in " << ch.elapsed() << "ms\n";
+    cout.getKey();
+    }
+
+
+
+/**
+* Program to estimate how hard a tour is to lift (see LiftAnalyzer).
+**/
+void programAnalyzeTour()
+    {
+    std::string tourname = arg("tour filename");
+    int time_ms = arg("time budget of the probes (ms)", 800);
+    int seed = arg("seed", 1);
+    auto V = loadLKHTour(tourname);
+    LiftAnalyzer LA(seed, time_ms);
+    LA.setSetup([](TreeSearch& TS) { TS.setMacroSteps(); });
+    auto R = LA.analyze(V);
+    cout << "Tour : " << tourname << "\n\n";
+    cout << R.toString();
+    cout.getKey();
+    }
+
+
+
+/**
+* Program to load and rank all the LKH tours of a directory.
+**/
+void programRankTours()
+    {
+    std::string dir = arg("directory containing the .tour files", std::string("."));
+    Chrono ch;
+    ch.reset();
+    auto T = loadLKHTours(dir);
+    cout << T.size() << " tour files loaded from [" << dir << "] in " << ch.elapsed() << "ms\n";
+    for (size_t i = 0; i < T.size(); i++)
+        {
+        if (T[i].error.size() == 0) cout << i + 1 << "\t" << doubleToStringHighPrecision(T[i].score) << "\t" << T[i].filename << "\n";
+        else cout << "-\tERROR\t" << T[i].filename << " : " << T[i].error << "\n";
+        }
+    cout.getKey();
+    }
+
+
+
+/**
+* Program to convert an image (competition CSV file) into a binary image file
+* that loads faster (see loadImage()).
+**/
+void programConvertImage()
+    {
+    std::string fin = arg("image file (.csv)");
+    std::string fout = arg("output binary file", fin + ".bin");
+    Chrono ch;
+    ch.reset();
+    if (!loadImage(fin)) { MTOOLS_ERROR(std::string("Cannot open :") << fin); }
+    cout << "image [" << fin << "] loaded in " << ch.elapsed() << "ms\n";
+    if (!saveImageBinary(fout)) { MTOOLS_ERROR(std::string("Cannot write :") << fout); }
+    cout << "binary image saved in [" << fout << "]\n";
+    cout.getKey();
+    }
+
+
 /** end of file */
 
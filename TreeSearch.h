@@ -4,10 +4,19 @@
 
 #include "mtools/mtools.hpp" 
 using namespace mtools;
+#include <unordered_map>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <functional>
 #include "Arm.h"
+#include "ArmPath.h"
+#include "PixelTour.h"
 #include "distanceArm.h"
 #include "PotSon.h"
 #include "Rectify.h"
+#include "Solution.h"
+#include "PartialFile.h"
 
 
 
@@ -33,7 +42,7 @@ struct ExcRange
 
 
 
-class TreeSearch
+class alignas(64) TreeSearch
     {
 
 
@@ -44,8 +53,34 @@ class TreeSearch
         /**
          *  Ctor
          **/        
-        TreeSearch(const std::vector<iVec2>& tour, MT2004_64 & gen) : 
-            _nbsteps(0), _th(nullptr), _tour(tour), _gen(gen), _potson(gen), _ison(false), _request_stop(false), _ispaused(false), _request_pause(0), _G(0.5), _a2p(gen)
+        TreeSearch(const std::vector<iVec2>& tour, MT2004_64 & gen) : TreeSearch(PixelTour::make(tour), gen)
+            {
+            }
+
+
+        /**
+        * Ctor. Start the lift from a given configuration (whose position must be tour[0]).
+        * Used to lift a piece of a tour that starts at an interior point.
+        **/
+        TreeSearch(const std::vector<iVec2>& tour, MT2004_64& gen, Arm start) : TreeSearch(PixelTour::make(tour), gen, start)
+            {
+            }
+
+
+        /**
+        * Ctor. The tour is shared with the other searches on it.
+        **/
+        TreeSearch(std::shared_ptr<const PixelTour> tour, MT2004_64 & gen) : TreeSearch(tour, gen, Arm((*tour)[0])) // tour[0] must be the origin or a corner. 
+            {
+            }
+
+
+        /**
+        * Ctor. Start the lift of a shared tour from a given configuration (whose
+        * position must be tour[0]).
+        **/
+        TreeSearch(std::shared_ptr<const PixelTour> tour, MT2004_64& gen, Arm start) :
+            _nbsteps(0), _th(nullptr), _tour(tour), _gen(gen), _potson(gen), _ison(false), _request_stop(false), _ispaused(false), _request_pause(0), _coop(false), _inslice(false), _backtracked(false), _G(0.5), _a2p(gen)
             {            
 
             // tunneling
@@ -57,15 +92,16 @@ class TreeSearch
             // exception 
             _cumloss.reserve(100);
             _cumloss.push_back({ -1, 0.0 });
+            _bestcumloss = _cumloss;
             _exctab.reserve(100);
             setExcPeriod();
 
             // data            
-            _best.reserve(tour.size() + 10);
-            _current.reserve(tour.size() + 10);            
-            Arm A(tour[0]); // must be the origin or a corner. 
-            _best.push_back(A);
-            _current.push_back(A);
+            _best.reserve(tour->size() + 10);
+            _current.reserve(tour->size() + 10);            
+            MTOOLS_INSURE(start.pos() == (*tour)[0]);
+            _best.push_back(start);
+            _current.push_back(start);
 
             _nb_visit_at_best = 0; 
             _min_steps = mtools::INF;
@@ -73,6 +109,17 @@ class TreeSearch
             _cum_loss_at_best = 0; 
 
             searchPrecision();
+
+            // published best path
+            _pubpath.reset(new std::atomic<uint64>[tour->size()]);
+            _chg = 0;
+            _stats.seq.store(0);
+            _publishStats();
+
+            // macro steps
+            _mstart.resize(tour->size());
+            for (int n = 0; n < (int)tour->size(); n++) _mstart[n] = n;
+            setMacroSteps(0);
             }
 
 
@@ -93,19 +140,46 @@ class TreeSearch
         /**
         * Set how much of the Ball of size 2 and 3 we explore.
         * precision = allow jump with up too 'precision' arm movements simultaneously.
+        * max_ball = radius of the largest ball explored (use 3 to skip the costly ball of size 4).
         **/
-        void searchPrecision(int precision2 = 3, int precision3 = 2)
+        void searchPrecision(int precision2 = 3, int precision3 = 2, int max_ball = 4)
             {
+            _a2p.setMaxBall(max_ball);
+
             if (precision2 < 1) precision2 = 1;
-            if (precision2 > 8) precision2 = 8;
+            if (precision2 > Arm::NB_ARMS) precision2 = Arm::NB_ARMS;
             _precision2 = precision2;
 
             if (precision3 < 1) precision3 = 1;
-            if (precision3 > 8) precision3 = 8;
+            if (precision3 > Arm::NB_ARMS) precision3 = Arm::NB_ARMS;
             _precision3 = precision3;
             }
 
 
+        /**
+        * Enable macro steps along the straight runs of the tour.
+        *
+        * When the tour goes straight (unit moves in the same direction) for at
+        * least 'min_run' pixels, the next min(run, max_len) pixels are lifted in a
+        * single search move: the number of rotations of each arm along the run
+        * is sampled (with probability proportional to the number of orderings)
+        * and the rotations are then interleaved at random. The heuristic is not
+        * called inside a run. When backtracking lands inside a macro step, the
+        * search goes back to its start.
+        *
+        * min_run = 0 disables macro steps (default).
+        **/
+        void setMacroSteps(int min_run = 4, int max_len = 32)
+            {
+            if (max_len < 2) max_len = 2;
+            if (max_len > MACRO_MAX_LEN) max_len = MACRO_MAX_LEN;
+            if ((min_run > 0) && (min_run < 2)) min_run = 2;
+            _macro_min = (min_run < 0) ? 0 : min_run;
+            _macro_len = max_len;
+            _gaits.clear();
+            }
+
+
         void setTunnelingProbability(double tunneling_prob = 0.000001)
             {
             _tunnel_prob = tunneling_prob;
@@ -120,6 +194,7 @@ class TreeSearch
             _anneal_period = 1000 * period_sec;
             _min_branch_prob = min_branch_prob;
             _max_branch_prob = max_branch_prob;
+            _branch_prob = min_branch_prob;
             }
 
 
@@ -171,8 +246,8 @@ class TreeSearch
             bool ip = isPaused();
             pause(true);
 
-            _current = _best; 
-            _current.resize(pos);
+            _toBestPrefix(pos);
+            _publishStats();
 
             pause(ip);
             }
@@ -202,11 +277,40 @@ class TreeSearch
                 _th->join(); 
                 delete _th; 
                 }
+            _ison = true; // set before the thread starts: it may end before we could see it running.
+            _coop = false;
             _th = new std::thread(&TreeSearch::_threadproc<HEURISTIC>, this, fun);
-            while ((bool)_ison == false)
-                {
-                std::this_thread::yield();
+            }
+
+
+        /**
+        * Start a cooperative search: no thread is created. Instead, the returned
+        * function runs the search for (at most) K steps each time it is called and
+        * returns true once the search is over (solved or stopped). It must be
+        * called from one thread at a time (see SearchPool).
+        *
+        * Pausing a cooperative search waits for the current slice to end and
+        * prevents new slices from running until the search is resumed: a slice
+        * of a paused search returns false at once. 'onresume' (if not null) is
+        * called when the search is resumed or stopped, so that a scheduler can
+        * park a paused search until then.
+        **/
+        template<typename HEURISTIC> std::function<bool(int64)> cooperativeSearch(HEURISTIC fun, std::function<void()> onresume = nullptr)
+            {
+            MTOOLS_INSURE(!isSearchOn());
+            if (_th != nullptr)
+                { // delete previous thread object if needed. 
+                _th->join();
+                delete _th;
+                _th = nullptr;
                 }
+            _begin();
+            _coop = true;
+            _onresume = onresume;
+            _inslice = false;
+            _ispaused = false;
+            _ison = true;
+            return [this, fun](int64 K) mutable { return _runSlice(fun, K); };
             }
 
 
@@ -218,6 +322,17 @@ class TreeSearch
         void stopSearch()
             {
             _request_stop = true;
+            if (_coop)
+                { // wait for the current slice to end.
+                const bool wason = (bool)_ison;
+                    {
+                    std::unique_lock<std::mutex> lock(_slicemut);
+                    _slicecv.wait(lock, [&] { return !_inslice; });
+                    _ison = false;
+                    _ispaused = false;
+                    }
+                if ((wason) && (_onresume)) _onresume();
+                }
             while ((bool)_ison)
                 {
                 std::this_thread::yield();
@@ -244,6 +359,16 @@ class TreeSearch
             {
             if (!isSearchOn()) return; // nothing to do
             if (isPaused() == status) return; // nothing to do. 
+            if (_coop)
+                { // no new slice starts while paused: wait for the current one to end.
+                    {
+                    std::unique_lock<std::mutex> lock(_slicemut);
+                    _ispaused = status;
+                    if (status) _slicecv.wait(lock, [&] { return !_inslice; });
+                    }
+                if ((!status) && (_onresume)) _onresume();
+                return;
+                }
             _request_pause = ((status) ? -1 : 1); // signal thread to pause / resume
             while (isPaused() != status)
                 {
@@ -263,12 +388,30 @@ class TreeSearch
 
 
 
+        /**
+        * The pixel tour being lifted.
+        **/
+        const PixelTour& tour() const
+            {
+            return *_tour;
+            }
+
+
+        /**
+        * The shared pixel tour being lifted (to create other searches on it).
+        **/
+        std::shared_ptr<const PixelTour> pixelTour() const
+            {
+            return _tour;
+            }
+
+
         /**
         * Query if we have a full solution. 
         **/
         bool solved() const
             {
-            return (_best.size() == _tour.size());
+            return (_stats.bestpos.load() == (int)_tour->size() - 1);
             }
 
 
@@ -279,17 +422,18 @@ class TreeSearch
         **/
         std::string toString()
             {
-            double jl = jump_loss();
+            const StatsSnapshot S = stats(); // consistent set of values
+            double jl = S.min_loss;
             jl = (jl == mtools::INF) ? jl : (((int)(jl * 1000)) / 1000.0);
-            double cl = cumulative_loss();
+            double cl = S.cum_loss;
             cl = (cl == mtools::INF) ? cl : (((int)(cl * 1000)) / 1000.0);
             mtools::ostringstream oss; 
-            oss << justify_left(mtools::toString(nbsteps()), 11) << "| "
-                << justify_right(mtools::toString(pos()), 5) << " / "
-                << justify_left(mtools::toString(bestpos()), 5) << " | "
-                << justify_right(mtools::doubleToStringNice(jump_steps()), 5) << " | "
+            oss << justify_left(mtools::toString(S.nbsteps), 11) << "| "
+                << justify_right(mtools::toString(S.pos), 5) << " / "
+                << justify_left(mtools::toString(S.bestpos), 5) << " | "
+                << justify_right(mtools::doubleToStringNice(S.min_steps), 5) << " | "
                 << justify_right(mtools::doubleToStringNice(jl), 6) << " | "
-                << justify_right(mtools::toString(jump_setsize()), 7) << " | "
+                << justify_right(mtools::toString(S.setsize), 7) << " | "
                 << justify_right(mtools::doubleToStringNice(cl), 6) << "\n";
             return oss.toString(); 
             }
@@ -315,40 +459,97 @@ class TreeSearch
         **/
         std::string save(std::string filename)
             {
-            bool ip = isPaused();
-            pause(true);
             //if (add_random_number) filename += std::string(".") + mtools::toString((int)(10000000 * Unif(_gen)));
-            LogFile f(filename, false, false, false);
-            auto V = bestPath();           
-            for (int i = 0; i < V.size(); i++)
-                {
-                f << V[i].str();
-                }
-            pause(ip);
+            auto V = bestPath(); // does not pause the search
+            saveSolution(V, filename.c_str(), false);
+            return filename;
+            }
+
+
+        /**
+        * Save the best (extended) path into a binary path file (see savePartial())
+        * together with the tour hash, the position reached and the loss.
+        **/
+        std::string savePartial(std::string filename, int64 segment = -1, uint64 seed = 0)
+            {
+            std::vector<Arm> P;
+            const StatsSnapshot S = stats(&P); // path, position and loss from the same publication (does not pause the search)
+            PartialInfo info;
+            info.tour_hash = tourHash(tour().toVector());
+            info.segment = segment;
+            info.start = 0;
+            info.end = S.bestpos; // tour index of P.back(): the expanded path below is longer if P has jumps
+            info.loss = S.cum_loss;
+            info.seed = seed;
+            std::vector<uint64> inserted;
+            const std::vector<Arm> V = _expandJumps(P, &inserted);
+            ::savePartial(V, filename, info, inserted); // the inserted arms are recorded so loadPartial() removes exactly them
             return filename;
             }
 
 
+        /**
+        * Load a partial path (one arm per tour index, jumps not expanded).
+        **/
         void loadPartial(const std::vector<Arm>& Varm)
             {
-            MTOOLS_INSURE(Varm.size() > 0); 
+            loadPartial(ArmPath(Varm));
+            }
+
+
+        /**
+        * Load a partial path. The blocks of P are shared (not copied) so many
+        * searches can start from the same prefix at no cost. P[i] must be at
+        * tour[i] so P cannot be longer than the tour. The cumulative loss is
+        * recomputed from the configurations (detours and jumps).
+        **/
+        void loadPartial(const ArmPath& P)
+            {
+            MTOOLS_INSURE(P.size() > 0); 
+            MTOOLS_INSURE(P.size() <= _tour->size());
             bool ip = isPaused();
             pause(true);
-            _best.resize(Varm.size());
-            _current.resize(Varm.size());
-            for (int i = 0; i < Varm.size(); i++)
-                {
-                _best[i] = Varm[i];
-                _current[i] = Varm[i];
-                }
+            _best = P;
+            _current = P;
+            _compact();
+            for (int i = 0; i < (int)P.size(); i++) _mstart[i] = i;
+            _recomputeLoss();
+            _nb_visit_at_best = 0;
+            _min_steps = mtools::INF;
+            _min_loss = mtools::INF;
+            _bestset.clear();
+            _chg = 0;
+            _publishStats();
             pause(ip);
             return;
             }
 
 
+        /**
+        * Load a partial path from a file (kaggle format or binary path file). The
+        * tour hash of a binary file must match the tour of the search and the
+        * arms inserted by the expansion of its jumps are removed (they are
+        * recorded in the file). A kaggle file does not record them so it must be
+        * lossless (an arm at a position not on the tour is an error).
+        **/
         void loadPartial(const std::string & filename)
             {
+            if (isPartialFile(filename))
+                {
+                PartialFile F(filename);
+                if ((F.info().tour_hash != 0) && (F.info().tour_hash != tourHash(tour().toVector())))
+                    {
+                    MTOOLS_ERROR(std::string("TreeSearch::loadPartial(): ERROR, ") + filename + " is a path for another tour");
+                    }
+                loadPartial(F.toTourVector());
+                return;
+                }
             auto V = loadSolution(filename.c_str()); 
+            const PixelTour& T = tour();
+            for (size_t i = 0; i < V.size(); i++)
+                {
+                if ((i >= T.size()) || (V[i].pos() != T[i])) { MTOOLS_ERROR(std::string("TreeSearch::loadPartial(): ERROR, ") + filename + " does not follow the tour at index " + mtools::toString(i)); }
+                }
             loadPartial(V); 
             }
 
@@ -370,11 +571,8 @@ class TreeSearch
         **/
         const std::vector<Arm> bestPath()
             {
-            bool ip = isPaused();
-            pause(true);
-            auto V = _a2p.expandPath(_best, _precision2, _precision3);            
-            pause(ip);
-            return V;
+            auto P = bestSnapshot(); // does not pause the search
+            return _expandJumps(*P);
             }
 
 
@@ -388,18 +586,28 @@ class TreeSearch
             {
             bool ip = isPaused();
             pause(true);
-            auto V = _a2p.expandPath(_current, _precision2, _precision3);
+            auto V = _a2p.expandPath(_current.toVector(), _precision2, _precision3);
             pause(ip);
             return V;
             }
 
 
+        /**
+        * Reference to the current path (not expanded). Does not pause the search so
+        * it must only be used from the search thread itself, i.e. inside the heuristic.
+        **/
+        const ArmPath& currentPathRef() const
+            {
+            return _current;
+            }
+
+
         /**
         * Current position being studied
         **/
         int pos()
             {
-            return (int)_current.size() - 1;
+            return _stats.pos.load();
             }
 
         /**
@@ -407,7 +615,7 @@ class TreeSearch
         **/
         int bestpos()
             {
-            return (int)_best.size() - 1;
+            return _stats.bestpos.load();
             }
 
         /**
@@ -415,7 +623,7 @@ class TreeSearch
         **/
         double branch_probability()
             {
-            return _branch_prob;
+            return _stats.branch_prob.load();
             }
 
 
@@ -424,7 +632,7 @@ class TreeSearch
         **/
         int64 nbsteps()
             {
-            return (int64)_nbsteps;
+            return _stats.nbsteps.load();
             }
 
 
@@ -433,7 +641,7 @@ class TreeSearch
         **/
         double jump_steps()
             {
-            return _min_steps;
+            return _stats.min_steps.load();
             }
 
         /**
@@ -441,7 +649,7 @@ class TreeSearch
         **/
         double jump_loss()
             {
-            return _min_loss; 
+            return _stats.min_loss.load();
             }
 
 
@@ -450,7 +658,7 @@ class TreeSearch
         **/
         int jump_setsize()
             {
-            return (int)_bestset.size();
+            return _stats.setsize.load();
             }
 
 
@@ -459,7 +667,69 @@ class TreeSearch
         **/
         double cumulative_loss()
             {
-            return _cum_loss_at_best;
+            return _stats.cum_loss.load();
+            }
+
+
+        /**
+        * Consistent copy of all the statistics published by the search.
+        **/
+        struct StatsSnapshot
+            {
+            int64   nbsteps;
+            int     pos;
+            int     bestpos;
+            int     setsize;
+            double  min_steps;
+            double  min_loss;
+            double  branch_prob;
+            double  cum_loss;
+            };
+
+
+        /**
+        * Return a consistent copy of the statistics (and of the best path if P
+        * is not null). Does not pause the search: the search thread publishes
+        * under a sequence lock and the reader retries if a publication happened
+        * while it was copying (rare: there are 1024 steps between publications).
+        **/
+        StatsSnapshot stats(std::vector<Arm>* P = nullptr)
+            {
+            StatsSnapshot S;
+            while (1)
+                {
+                const uint64 s1 = _stats.seq.load(std::memory_order_acquire);
+                if (s1 & 1) { std::this_thread::yield(); continue; } // publication in progress
+                S.nbsteps = _stats.nbsteps.load(std::memory_order_relaxed);
+                S.pos = _stats.pos.load(std::memory_order_relaxed);
+                S.bestpos = _stats.bestpos.load(std::memory_order_relaxed);
+                S.setsize = _stats.setsize.load(std::memory_order_relaxed);
+                S.min_steps = _stats.min_steps.load(std::memory_order_relaxed);
+                S.min_loss = _stats.min_loss.load(std::memory_order_relaxed);
+                S.branch_prob = _stats.branch_prob.load(std::memory_order_relaxed);
+                S.cum_loss = _stats.cum_loss.load(std::memory_order_relaxed);
+                if (P)
+                    {
+                    P->resize(S.bestpos + 1);
+                    for (int i = 0; i <= S.bestpos; i++) (*P)[i].setVal(_pubpath[i].load(std::memory_order_relaxed));
+                    }
+                std::atomic_thread_fence(std::memory_order_acquire);
+                if (_stats.seq.load(std::memory_order_relaxed) == s1) return S;
+                }
+            }
+
+
+        /**
+        * Copy of the best path (not expanded: one arm per index of the tour) as
+        * last published by the search, and its cumulative loss. Does not pause the
+        * search so it can be used to copy the best prefix of a running search.
+        **/
+        std::shared_ptr<const std::vector<Arm>> bestSnapshot(double* loss = nullptr)
+            {
+            auto P = std::make_shared<std::vector<Arm>>();
+            auto S = stats(P.get());
+            if (loss) *loss = S.cum_loss;
+            return P;
             }
 
 
@@ -483,33 +753,189 @@ class TreeSearch
         /** Thread working method */
         template<typename HEURISTIC> void _threadproc(HEURISTIC fun)
             {
-            _ison = true;
+            _begin();
             _work(fun);
+            _publishStats();
             _ison = false;
             _ispaused = false; 
             }
 
 
+        /** Reset the state of the search loop before it starts. */
+        void _begin()
+            {
+            _nbsteps = 0;
+            _backtracked = false;
+            _updateTemperature();
+            _updateExcTime();
+            _publishStats();
+            }
+
+
+        /**
+        * Copy the statistics read by the other threads. Called by the search
+        * thread every 1024 steps, when it solves the tour, pauses or stops (but
+        * not at each new maximum) so the counters it updates at each step stay
+        * in its own cache lines and a reader copying a long best path is not
+        * invalidated at every step. Only the changed part of the best path is
+        * copied.
+        **/
+        void _publishStats()
+            {
+            const uint64 s = _stats.seq.load(std::memory_order_relaxed);
+            _stats.seq.store(s + 1, std::memory_order_relaxed); // odd: publication in progress
+            std::atomic_thread_fence(std::memory_order_release);
+            _stats.nbsteps.store(_nbsteps, std::memory_order_relaxed);
+            _stats.pos.store((int)_current.size() - 1, std::memory_order_relaxed);
+            _stats.min_steps.store(_min_steps, std::memory_order_relaxed);
+            _stats.min_loss.store(_min_loss, std::memory_order_relaxed);
+            _stats.setsize.store((int)_bestset.size(), std::memory_order_relaxed);
+            _stats.branch_prob.store(_branch_prob, std::memory_order_relaxed);
+            _stats.cum_loss.store(_cum_loss_at_best, std::memory_order_relaxed);
+            const int L = std::min((int)_best.size(), (int)_tour->size()); // _pubpath has one entry per tour pixel.
+            for (auto it = _best.iter(_chg); (it != _best.end()) && ((int)it.index() < L); ++it) _pubpath[it.index()].store((*it).val(), std::memory_order_relaxed); // only the part of the best path that changed
+            _chg = L;
+            _stats.bestpos.store(L - 1, std::memory_order_relaxed);
+            _stats.seq.store(s + 2, std::memory_order_release);
+            }
+
+
+        /**
+        * Expand the jumps of a path (one arm per tour index) with our own
+        * ArmToPixel object (the one of the search is busy). Returns P itself if
+        * it has no jump. If inserted is not null, it is set to the (increasing)
+        * indices in the expanded path of the arms inserted by the expansion.
+        **/
+        std::vector<Arm> _expandJumps(const std::vector<Arm>& P, std::vector<uint64>* inserted = nullptr) const
+            {
+            if (inserted) inserted->clear();
+            size_t i = 1;
+            while ((i < P.size()) && (penaltyL1(P[i - 1], P[i]) != mtools::INF)) i++;
+            if (i >= P.size()) return P;
+            MT2004_64 gen(P.size());
+            ArmToPixel a2p(gen);
+            std::vector<Arm> V(P.begin(), P.begin() + i);
+            V.reserve(P.size() + 100);
+            for (; i < P.size(); i++)
+                {
+                if (penaltyL1(P[i - 1], P[i]) != mtools::INF) { V.push_back(P[i]); continue; }
+                a2p.set(P[i - 1], P[i], _precision2, _precision3);
+                const auto B = a2p.best_path(); // ends with P[i]
+                MTOOLS_INSURE(B.size() >= 2);
+                for (size_t j = 0; j < B.size(); j++)
+                    {
+                    if ((inserted) && (j + 1 < B.size())) inserted->push_back(V.size());
+                    V.push_back(B[j]);
+                    }
+                }
+            return V;
+            }
+
+
+        /**
+        * Recompute the cumulative losses (_cumloss) of the current path, which
+        * was just loaded (and check that it follows the tour): a step with a loss (detour or jump) is registered at
+        * its starting index, as done by the search.
+        **/
+        void _recomputeLoss()
+            {
+            _cumloss.resize(1);
+            Arm prev;
+            for (auto it = _current.iter(0); it != _current.end(); ++it)
+                {
+                const Arm a = *it;
+                MTOOLS_INSURE(a.pos() == (*_tour)[it.index()]);
+                if (it.index() > 0)
+                    {
+                    double l;
+                    if (penaltyL1(prev, a) == mtools::INF) { _a2p.set(prev, a, _precision2, _precision3); l = _a2p.loss(); } // jump
+                    else l = lossL1(prev, a);
+                    if (l > 0.0000001) _cumloss.push_back({ (int)it.index() - 1, _cumloss.back().second + l });
+                    }
+                prev = a;
+                }
+            _cum_loss_at_best = _cumloss.back().second;
+            _bestcumloss = _cumloss;
+            }
+
+
+        /**
+        * Restart the current path from the first L arms of the best path (the
+        * blocks are shared) together with the losses registered on that prefix.
+        **/
+        void _toBestPrefix(int L)
+            {
+            _current.assignPrefix(_best, L);
+            int i = (int)_bestcumloss.size() - 1;
+            while ((i > 0) && (_bestcumloss[i].first >= L - 1)) i--;
+            _cumloss.assign(_bestcumloss.begin(), _bestcumloss.begin() + i + 1);
+            }
+
+
+        /**
+        * Pack the blocks of the best and current paths that lie well behind the
+        * current position (they are rarely modified again). The blocks shared by
+        * the two paths stay shared.
+        **/
+        void _compact()
+            {
+            const size_t margin = 2 * ArmPath::BLOCK_SIZE;
+            const size_t n = (_current.size() > margin) ? (_current.size() - margin) : 0;
+            _best.pack(n, &_current);
+            _current.pack(n);
+            }
+
+
+        /**
+        * Run one slice of at most K steps of a cooperative search.
+        * Return true when the search is over (solved or stopped).
+        **/
+        template<typename HEURISTIC> bool _runSlice(HEURISTIC & fun, int64 K)
+            {
+                {
+                std::lock_guard<std::mutex> lock(_slicemut);
+                if (!(bool)_ison) return true;
+                if ((bool)_ispaused) return false;
+                _inslice = true;
+                }
+            if (!(bool)_request_stop) { _work(fun, K); _publishStats(); }
+            bool over = false;
+                {
+                std::lock_guard<std::mutex> lock(_slicemut);
+                _inslice = false;
+                if (((bool)_request_stop) || (solved()))
+                    {
+                    _ison = false;
+                    over = true;
+                    }
+                }
+            _slicecv.notify_all();
+            return over;
+            }
+
+
         /**
         * Main search method. 
         **/
-        template<typename HEURISTIC> void _work(HEURISTIC fun)
+        template<typename HEURISTIC> void _work(HEURISTIC & fun, int64 maxsteps = -1)
             {
             Arm a;
-            bool backtracked = false;
-            _nbsteps = 0; 
-            _updateTemperature();
-            _updateExcTime();
+            bool detour = false;
             MTOOLS_INSURE(_current.size() > 0);
             int n = (int)_current.size() - 1;  // current position
-            const int N = (int)_tour.size() - 1; // end position 
+            const PixelTour& tour = *_tour;
+            const int N = (int)tour.size() - 1; // end position 
             while (n < N)
                 {  
+                if ((maxsteps >= 0) && (maxsteps-- == 0)) return; // end of the slice
+
                 //
                 // check for pause / resume / stop. 
                 // 
                 if (((++_nbsteps) & 1023) == 0)
-                    { // check for pause/stop action
+                    { // publish the statistics and check for pause/stop action
+                    _compact();
+                    _publishStats();
                     if ((bool)(_request_stop)) return;
                     if ((int)(_request_pause) == -1)
                         { // pausing the thread. 
@@ -522,8 +948,8 @@ class TreeSearch
                             }
                         _ispaused = false;
                         MTOOLS_INSURE(_current.size() > 0);
-                        int n = (int)_current.size() - 1;  // update current position if it has changed
-                        backtracked = false;
+                        n = (int)_current.size() - 1;  // update current position if it has changed
+                        _backtracked = false;
                         }
                     _updateTemperature();
                     _updateExcTime();
@@ -533,7 +959,7 @@ class TreeSearch
                 // Enumerate the direct sons 
                 // 
                 const Arm arm = _current[n];        // arm at the current position
-                const iVec2 target = _tour[n+1];    // target pixel
+                const iVec2 target = tour[n+1];     // target pixel
                 _potson.clear();                    // 
                 _potson.add(arm, target, 0);        // list all direct sons (i.e. without loss).
 
@@ -574,11 +1000,7 @@ class TreeSearch
                             }
                         if ((L <= 0)||(L > (int)_best.size())) L = (int)_best.size();
                                                
-                        _current.resize(L);
-                        for (int i = 0; i < L; i++)
-                            {
-                            _current[i] = _best[i];
-                            }
+                        _toBestPrefix(L);
                         n = (int)_current.size() - 1;
                         continue;
                         }
@@ -600,7 +1022,7 @@ class TreeSearch
                                 { // ok, we may try a jump
 
 
-                                _a2p.set(arm, target, _precision2, _precision3); // check for possible jump. 
+                                _a2p.set(arm, target, tour.id(n + 1), tour.colorUnits(n), _precision2, _precision3); // check for possible jump (id and color of the edge read from the tour). 
                                 const double nloss = _a2p.loss() + _cumloss.back().second;                                
                                 if (nloss <= e.maxCumLoss)
                                     { // ok, we perform the jump !
@@ -621,7 +1043,7 @@ class TreeSearch
                         auto pp = _bestset.insert(arm);
                         if (pp.second)
                             { // new arm never seen before: study it...
-                            _a2p.set(arm, target, _precision2, _precision3); // check ball of radius 2 and 3
+                            _a2p.set(arm, target, tour.id(n + 1), tour.colorUnits(n), _precision2, _precision3); // check ball of radius 2 and 3
                             const double st = _a2p.steps();
                             const double sl = _a2p.loss();
                             bool improved = ((sl < _min_loss) || ((_min_loss == mtools::INF) && (st < _min_steps)));
@@ -632,12 +1054,14 @@ class TreeSearch
                                 {
                                 // save the best tour
                                 _cum_loss_at_best = _cumloss.back().second;
+                                _bestcumloss = _cumloss;
                                 int i = n;
                                 while (_best[i] != _current[i])
                                     {
-                                    _best[i] = _current[i];
+                                    _best.set(i, _current[i]);
                                     i--;
                                     }
+                                if (i + 1 < _chg) _chg = i + 1;
                                 // clear stats
                                 _bestset.clear();
                                 _bestset.insert(arm);
@@ -648,19 +1072,21 @@ class TreeSearch
                     int b = (int)_G(_gen);
                     n -= b;
                     if (n < 0) n = 0;
+                    if (_mstart[n] < n) n = _mstart[n]; // do not stop inside a macro step.
                     _current.resize(n + 1);
 
                     int i = (int)_cumloss.size() - 1;
                     while (_cumloss[i].first >= n) i--; // sentinel at -1 prevent overflow
                     _cumloss.resize(i + 1);
 
-                    backtracked = true;
+                    _backtracked = true;
                     continue;
                     }
 
                 // 
                 // there are sons. Let us see we add a detour...
                 //                 
+                detour = false;
                 for (int i = ((int)_exctab.size()) -1; i >= 0; i--)
                     {
                     auto& e = _exctab[i];
@@ -682,6 +1108,7 @@ class TreeSearch
                                     continue;
                                     }
                                 _cumloss.push_back({ n, _cumloss.back().second + pen }); // register the loss. 
+                                detour = true;
                                 goto go_further; 
                                 }
                             }
@@ -694,31 +1121,25 @@ class TreeSearch
                 
             go_further: 
 
-                a = fun(n, arm, target, _potson, backtracked, this); // pick the next arm. 
-
-            go_further2:
-
-                backtracked = false;
-                _current.push_back(a); 
-                n++;
-                if (n >= _best.size())
-                    { 
-                    // new strict maximum ! here n == _best.size()
-                    _best.push_back(a); 
-                    int i = n - 1; 
-                    // save the best path
-                    _cum_loss_at_best = _cumloss.back().second;
-                    while (_best[i] != _current[i])
+                if ((!detour) && (_macro_min > 0) && (tour.runLength(n) >= _macro_min))
+                    { // straight run: lift it in one move.
+                    const int k = _macroStep(n, arm);
+                    if (k > 1)
                         {
-                        _best[i] = _current[i];
-                        i--; 
+                        _backtracked = false;
+                        for (int j = 1; j <= k; j++) _mstart[n + j] = (j < k) ? n : (n + k);
+                        for (int j = 0; j < k; j++) _push(_macro[j], n);
+                        continue;
                         }
-                    // clear stats
-                    _nb_visit_at_best = 0;
-                    _min_steps = mtools::INF;
-                    _min_loss = mtools::INF;
-                    _bestset.clear();
                     }
+
+                a = fun(n, arm, target, _potson, _backtracked, this); // pick the next arm. 
+
+            go_further2:
+
+                _backtracked = false;
+                _mstart[n + 1] = n + 1;
+                _push(a, n);
                 }
             //
             // SOLVED !!!!!!!!!
@@ -730,6 +1151,150 @@ class TreeSearch
 
 
 
+
+        /**
+        * Push an arm at the end of the current path and update the best path
+        * when a new maximum is reached.
+        **/
+        void _push(const Arm& a, int& n)
+            {
+            _current.push_back(a);
+            n++;
+            if (n >= _best.size())
+                {
+                // new strict maximum ! here n == _best.size()
+                _best.push_back(a);
+                int i = n - 1;
+                // save the best path
+                _cum_loss_at_best = _cumloss.back().second;
+                _bestcumloss = _cumloss;
+                while (_best[i] != _current[i])
+                    {
+                    _best.set(i, _current[i]);
+                    i--;
+                    }
+                if (i + 1 < _chg) _chg = i + 1;
+                // clear stats
+                _nb_visit_at_best = 0;
+                _min_steps = mtools::INF;
+                _min_loss = mtools::INF;
+                _bestset.clear();
+                if (n == (int)_tour->size() - 1) _publishStats(); // readers see a solution at once, a new maximum with the next periodic publication
+                }
+            }
+
+
+        /**
+        * Number of rotation of each arm that move its tip by U (the arm must be on
+        * a side parallel to U and cannot go past the corner) and the direction of
+        * the rotation.
+        **/
+        static void _budgets(const Arm& arm, iVec2 U, int* b, int* sgn)
+            {
+            for (int i = 0; i < Arm::NB_ARMS; i++)
+                {
+                const int l = arm.lenArm(i);
+                const iVec2 P = arm.pos(i);
+                b[i] = 0;
+                sgn[i] = 0;
+                if (U.Y() == 0)
+                    {
+                    if (abs(P.Y()) != l) continue;
+                    b[i] = (int)((U.X() > 0) ? (l - P.X()) : (P.X() + l));
+                    sgn[i] = ((P.Y() < 0) == (U.X() > 0)) ? 1 : -1; // bottom side: +1 goes right, top side: +1 goes left.
+                    }
+                else
+                    {
+                    if (abs(P.X()) != l) continue;
+                    b[i] = (int)((U.Y() > 0) ? (l - P.Y()) : (P.Y() + l));
+                    sgn[i] = ((P.X() > 0) == (U.Y() > 0)) ? 1 : -1; // right side: +1 goes up, left side: +1 goes down.
+                    }
+                }
+            }
+
+
+        /**
+        * Table W[i*(L+1) + r] = sum over the ways to distribute r rotations on the arms
+        * i..NB_ARMS-1 (within the budgets) of 1/prod(c_j!). Cached by budget vector.
+        **/
+        const std::vector<double>& _gait(const int* b)
+            {
+            uint64 key = 0;
+            for (int i = 0; i < Arm::NB_ARMS; i++) key = (key << GAIT_KEY_BITS) | (uint64)std::min(b[i], _macro_len);
+            auto it = _gaits.find(key);
+            if (it != _gaits.end()) return it->second;
+            if (_gaits.size() > 100000) _gaits.clear();
+            const int L = _macro_len;
+            std::vector<double> W((Arm::NB_ARMS + 1) * (L + 1), 0.0);
+            W[Arm::NB_ARMS * (L + 1)] = 1.0;
+            for (int i = Arm::NB_ARMS - 1; i >= 0; i--)
+                {
+                for (int r = 0; r <= L; r++)
+                    {
+                    double s = 0, f = 1;
+                    for (int c = 0; (c <= b[i]) && (c <= r); c++)
+                        {
+                        if (c > 0) f *= c;
+                        s += W[(i + 1) * (L + 1) + r - c] / f;
+                        }
+                    W[i * (L + 1) + r] = s;
+                    }
+                }
+            return (_gaits[key] = W);
+            }
+
+
+        /**
+        * Lift the straight run starting at index n from 'arm'. The arms are put in
+        * _macro. Return the number of pixels lifted (0 if no macro step was done).
+        **/
+        int _macroStep(int n, const Arm& arm)
+            {
+            const iVec2 U = _tour->step(n);
+            int b[Arm::NB_ARMS], sgn[Arm::NB_ARMS];
+            _budgets(arm, U, b, sgn);
+            int B = 0;
+            for (int i = 0; i < Arm::NB_ARMS; i++) B += b[i];
+            int k = std::min(std::min(_tour->runLength(n), _macro_len), B);
+            if (k < 2) return 0;
+            const std::vector<double>& W = _gait(b);
+            const int L = _macro_len;
+            // sample the number of rotations of each arm
+            int c[Arm::NB_ARMS];
+            int r = k;
+            for (int i = 0; i < Arm::NB_ARMS; i++)
+                {
+                double u = Unif(_gen) * W[i * (L + 1) + r];
+                double f = 1;
+                c[i] = 0;
+                const int cmax = std::min(b[i], r);
+                for (int x = 0; x <= cmax; x++)
+                    {
+                    if (x > 0) f *= x;
+                    const double w = W[(i + 1) * (L + 1) + r - x] / f;
+                    c[i] = x;
+                    if (u < w) break;
+                    u -= w;
+                    }
+                r -= c[i];
+                }
+            MTOOLS_ASSERT(r == 0);
+            // interleave the rotations at random
+            int ord[MACRO_MAX_LEN];
+            int m = 0;
+            for (int i = 0; i < Arm::NB_ARMS; i++) for (int j = 0; j < c[i]; j++) ord[m++] = i;
+            for (int j = m - 1; j > 0; j--) std::swap(ord[j], ord[(int)Unif_int(0, j, _gen)]);
+            _macro.resize(m);
+            Arm a = arm;
+            for (int j = 0; j < m; j++)
+                {
+                a.addAngle(ord[j], sgn[ord[j]]);
+                MTOOLS_ASSERT(a.pos() == (*_tour)[n + 1 + j]);
+                _macro[j] = a;
+                }
+            return m;
+            }
+
         
         void _updateTemperature()
             {
@@ -771,23 +1336,45 @@ class TreeSearch
 
 
 
-        std::atomic<int64_t> _nbsteps;  // number of steps in the search
+        int64 _nbsteps;             // number of steps in the search (only accessed by the search thread)
 
         std::thread* _th;           // the thread object
 
-        std::vector<iVec2>  _tour;  // the tour to rectify. 
+        std::shared_ptr<const PixelTour> _tour;  // the tour to lift (shared with the other searches on it)
 
         MT2004_64& _gen;            // RNG
         PotSon _potson;             // object to list potential sons. 
 
-        std::atomic<bool> _ison;     // is the thread currently working. 
+        alignas(64) std::atomic<bool> _ison;     // is the thread currently working. 
         std::atomic<bool> _request_stop; // true if the thread is requested to stop 
 
         std::atomic<bool> _ispaused;        // true is the thread is currently paused. 
         std::atomic<int> _request_pause;    // -1 = request pause, +1 request resume, 0 = nothing
 
+        /** statistics published by the search thread (in their own cache lines) */
+        struct alignas(64) Stats
+            {
+            std::atomic<uint64> seq;        // sequence lock: odd while a publication is in progress
+            std::atomic<int64>  nbsteps;
+            std::atomic<int>    pos;
+            std::atomic<int>    bestpos;
+            std::atomic<int>    setsize;
+            std::atomic<double> min_steps;
+            std::atomic<double> min_loss;
+            std::atomic<double> branch_prob;
+            std::atomic<double> cum_loss;
+            };
+        Stats _stats;
+
+        bool _coop;                 // true for a cooperative search (no thread)
+        std::mutex _slicemut;       // protects _inslice and the pause state of a cooperative search
+        std::condition_variable _slicecv;   // signals the end of a slice
+        bool _inslice;              // a slice of the cooperative search is running
+        std::function<void()> _onresume;    // called when a paused cooperative search is resumed or stopped
+        bool _backtracked;          // state of the search loop kept between slices
+
         
-        Chrono _ch_anneal;          // chronometer for annealing. 
+        alignas(64) Chrono _ch_anneal;          // chronometer for annealing. 
         uint64 _anneal_period;      // period in milliseconds
         double _min_branch_prob;    // min branch probability
         double _max_branch_prob;    // max branch probability
@@ -796,6 +1383,7 @@ class TreeSearch
 
 
         std::vector<std::pair<int, double>> _cumloss; // array of cumulative loss. The position is that of the jump/detour (the loss start after that).
+        std::vector<std::pair<int, double>> _bestcumloss; // same for the best path (restored with its prefixes).
         std::vector<ExcRange> _exctab; // array of exceptions. 
         Chrono _ch_exc;             // chronometer for exceptions
         uint64 _exc_period;         // period for exceptions
@@ -804,8 +1392,8 @@ class TreeSearch
 
         double _tunnel_prob;         // probability of tunneling
 
-        std::vector<Arm>    _best;          // best solution 
-        std::vector<Arm>    _current;       // current solution
+        ArmPath             _best;          // best solution 
+        ArmPath             _current;       // current solution (shares its blocks with _best)
         
         int64 _nb_visit_at_best; // number of visit at best index. 
         std::set<Arm, compareArm> _bestset;    // set of arms visited at current maximum
@@ -813,6 +1401,18 @@ class TreeSearch
         double _min_loss; // minimum loss found to cross the current maximum. 
         double _cum_loss_at_best; // cumulative loss of the best path
 
+        std::unique_ptr<std::atomic<uint64>[]> _pubpath; // published copy of the best path (written under the sequence lock)
+        int _chg;                   // the best path is unchanged before this index since the last publication
+
+
+        static constexpr int GAIT_KEY_BITS = 64 / Arm::NB_ARMS;                                   // bits per arm in the keys of _gaits
+        static constexpr int MACRO_MAX_LEN = (GAIT_KEY_BITS >= 8) ? 128 : ((1 << GAIT_KEY_BITS) - 1);  // so that the budgets fit in a key
+
+        std::vector<int> _mstart;   // index where the macro step that reached each index started
+        int _macro_min;             // minimum run length for a macro step (0 = disabled)
+        int _macro_len;             // maximum length of a macro step
+        std::vector<Arm> _macro;    // arms of the last macro step
+        std::unordered_map<uint64, std::vector<double>> _gaits; // cached gait tables by budget vector
 
         ArmToPixel _a2p; // compute short path outside of tour
         int _precision2;  // how much of the ball of size 2 we explore
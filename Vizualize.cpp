@@ -37,35 +37,35 @@ void drawSolCanvas(const std::vector<Arm>& best, const std::vector<iVec2>& tour,
 
     double minc = mtools::INF;
     double maxc = -mtools::INF;
-    for (int j = -128; j <= 128; j++)
+    for (int j = -SANTA_IMAGE_CY; j <= SANTA_IMAGE_CY; j++)
         {
-        for (int i = -128; i < 128; i++)
+        for (int i = -SANTA_IMAGE_CX; i < SANTA_IMAGE_CX; i++)
             { // (i,j) <-> (i+1, j)
             const double c = distcol({ i,j }, { i + 1,j });
             if (minc < c) minc = c;
             if (maxc > c) maxc = c;
             }
         }
-    for (int i = -128; i <= 128; i++)
+    for (int i = -SANTA_IMAGE_CX; i <= SANTA_IMAGE_CX; i++)
         {
-        for (int j = -128; j < 128; j++)
+        for (int j = -SANTA_IMAGE_CY; j < SANTA_IMAGE_CY; j++)
             { // (i,j) <-> (i, j+1)
             const double c = distcol({ i,j }, { i,j +1});
             if (minc < c) minc = c;
             if (maxc > c) maxc = c;
             }
         }
-    for (int j = -128; j <= 128; j++)
+    for (int j = -SANTA_IMAGE_CY; j <= SANTA_IMAGE_CY; j++)
         {
-        for (int i = -128; i < 128; i++)
+        for (int i = -SANTA_IMAGE_CX; i < SANTA_IMAGE_CX; i++)
             { // (i,j) <-> (i+1, j)
             const double c = distcol({ i,j }, { i + 1,j });
             L(mtools::Figure::ThickLine(fVec2(i+0.5, j-0.5), fVec2(i+0.5, j+0.5), 0.1, true, mtools::RGBc::jetPalette(c,minc, maxc)), 3);
             }
         }
-    for (int i = -128; i <= 128; i++)
+    for (int i = -SANTA_IMAGE_CX; i <= SANTA_IMAGE_CX; i++)
         {
-        for (int j = -128; j < 128; j++)
+        for (int j = -SANTA_IMAGE_CY; j < SANTA_IMAGE_CY; j++)
             { // (i,j) <-> (i, j+1)
             const double c = distcol({ i,j }, { i,j + 1 });            
             L(mtools::Figure::ThickLine(fVec2(i - 0.5, j + 0.5), fVec2(i + 0.5, j + 0.5), 0.1, true, mtools::RGBc::jetPalette(c, minc, maxc)), 3);
@@ -78,8 +78,8 @@ void drawSolCanvas(const std::vector<Arm>& best, const std::vector<iVec2>& tour,
     canvasArm(best[val], L, 2);
 
     mtools::Figure::Group G;
-    G(Figure::BoxRegion(fBox2(-140, 140, -140, 140), RGBc::c_Black));
-    G(Figure::BoxRegion(fBox2(-128.5, 128.5, -128.5, 128.5), RGBc::c_White));
+    G(Figure::BoxRegion(fBox2(-SANTA_IMAGE_CX - 12, SANTA_IMAGE_CX + 12, -SANTA_IMAGE_CY - 12, SANTA_IMAGE_CY + 12), RGBc::c_Black));
+    G(Figure::BoxRegion(fBox2(-SANTA_IMAGE_CX - 0.5, SANTA_IMAGE_CX + 0.5, -SANTA_IMAGE_CY - 0.5, SANTA_IMAGE_CY + 0.5), RGBc::c_White));
     L(G, 0);
     }
 
@@ -189,35 +189,35 @@ void _drawTour(mtools::FigureCanvas<5> & L, const std::vector<iVec2> & V)
 
     double minc = mtools::INF;
     double maxc = -mtools::INF;
-    for (int j = -128; j <= 128; j++)
+    for (int j = -SANTA_IMAGE_CY; j <= SANTA_IMAGE_CY; j++)
         {
-        for (int i = -128; i < 128; i++)
+        for (int i = -SANTA_IMAGE_CX; i < SANTA_IMAGE_CX; i++)
             { // (i,j) <-> (i+1, j)
             const double c = distcol({ i,j }, { i + 1,j });
             if (minc > c) minc = c;
             if (maxc < c) maxc = c;
             }
         }
-    for (int i = -128; i <= 128; i++)
+    for (int i = -SANTA_IMAGE_CX; i <= SANTA_IMAGE_CX; i++)
         {
-        for (int j = -128; j < 128; j++)
+        for (int j = -SANTA_IMAGE_CY; j < SANTA_IMAGE_CY; j++)
             { // (i,j) <-> (i, j+1)
             const double c = distcol({ i,j }, { i,j + 1 });
             if (minc > c) minc = c;
             if (maxc < c) maxc = c;
             }
         }
-    for (int j = -128; j <= 128; j++)
+    for (int j = -SANTA_IMAGE_CY; j <= SANTA_IMAGE_CY; j++)
         {
-        for (int i = -128; i < 128; i++)
+        for (int i = -SANTA_IMAGE_CX; i < SANTA_IMAGE_CX; i++)
             { // (i,j) <-> (i+1, j)
             const double c = (distcol({ i,j }, { i + 1,j }) - minc) / (maxc - minc);
             L(mtools::Figure::ThickLine(fVec2(i + 0.5, j - 0.45), fVec2(i + 0.5, j + 0.45), 0.1 * c, true, mtools::RGBc::jetPalette(c)), 3);
             }
         }
-    for (int i = -128; i <= 128; i++)
+    for (int i = -SANTA_IMAGE_CX; i <= SANTA_IMAGE_CX; i++)
         {
-        for (int j = -128; j < 128; j++)
+        for (int j = -SANTA_IMAGE_CY; j < SANTA_IMAGE_CY; j++)
             { // (i,j) <-> (i, j+1)
             const double c = (distcol({ i,j }, { i + 1,j }) - minc) / (maxc - minc);
             L(mtools::Figure::ThickLine(fVec2(i - 0.45, j + 0.5), fVec2(i + 0.45, j + 0.5), 0.1 * c, true, mtools::RGBc::jetPalette(c)), 3);
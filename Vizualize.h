@@ -14,7 +14,7 @@ template<class CANVAS>
 void canvasArm(Arm a, CANVAS & Canvas, int layer, RGBc color_bk = RGBc::c_Blue.getMultOpacity(0.1f), RGBc color_border = RGBc::c_Black)
     {
     mtools::Figure::Group G;
-    for (int i = 7; i >= 0; i--)
+    for (int i = Arm::NB_ARMS - 1; i >= 0; i--)
         {
         iVec2 P = a.centerBox(i);
         cout << " i = " << i << "  | " << P << "\n";
@@ -554,8 +554,72 @@ static const BasicPoint  p2reachTab1_N7[257 * 257] = {
 static const BasicPoint * p2reachTab[8] = { nullptr, p2reachTab1_N1 , p2reachTab1_N2, p2reachTab1_N3, p2reachTab1_N4,p2reachTab1_N5,p2reachTab1_N6, p2reachTab1_N7 };
 
 
+/**
+* Same table for an arm of length L = 2^(U-1) computed at runtime (used for the
+* arm index 8, i.e. 9 arms, whose table is not compiled in). This is the
+* create_p2reach_array() code below: for each target T of the (4L+1)^2 box, the
+* range [first, second] of the positions (along the 8L positions of the arm)
+* from which T is in the L-infinity ball of radius L.
+**/
+static std::vector<BasicPoint> create_p2reach_array(int U)
+    {
+    const int L = (1 << (U - 1));
+    const int W = 4 * L + 1;
+    std::vector<BasicPoint> tab(W * W);
+    std::vector<int> intab(8 * L, 0);
+    for (int y = 0; y < W; y++)
+        {
+        for (int x = 0; x < W; x++)
+            {
+            for (int a = 0; a < 8 * L; a++)
+                {
+                int px, py;
+                if (a < 2 * L) { px = L + a; py = L; }
+                else if (a < 4 * L) { px = 3 * L; py = L + a - 2 * L; }
+                else if (a < 6 * L) { px = 7 * L - a; py = 3 * L; }
+                else { px = L; py = 9 * L - a; }
+                intab[a] = (std::max(abs(px - x), abs(py - y)) <= L) ? 1 : 0;
+                }
+            BasicPoint& B = tab[x + W * y];
+            if ((x == 2 * L) && (y == 2 * L))
+                {
+                B.x = 0;
+                B.y = 8 * L - 1;
+                }
+            else if (intab[0] == 1)
+                {
+                int i = 8 * L - 1;
+                while (intab[i] == 1) { i--; }
+                i++;
+                if (i == 8 * L) i = 0;
+                B.x = i;
+                i = 0;
+                while (intab[i] == 1) { i++; }
+                B.y = i - 1;
+                }
+            else
+                {
+                int i = 0;
+                while (intab[i] == 0) { i++; }
+                B.x = i;
+                while (intab[i % (8 * L)] == 1) { i++; }
+                B.y = i - 1;
+                }
+            }
+        }
+    return tab;
+    }
+
+
 std::pair<int,int> p2reach(int arm_index, int64 pos)
     {
+    if (arm_index >= 8)
+        {
+        MTOOLS_ASSERT(arm_index == 8);
+        static const std::vector<BasicPoint> p2reachTab1_N8 = create_p2reach_array(8); // built on first use (thread safe)
+        auto BP = p2reachTab1_N8[pos];
+        return { BP.x, BP.y };
+        }
     auto BP = p2reachTab[arm_index][pos];;
     return { BP.x, BP.y };
     }
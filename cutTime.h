@@ -52,9 +52,14 @@ struct CutTime
 *        3 + 1
 *          0
 * time to enter a half plane from the oppposte one. 
+* 
+* The half planes are taken relative to the center C (the origin for the 
+* largest arm) and the search stops at index nmax (tour.size() if nmax < 0). 
+* The tour is a std::vector<iVec2> or a PixelTour.
 */
-inline CutTime timeEnter(int startHP, const std::vector<iVec2>& tour, int n0)
+template<typename TOUR> inline CutTime timeEnter(int startHP, const TOUR& tour, int n0, iVec2 C = iVec2(0, 0), int nmax = -1)
     {
+    const int N = ((nmax < 0) || (nmax > (int)tour.size())) ? (int)tour.size() : nmax;
     int n = n0;
     int km = 0; 
     int kp = 0;
@@ -62,10 +67,10 @@ inline CutTime timeEnter(int startHP, const std::vector<iVec2>& tour, int n0)
         {
         case 0: 
             {
-            iVec2 P = tour[n++];
-            while (n < tour.size()) 
+            iVec2 P = tour[n++] - C;
+            while (n < N)
                 {
-                const iVec2 Q = tour[n]; 
+                const iVec2 Q = tour[n] - C;
                 const int e = (int)(Q - P).X();
                 if (e > 0)  kp++; else if (e < 0) km++; 
                 if (Q.Y() > 0)
@@ -79,10 +84,10 @@ inline CutTime timeEnter(int startHP, const std::vector<iVec2>& tour, int n0)
             }
         case 1: 
             {
-            iVec2 P = tour[n++];
-            while (n < tour.size()) 
+            iVec2 P = tour[n++] - C;
+            while (n < N)
                 {
-                const iVec2 Q = tour[n]; 
+                const iVec2 Q = tour[n] - C;
                 const int e = (int)(Q - P).Y();
                 if (e > 0)  kp++; else if (e < 0) km++; 
                 if (Q.X() < 0)
@@ -96,10 +101,10 @@ inline CutTime timeEnter(int startHP, const std::vector<iVec2>& tour, int n0)
             }
         case 2: 
             {
-            iVec2 P = tour[n++];
-            while (n < tour.size()) 
+            iVec2 P = tour[n++] - C;
+            while (n < N)
                 {
-                const iVec2 Q = tour[n]; 
+                const iVec2 Q = tour[n] - C;
                 const int e = (int)(Q - P).X();
                 if (e > 0)  kp++; else if (e < 0) km++; 
                 if (Q.Y() < 0)
@@ -113,10 +118,10 @@ inline CutTime timeEnter(int startHP, const std::vector<iVec2>& tour, int n0)
             }
         case 3:
             {
-            iVec2 P = tour[n++];
-            while (n < tour.size()) 
+            iVec2 P = tour[n++] - C;
+            while (n < N)
                 {
-                const iVec2 Q = tour[n]; 
+                const iVec2 Q = tour[n] - C;
                 const int e = (int)(Q - P).Y();
                 if (e > 0)  kp++; else if (e < 0) km++; 
                 if (Q.X() > 0)
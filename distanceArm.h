@@ -1,6 +1,7 @@
 #pragma once
 
 #include "Arm.h"
+#include "ExactCost.h"
 
 
 
@@ -25,38 +26,33 @@ inline int dtorus(int x, int y, int l)
     }
 
 
+/**
+* Number of arms moved between two arms configurations.
+* Return -1 if not reachable in a single step. 
+**/
+template<int NARMS> inline int armMoves(ArmT<NARMS> a, ArmT<NARMS> b)
+    {
+    const ArmT<NARMS> d = b - a;
+    int m = 0;
+    for (int k = 0; k < NARMS; k++)
+        {
+        const int v = d.angle(k);
+        if (v == 0) continue;
+        if ((v != 1) && (v != 8 * d.lenArm(k) - 1)) return -1;
+        m++;
+        }
+    return m;
+    }
+
+
 /**
 * Compute the penalty between two arms configuration.
 * Return +INF if not reachable in a single step. 
 **/
-inline double penaltyL1(Arm a, Arm b)
+template<int NARMS> inline double penaltyL1(ArmT<NARMS> a, ArmT<NARMS> b)
     {
-    int m = 0;
-    int d0 = dtorus(a._A0, b._A0, 8);
-    if (d0 > 1) return mtools::INF;
-    m += d0;
-    int d1 = dtorus(a._A1, b._A1, 8);
-    if (d1 > 1) return mtools::INF;
-    m += d1;
-    int d2 = dtorus(a._A2, b._A2, 16);
-    if (d2 > 1) return mtools::INF;
-    m += d2;
-    int d3 = dtorus(a._A3, b._A3, 32);
-    if (d3 > 1) return mtools::INF;
-    m += d3;
-    int d4 = dtorus(a._A4, b._A4, 64);
-    if (d4 > 1) return mtools::INF;
-    m += d4;
-    int d5 = dtorus(a._A5, b._A5, 128);
-    if (d5 > 1) return mtools::INF;
-    m += d5;
-    int d6 = dtorus(a._A6, b._A6, 256);
-    if (d6 > 1) return mtools::INF;
-    m += d6;
-    int d7 = dtorus(a._A7, b._A7, 512);
-    if (d7 > 1) return mtools::INF;
-    m += d7;
-    return sqrt(m);
+    const int m = armMoves(a, b);
+    return (m < 0) ? mtools::INF : sqrt(m);
     }
 
 
@@ -64,7 +60,7 @@ inline double penaltyL1(Arm a, Arm b)
 /**
 * Return the loss of moving from a to b compared to the sqrt(L1) norm on the pixel.
 **/
-inline double lossL1(Arm a, Arm b)
+template<int NARMS> inline double lossL1(ArmT<NARMS> a, ArmT<NARMS> b)
     {
     const iVec2 P = a.pos() - b.pos();
     return penaltyL1(a, b) - sqrt(abs(P.X()) + abs(P.Y()));
@@ -132,7 +128,7 @@ class ArmToArm
         _a = a; 
         _b = d - a; 
 
-        for (int k = 0; k < 8; k++) { _order[k] = k; }
+        for (int k = 0; k < Arm::NB_ARMS; k++) { _order[k] = k; }
 
         std::sort(_order.begin(), _order.end(),
             [&](const int& u, const int& v)
@@ -140,16 +136,14 @@ class ArmToArm
                 return (_norm_unsorted(u) < _norm_unsorted(v));
                 });
 
-        _steps = _norm_sorted(7); 
+        _steps = _norm_sorted(Arm::NB_ARMS - 1); 
 
-        _sqrtL1 = (_norm_sorted(7) - _norm_sorted(6)) * 1 +
-                  (_norm_sorted(6) - _norm_sorted(5)) * sqrt(2) +
-                  (_norm_sorted(5) - _norm_sorted(4)) * sqrt(3) +
-                  (_norm_sorted(4) - _norm_sorted(3)) * sqrt(4) +
-                  (_norm_sorted(3) - _norm_sorted(2)) * sqrt(5) +
-                  (_norm_sorted(2) - _norm_sorted(1)) * sqrt(6) +
-                  (_norm_sorted(1) - _norm_sorted(0)) * sqrt(7) +
-                  _norm_sorted(0) * sqrt(8);
+        // moving the arm of sorted index j and all the larger ones costs sqrt(NB_ARMS - j) per step.
+        _sqrtL1 = 0;
+        for (int j = Arm::NB_ARMS - 1; j >= 0; j--)
+            {
+            _sqrtL1 += (_norm_sorted(j) - ((j > 0) ? _norm_sorted(j - 1) : 0)) * sqrt((double)(Arm::NB_ARMS - j));
+            }
         }
 
     /**
@@ -190,7 +184,7 @@ class ArmToArm
 
     Arm                 _a; 
     Arm                 _b; 
-    std::array<int, 8>  _order; 
+    std::array<int, Arm::NB_ARMS>  _order; 
 
     double              _steps;
     double              _sqrtL1;
@@ -202,19 +196,42 @@ class ArmToArm
 
 
 
-class ArmToPixel
+/**
+* Find the best short path (2 to 4 steps) from an arm to a pixel.
+*
+* Templated on the number of arms (ArmToPixel is the instance for the arms of
+* the challenge).
+**/
+template<int NARMS> class ArmToPixelT
     {
 
+        typedef ArmT<NARMS> Arm;
+        typedef ArmDims<NARMS> Dims;
+
     public:
 
 
-        ArmToPixel(MT2004_64 & gen) : _gen(gen)
+        ArmToPixelT(MT2004_64 & gen) : _gen(gen)
             {
-            _cost = mtools::INF;
+            _cost = ExactCost::infinity();
             _steps = mtools::INF;           
             _createNeighbour();
             _ch.reset();
             _busyt = 0; 
+            _max_ball = 4;
+            }
+
+
+        /**
+        * Set the radius of the largest ball explored by set() (between 2 and 4).
+        * The ball of radius 4 is costly (about 0.1s per call): with max_ball < 4, a
+        * pixel that needs 4 steps is reported with steps() = 4 and an infinite loss.
+        **/
+        void setMaxBall(int max_ball)
+            {
+            if (max_ball < 2) max_ball = 2;
+            if (max_ball > 4) max_ball = 4;
+            _max_ball = max_ball;
             }
 
 
@@ -224,7 +241,7 @@ class ArmToPixel
         * 
         * a = start point
         * P = end pixel
-        * precision3 in [2, 8] for calculating the ball of size 3. 
+        * precision3 in [2, NARMS] for calculating the ball of size 3. 
         * 
         * !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
         * !!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!!
@@ -239,7 +256,22 @@ class ArmToPixel
         void set(Arm a, iVec2 P, int precision2, int precision3)
             {
             auto start = std::chrono::high_resolution_clock::now();
-            _set(a, P, precision2, precision3, false, Arm());
+            _set(a, P, coord2id(P), -1, precision2, precision3, false, Arm());
+            auto elapsed = std::chrono::high_resolution_clock::now() - start;
+            _busyt += std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
+            }
+
+
+
+        /**
+        * Same as above for the edge n -> n+1 of a PixelTour (a at tour[n] and
+        * P = tour[n+1]): the pixel id of P and the color units of the edge are
+        * read from the tour instead of being recomputed.
+        **/
+        void set(Arm a, iVec2 P, int Pid, int edge_units, int precision2, int precision3)
+            {
+            auto start = std::chrono::high_resolution_clock::now();
+            _set(a, P, Pid, edge_units, precision2, precision3, false, Arm());
             auto elapsed = std::chrono::high_resolution_clock::now() - start;
             _busyt += std::chrono::duration_cast<std::chrono::microseconds>(elapsed).count();
             }
@@ -251,7 +283,7 @@ class ArmToPixel
         **/
         void set(Arm a, Arm target, int precision2, int precision3)
             {
-            _set(a, target.pos(), precision2, precision3, true, target);
+            _set(a, target.pos(), coord2id(target.pos()), -1, precision2, precision3, true, target);
             }
 
 
@@ -277,14 +309,18 @@ class ArmToPixel
         /**
         * Return the loss of the best path found
         * compared to the image penalty + L1 norm. 
+        * 
+        * The costs are exact (see ExactCost) so a lossless path has loss exactly 0.
         **/
         double loss()
             {
+            if (_cost.isInf()) return mtools::INF;
             iVec2 Q = _a.pos(); 
             auto R = Q - _P; 
-            double pl1 = sqrt(abs(R.X()) + abs(R.Y()));
-            double dc = distcol(Q, _P);           
-            return _cost - pl1 - dc  -((_steps < mtools::INF) ? (0.0000001 * _steps) : 0);
+            const int l1 = (int)(abs(R.X()) + abs(R.Y()));
+            const ExactCost e = _cost - ExactCost::color((_edgeu >= 0) ? _edgeu : distcolUnits(coord2id(Q), _Pid)); // color of the direct edge
+            if (l1 <= Dims::MAX_MOVE) return (e - ExactCost::sqrtL1(l1)).toDouble();
+            return e.toDouble() - sqrt((double)l1); // sqrt(l1) is not in the basis
             }
 
 
@@ -294,7 +330,7 @@ class ArmToPixel
         std::vector<Arm> best_path()
             {
             std::vector<Arm> v;
-            if (_cost == mtools::INF) return v; 
+            if (_cost.isInf()) return v; 
             v.push_back(_a1);
             v.push_back(_a2);
             if (_steps == 2) return v;
@@ -311,7 +347,7 @@ class ArmToPixel
         **/
         Arm endPath()
             {
-            MTOOLS_INSURE(_cost < mtools::INF);
+            MTOOLS_INSURE(!_cost.isInf());
             if (_steps == 2) return _a2;
             if (_steps == 3) return _a3;
             return _a4;
@@ -349,11 +385,13 @@ class ArmToPixel
 
 
      
-        void _set(Arm a, iVec2 P, int precision2, int precision3, bool use_target, Arm target)
+        void _set(Arm a, iVec2 P, int Pid, int edgeu, int precision2, int precision3, bool use_target, Arm target)
             {
             _a = a; 
             _P = P; 
-            _cost = mtools::INF;
+            _Pid = Pid;
+            _edgeu = edgeu;
+            _cost = ExactCost::infinity();
             _steps = mtools::INF;
             int sm2 = 1000;
             int sm3 = 1000;
@@ -362,12 +400,12 @@ class ArmToPixel
                 { 
                 // normal case: compute the extremal config a P. 
                 auto _V = a.pathToReach(P);
-                for (int i = 0; i < 128; i++)
+                for (int i = 0; i < Dims::NB_EXTREMAL; i++)
                     {
                     Arm b = _V[i] - a;
                     int st = 0;
                     int sm = 0; 
-                    for (int k = 0; k < 8; k++)
+                    for (int k = 0; k < NARMS; k++)
                         {
                         int u = dtorus(b.angle(k), 0, 8 * b.lenArm(k));;
                         if (u > st) st = u;
@@ -378,7 +416,7 @@ class ArmToPixel
                     if ((st == 4) && (sm < sm3)) sm4 = sm;
                     if (st < _steps) _steps = st;
                     }
-                if (_steps > 4) return; 
+                if (_steps > _max_ball) return; 
                 }            
 
             if (_steps == mtools::INF)
@@ -414,42 +452,52 @@ class ArmToPixel
 
         /**
         * Explore the full ball of radius 2.
+        * 
+        * For fixed numbers of arms moved (i1, i2) the sqrt part of the cost is
+        * fixed so the arms are pruned on the color units only: 'bud' is the
+        * largest number of color units that keeps the cost <= the best one.
         **/
         void _ball2(int maxL, int sm, bool use_target, Arm target)
             {
             std::vector<std::array<Arm, 2>> sol; 
             if (sm > (2 * maxL)) return; // there cannot be a solution
-            double cost = mtools::INF;  // infinite loss
-            const iVec2 Q = _a.pos(); // start pixel 
+            ExactCost cost = ExactCost::infinity();  // infinite loss
+            const int Qid = coord2id(_a.pos()); // start pixel
             const int end1 = std::min(maxL, sm);
             for (int i1 = 1; i1 <= end1; i1++)
                 {
-                const double e1 = sqrt(i1);
+                const ExactCost e1 = ExactCost::sqrtL1(i1);
                 if (e1 <= cost)
                     {
                     const int end2 = std::min(maxL, sm - i1);
                     for (int i2 = 1; i2 <= end2; i2++)
                         {
-                        const double e2 = e1 + sqrt(i2);
+                        const ExactCost e2 = e1 + ExactCost::sqrtL1(i2);
                         if (e2 <= cost)
                             {
+                            int bud = cost.colorBudget(e2);
                             for (Arm n1 : _neig[i1])
                                 {
                                 const iVec2 P1 = (n1 + _a).pos();
-                                const double e3 = e2 + distcol(Q, P1);
-                                if (e3 <= cost)
+                                const int id1 = coord2id(P1);
+                                const int u3 = distcolUnits(Qid, id1);
+                                if (u3 <= bud)
                                     {
                                     for (Arm n2 : _neig[i2])
                                         {
                                         const iVec2 P2 = (n1 + n2 + _a).pos();
-                                        const double e4 = e3 + distcol(P1, P2);
-                                        if ((e4 <= cost) && (P2 == _P))
+                                        if (P2 != _P) continue; // only the last edge to the target pixel is costed
+                                        const int u4 = u3 + distcolUnits(id1, _Pid);
+                                        if (u4 <= bud)
                                             {
                                             if ((!use_target) || (_a + n1 + n2 == target))
                                                 {
+                                                ExactCost e4 = e2;
+                                                e4.addColor(u4);
                                                 if (e4 < cost) sol.clear();
                                                 sol.push_back({ _a + n1 , _a + n1 + n2 });
                                                 cost = e4;
+                                                bud = u4;
                                                 }
                                             }
                                         }
@@ -482,50 +530,57 @@ class ArmToPixel
         void _ball3(int maxL, int sm, bool use_target, Arm target)
             {
             if (sm > (3 * maxL)) return; // there cannot be a solution
-            double cost = mtools::INF;  // infinite loss
-            const iVec2 Q = _a.pos(); // start pixel
+            ExactCost cost = ExactCost::infinity();  // infinite loss
+            const int Qid = coord2id(_a.pos()); // start pixel
             std::vector<std::array<Arm, 3>> sol;
             const int end1 = std::min(maxL, sm);
             for (int i1 = 1; i1 <= end1; i1++)
                 {
-                const double e1 = sqrt(i1);
+                const ExactCost e1 = ExactCost::sqrtL1(i1);
                 if (e1 <= cost)
                     {
                     const int end2 = std::min(maxL, sm - i1);
                     for (int i2 = 1; i2 <= end2; i2++)
                         {
-                        const double e2 = e1 + sqrt(i2);
+                        const ExactCost e2 = e1 + ExactCost::sqrtL1(i2);
                         if (e2 <= cost)
                             {
                             const int end3 = std::min(maxL, sm - i1 - i2);
                             for (int i3 = 1; i3 <= end3; i3++)
                                 {
-                                const double e3 = e2 + sqrt(i3);
+                                const ExactCost e3 = e2 + ExactCost::sqrtL1(i3);
                                 if (e3 <= cost)
                                     {
+                                    int bud = cost.colorBudget(e3);
                                     for (Arm n1 : _neig[i1])
                                         {
                                         const iVec2 P1 = (n1 + _a).pos();
-                                        const double e4 = e3 + distcol(Q, P1);
-                                        if (e4 <= cost)
+                                        const int id1 = coord2id(P1);
+                                        const int u4 = distcolUnits(Qid, id1);
+                                        if (u4 <= bud)
                                             {
                                             for (Arm n2 : _neig[i2])
                                                 {
                                                 const iVec2 P2 = (n1 + n2 + _a).pos();
-                                                const double e5 = e4 + distcol(P1, P2);
-                                                if (e5 <= cost)
+                                                const int id2 = coord2id(P2);
+                                                const int u5 = u4 + distcolUnits(id1, id2);
+                                                if (u5 <= bud)
                                                     {
                                                     for (Arm n3 : _neig[i3])
                                                         {
                                                         const iVec2 P3 = (n1 + n2 + n3 + _a).pos();
-                                                        const double e6 = e5 + distcol(P2, P3);
-                                                        if ((e6 <= cost) && (P3 == _P))
+                                                        if (P3 != _P) continue; // only the last edge to the target pixel is costed
+                                                        const int u6 = u5 + distcolUnits(id2, _Pid);
+                                                        if (u6 <= bud)
                                                             {
                                                             if ((!use_target) || (_a + n1 + n2 + n3 == target))
                                                                 {
+                                                                ExactCost e6 = e3;
+                                                                e6.addColor(u6);
                                                                 if (e6 < cost) sol.clear();
                                                                 sol.push_back({ _a + n1 , _a + n1 + n2, _a + n1 + n2 + n3 });
                                                                 cost = e6;
+                                                                bud = u6;
                                                                 }
                                                             }
                                                         }
@@ -562,174 +617,58 @@ class ArmToPixel
             {
             switch (sm)
                 {
-                case 5: { _ball4_5(use_target, target); break; }
-                case 6: { _ball4_6(use_target, target); break; }
-                case 7: { _ball4_7(use_target, target); break; }
-                }
-            }
-
-
-
-        void _ball4_5(bool use_target, Arm target)
-            {
-            double cost = mtools::INF;  // infinite loss
-            const iVec2 Q = _a.pos(); // start pixel
-            std::vector<std::array<Arm, 4>> sol;
-            const double fixed_cost = (sqrt(2) + 3);
-            for (Arm n1 : _neig[2])
-                {
-                const iVec2 P1 = (n1 + _a).pos();
-                const double e1 = distcol(Q, P1) + fixed_cost;;
-                if (e1 <= cost)
-                    {
-                    for (Arm n2 : _neig[1])
-                        {
-                        const iVec2 P2 = (n1 + n2 + _a).pos();
-                        const double e2 = e1 + distcol(P1, P2);
-                        if (e2 <= cost)
-                            {
-                            for (Arm n3 : _neig[1])
-                                {
-                                const iVec2 P3 = (n1 + n2 + n3 + _a).pos();
-                                const double e3 = e2 + distcol(P2, P3);
-                                if (e3 <= cost)
-                                    {
-                                    for (Arm n4 : _neig[1])
-                                        {
-                                        const iVec2 P4 = (n1 + n2 + n3 + n4 + _a).pos();
-                                        const double e4 = e3 + distcol(P3, P4);
-                                        if ((e4 <= cost) && (P4 == _P))
-                                            {
-                                            if ((!use_target) || (n1 + n2 + n3 + n4 + _a == target))
-                                                {
-                                                if (e4 < cost) sol.clear();
-                                                sol.push_back({ _a + n1 , _a + n1 + n2, _a + n1 + n2 + n3, _a + n1 + n2 + n3 + n4 });
-                                                cost = e4;
-                                                }
-                                            }
-                                        }
-                                    }
-                                }
-                            }
-                        }
-                    }
-                }
-            if (sol.size() > 0)
-                {
-                if (cost < _cost)
-                    {
-                    _steps = 4;
-                    _cost = cost;
-                    const int64_t i = Unif_int(0, sol.size() - 1, _gen);
-                    _a1 = (sol[i])[0];
-                    _a2 = (sol[i])[1];
-                    _a3 = (sol[i])[2];
-                    _a4 = (sol[i])[3];
-                    }
+                case 5: { _ball4_moves(2, 1, 1, 1, use_target, target); break; }
+                case 6: { _ball4_moves(2, 2, 1, 1, use_target, target); break; }
+                case 7: { _ball4_moves(2, 2, 2, 1, use_target, target); break; }
                 }
             }
 
 
 
         /**
-        * Explore the ball of radius 4 (but use only move of size 1).
+        * Explore the paths of 4 steps moving k1, k2, k3, k4 arms. The sqrt part
+        * of the cost is fixed so only the color units are compared.
         **/
-        void _ball4_6(bool use_target, Arm target)
+        void _ball4_moves(int k1, int k2, int k3, int k4, bool use_target, Arm target)
             {
-            double cost = mtools::INF;  // infinite loss
-            const iVec2 Q = _a.pos(); // start pixel
+            const ExactCost fixed_cost = ExactCost::sqrtL1(k1) + ExactCost::sqrtL1(k2) + ExactCost::sqrtL1(k3) + ExactCost::sqrtL1(k4);
+            const int INF_UNITS = std::numeric_limits<int>::max();
+            int bud = INF_UNITS; // color units of the best path found
+            const int Qid = coord2id(_a.pos()); // start pixel
             std::vector<std::array<Arm, 4>> sol;
-            const double fixed_cost = (2 * sqrt(2) + 2);
-            for (Arm n1 : _neig[2])
+            for (Arm n1 : _neig[k1])
                 {
                 const iVec2 P1 = (n1 + _a).pos();
-                const double e1 = distcol(Q, P1) + fixed_cost;;
-                if (e1 <= cost)
+                const int id1 = coord2id(P1);
+                const int u1 = distcolUnits(Qid, id1);
+                if (u1 <= bud)
                     {
-                    for (Arm n2 : _neig[2])
+                    for (Arm n2 : _neig[k2])
                         {
                         const iVec2 P2 = (n1 + n2 + _a).pos();
-                        const double e2 = e1 + distcol(P1, P2);
-                        if (e2 <= cost)
+                        const int id2 = coord2id(P2);
+                        const int u2 = u1 + distcolUnits(id1, id2);
+                        if (u2 <= bud)
                             {
-                            for (Arm n3 : _neig[1])
+                            for (Arm n3 : _neig[k3])
                                 {
                                 const iVec2 P3 = (n1 + n2 + n3 + _a).pos();
-                                const double e3 = e2 + distcol(P2, P3);
-                                if (e3 <= cost)
+                                const int id3 = coord2id(P3);
+                                const int u3 = u2 + distcolUnits(id2, id3);
+                                if (u3 <= bud)
                                     {
-                                    for (Arm n4 : _neig[1])
+                                    for (Arm n4 : _neig[k4])
                                         {
                                         const iVec2 P4 = (n1 + n2 + n3 + n4 + _a).pos();
-                                        const double e4 = e3 + distcol(P3, P4);
-                                        if ((e4 <= cost) && (P4 == _P))
+                                        if (P4 != _P) continue; // only the last edge to the target pixel is costed
+                                        const int u4 = u3 + distcolUnits(id3, _Pid);
+                                        if (u4 <= bud)
                                             {
                                             if ((!use_target) || (n1 + n2 + n3 + n4 + _a == target))
                                                 {
-                                                if (e4 < cost) sol.clear();
+                                                if (u4 < bud) sol.clear();
                                                 sol.push_back({ _a + n1 , _a + n1 + n2, _a + n1 + n2 + n3, _a + n1 + n2 + n3 + n4 });
-                                                cost = e4;
-                                                }
-                                            }
-                                        }
-                                    }                            
-                                }
-                            }
-                        }
-                    }
-                }
-            if (sol.size() > 0)
-                {        
-                if (cost < _cost)
-                    {
-                    _steps = 4;
-                    _cost = cost;
-                    const int64_t i = Unif_int(0, sol.size() - 1, _gen);
-                    _a1 = (sol[i])[0];
-                    _a2 = (sol[i])[1];
-                    _a3 = (sol[i])[2];
-                    _a4 = (sol[i])[3];
-                    }
-                }
-            }
-
-
-
-        void _ball4_7(bool use_target, Arm target)
-            {
-            double cost = mtools::INF;  // infinite loss
-            const iVec2 Q = _a.pos(); // start pixel
-            std::vector<std::array<Arm, 4>> sol;
-            const double fixed_cost = (3 * sqrt(2) + 1);
-            for (Arm n1 : _neig[2])
-                {
-                const iVec2 P1 = (n1 + _a).pos();
-                const double e1 = distcol(Q, P1) + fixed_cost;
-                if (e1 <= cost)
-                    {
-                    for (Arm n2 : _neig[2])
-                        {
-                        const iVec2 P2 = (n1 + n2 + _a).pos();
-                        const double e2 = e1 + distcol(P1, P2);
-                        if (e2 <= cost)
-                            {
-                            for (Arm n3 : _neig[2])
-                                {
-                                const iVec2 P3 = (n1 + n2 + n3 + _a).pos();
-                                const double e3 = e2 + distcol(P2, P3);
-                                if (e3 <= cost)
-                                    {
-                                    for (Arm n4 : _neig[1])
-                                        {                                     
-                                        const iVec2 P4 = (n1 + n2 + n3 + n4 + _a).pos();
-                                        const double e4 = e3 + distcol(P3, P4);
-                                        if ((e4 <= cost) && (P4 == _P))
-                                            {
-                                            if ((!use_target) || (n1 + n2 + n3 + n4 + _a == target))
-                                                {
-                                                if (e4 < cost) sol.clear();
-                                                sol.push_back({ _a + n1 , _a + n1 + n2, _a + n1 + n2 + n3, _a + n1 + n2 + n3 + n4 });
-                                                cost = e4;
+                                                bud = u4;
                                                 }
                                             }
                                         }
@@ -741,6 +680,8 @@ class ArmToPixel
                 }
             if (sol.size() > 0)
                 {
+                ExactCost cost = fixed_cost;
+                cost.addColor(bud);
                 if (cost < _cost)
                     {
                     _steps = 4;
@@ -760,31 +701,26 @@ class ArmToPixel
 
         Arm     _a, _a1, _a2, _a3, _a4; 
         iVec2   _P; 
+        int     _Pid;       // pixel id of _P
+        int     _edgeu;     // color units of the edge _a.pos() -> _P (-1 if not given)
         double  _steps;
-        double  _cost;
+        ExactCost _cost;
+        int     _max_ball;  // largest ball explored
 
         MT2004_64& _gen;
 
 
         // number of neighours depending on the number of non-zero angles. 
-        //  1  2   3    4    5    6    7   8
-        // 16 112 448 1120 1792 1792 1024 256
+        // (for 8 arms)  1  2   3    4    5    6    7   8
+        //              16 112 448 1120 1792 1792 1024 256
         void _createNeighbour()
             {
-            for (int i = 0; i < 9; i++) _neig->clear();
-            for (int u = 0; u < 6561; u++)
+            for (int i = 0; i <= NARMS; i++) _neig[i].clear();
+            for (int u = 0; u < Dims::nbSteps(); u++)
                 {
-                int nb = 0;
-                int i = u;
-                int A7 = i % 3; i /= 3; if (A7 == 2) A7 = -1; if (A7 != 0) nb++;
-                int A6 = i % 3; i /= 3; if (A6 == 2) A6 = -1; if (A6 != 0) nb++;
-                int A5 = i % 3; i /= 3; if (A5 == 2) A5 = -1; if (A5 != 0) nb++;
-                int A4 = i % 3; i /= 3; if (A4 == 2) A4 = -1; if (A4 != 0) nb++;
-                int A3 = i % 3; i /= 3; if (A3 == 2) A3 = -1; if (A3 != 0) nb++;
-                int A2 = i % 3; i /= 3; if (A2 == 2) A2 = -1; if (A2 != 0) nb++;
-                int A1 = i % 3; i /= 3; if (A1 == 2) A1 = -1; if (A1 != 0) nb++;
-                int A0 = i % 3; i /= 3; if (A0 == 2) A0 = -1; if (A0 != 0) nb++;
-                _neig[nb].push_back(Arm(A7, A6, A5, A4, A3, A2, A1, A0));
+                int nb;
+                const Arm a = Arm::stepIncrement(u, nb);
+                _neig[nb].push_back(a);
                 }
 
             _neigB4.clear();
@@ -793,7 +729,7 @@ class ArmToPixel
             for (auto a : _neig[2]) _neigB4.push_back(a);
             }
 
-        std::vector<Arm> _neig[9];
+        std::vector<Arm> _neig[NARMS + 1];
         std::vector<Arm> _neigB4;
 
         Chrono _ch; 
@@ -802,6 +738,11 @@ class ArmToPixel
     };
 
 
+/** ArmToPixel for the arms of the challenge. */
+typedef ArmToPixelT<SANTA_NB_ARMS> ArmToPixel;
+
+
+
 
 
 
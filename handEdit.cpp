@@ -58,7 +58,7 @@ struct Edge
     /* return the id */
     static int id(iVec2 A)
         {
-        return 1 + (A.X() + 128) + (A.Y() + 128) * 257;
+        return 1 + (int)(A.X() + SANTA_IMAGE_CX) + (int)(A.Y() + SANTA_IMAGE_CY) * SANTA_IMAGE_LX;
         }
 
 
@@ -82,18 +82,18 @@ void _redrawHandEdit(CANVAS& L, std::set<Edge>& ES, std::vector<iVec2> & V)
     L.clear();
     double minc = mtools::INF;
     double maxc = -mtools::INF;
-    for (int j = -128; j <= 128; j++)
+    for (int j = -SANTA_IMAGE_CY; j <= SANTA_IMAGE_CY; j++)
         {
-        for (int i = -128; i < 128; i++)
+        for (int i = -SANTA_IMAGE_CX; i < SANTA_IMAGE_CX; i++)
             { // (i,j) <-> (i+1, j)
             const double c = distcol({ i,j }, { i + 1,j });
             if (minc > c) minc = c;
             if (maxc < c) maxc = c;
             }
         }
-    for (int i = -128; i <= 128; i++)
+    for (int i = -SANTA_IMAGE_CX; i <= SANTA_IMAGE_CX; i++)
         {
-        for (int j = -128; j < 128; j++)
+        for (int j = -SANTA_IMAGE_CY; j < SANTA_IMAGE_CY; j++)
             { // (i,j) <-> (i, j+1)
             const double c = distcol({ i,j }, { i,j + 1 });
             if (minc > c) minc = c;
@@ -101,17 +101,17 @@ void _redrawHandEdit(CANVAS& L, std::set<Edge>& ES, std::vector<iVec2> & V)
             }
         }
 
-    for (int j = -128; j <= 128; j++)
+    for (int j = -SANTA_IMAGE_CY; j <= SANTA_IMAGE_CY; j++)
         {
-        for (int i = -128; i < 128; i++)
+        for (int i = -SANTA_IMAGE_CX; i < SANTA_IMAGE_CX; i++)
             { // (i,j) <-> (i+1, j)
             const double c = (distcol({ i,j }, { i + 1,j }) - minc) / (maxc - minc);
             L(mtools::Figure::ThickLine(fVec2(i + 0.5, j - 0.45), fVec2(i + 0.5, j + 0.45), 0.2 * c, true, mtools::RGBc::jetPalette(c)), 3);
             }
         }
-    for (int i = -128; i <= 128; i++)
+    for (int i = -SANTA_IMAGE_CX; i <= SANTA_IMAGE_CX; i++)
         {
-        for (int j = -128; j < 128; j++)
+        for (int j = -SANTA_IMAGE_CY; j < SANTA_IMAGE_CY; j++)
             { // (i,j) <-> (i, j+1)
             const double c = (distcol({ i, j }, { i, j + 1 }) - minc) / (maxc - minc);
             L(mtools::Figure::ThickLine(fVec2(i - 0.45, j + 0.5), fVec2(i + 0.45, j + 0.5), 0.2 * c, true, mtools::RGBc::jetPalette(c)), 3);
@@ -21,6 +21,12 @@ using namespace mtools;
 #include "Rectify.h"
 #include "cutTime.h"
 #include "handEdit.h"
+#include "CutHeuristic.h"
+#include "AdaptiveHeuristic.h"
+#include "Benchmark.h"
+#include "LiftSession.h"
+#include "BatchLift.h"
+#include "LiftAnalyzer.h"
 
 MT2004_64 gen; 
 
@@ -66,8 +72,9 @@ inline Arm trivial_heuristic(int n, Arm arm, iVec2 target, PotSon & potson, bool
         for (int i = 0; i < potson.size(); i++)
             {           
             const Arm a = potson[i] - arm;
-            tot += (a.angle(6) == 0) ? B6 : ((a.angle(6) == 1) ? A6 : C6);
-            tot += (a.angle(7) == 0) ? B7 : ((a.angle(7) == 1) ? A7 : C7);
+            const int a6 = a.angle(Arm::NB_ARMS - 2), a7 = a.angle(Arm::NB_ARMS - 1); // the two largest arms
+            tot += (a6 == 0) ? B6 : ((a6 == 1) ? A6 : C6);
+            tot += (a7 == 0) ? B7 : ((a7 == 1) ? A7 : C7);
             w[i] = tot;
             }
         for (int i = 0; i < potson.size(); i++)
@@ -79,88 +86,92 @@ inline Arm trivial_heuristic(int n, Arm arm, iVec2 target, PotSon & potson, bool
 
 
 
+/**
+* Program to compare the cut time heuristic with the trivial one on the two
+* hard segments (A and E), using the same fixed seeds for both.
+**/
+void programBenchHeuristics()
+    {
+    std::string tourname = arg("tour filename", "../LKHtours/ttr_f_7407570654169005365590.tour");
+    double max_sec = arg("time limit per run (sec)", 600.0);
+    auto V = loadLKHTour(tourname);
+    std::vector<iVec2> A, B, C, D, E;
+    splitTour(V, A, B, C, D, E);
+
+    const std::vector<uint64> seeds = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    cout << benchToString("A : trivial_heuristic", benchHeuristic(A, trivial_heuristic, seeds, max_sec));
+    cout << benchToString("A : CutHeuristic", benchHeuristic(A, CutHeuristic(), seeds, max_sec));
+    cout << benchToString("E : trivial_heuristic", benchHeuristic(E, trivial_heuristic, seeds, max_sec));
+    cout << benchToString("E : CutHeuristic", benchHeuristic(E, CutHeuristic(), seeds, max_sec));
+    cout.getKey();
+    }
+
+
+
 
 /**
-* Main routine for lifting up a path
+* Program to compare the adaptive heuristic with the trivial one on the two
+* hard segments (A and E), using the same fixed seeds for both. Each run starts
+* with fresh statistics so the seeds are independent.
 **/
-void parallelize(const std::vector<iVec2> & tour, int nb_inst, const std::string filename)
-        {
-        TreeSearch * TS[256]; 
-        MT2004_64 *  mtgen[256];
+void programBenchAdaptive()
+    {
+    std::string tourname = arg("tour filename", "../LKHtours/ttr_f_7407570654169005365590.tour");
+    double max_sec = arg("time limit per run (sec)", 600.0);
+    double power = arg("power of the UCB weights", 1.0);
+    auto V = loadLKHTour(tourname);
+    std::vector<iVec2> A, B, C, D, E;
+    splitTour(V, A, B, C, D, E);
 
-        for (int i = 0; i < nb_inst; i++)
+    const std::vector<uint64> seeds = { 1, 2, 3, 4, 5, 6, 7, 8 };
+    auto adaptive = [&](const std::vector<iVec2>& T)
+        {
+        std::vector<BenchResult> res;
+        for (auto seed : seeds)
             {
-            mtgen[i] = new MT2004_64(Unif_32(gen)+ i*i*i);
-            TS[i] = new TreeSearch(tour, *(mtgen[i]));
-            TS[i]->search(trivial_heuristic);
+            auto r = benchHeuristic(T, AdaptiveHeuristic(std::make_shared<BanditStats>(T.size()), power), { seed }, max_sec);
+            res.push_back(r[0]);
             }
+        return res;
+        };
+    cout << benchToString("A : trivial_heuristic", benchHeuristic(A, trivial_heuristic, seeds, max_sec));
+    cout << benchToString("A : AdaptiveHeuristic", adaptive(A));
+    cout << benchToString("E : trivial_heuristic", benchHeuristic(E, trivial_heuristic, seeds, max_sec));
+    cout << benchToString("E : AdaptiveHeuristic", adaptive(E));
+    cout.getKey();
+    }
 
-        cout.resize(50, 50, 520, 600);
 
-        Chrono ch; 
 
-        double best_loss = mtools::INF; 
-        while(1)
-            {           
-            std::vector<int> ind(nb_inst, 0);
-            for (int i = 0; i != ind.size(); i++)  { ind[i] = i; }
-            sort(ind.begin(), ind.end(),
-                [&](const int& a, const int& b) 
-                {
-                if (TS[a]->bestpos() > TS[b]->bestpos()) return true;
-                if ((TS[a]->bestpos() == TS[b]->bestpos()) && (TS[a]->jump_loss() < TS[b]->jump_loss())) return true;
-                if ((TS[a]->bestpos() == TS[b]->bestpos()) && (TS[a]->jump_loss() == TS[b]->jump_loss()) && (TS[a]->jump_steps() < TS[b]->jump_steps())) return true;
 
-                return (TS[a]->bestpos() > TS[b]->bestpos());
-                });
+/**
+* Program to measure how the number of search steps per second scales with the
+* number of concurrent searches.
+**/
+void programBenchScaling()
+    {
+    std::string tourname = arg("tour filename", "../LKHtours/ttr_f_7407570654169005365590.tour");
+    int max_threads = arg("maximum number of threads", (int)std::thread::hardware_concurrency());
+    double sec = arg("duration of each run (sec)", 20.0);
+    auto V = loadLKHTour(tourname);
+    std::vector<iVec2> A, B, C, D, E;
+    splitTour(V, A, B, C, D, E);
+    cout << scalingToString("A : trivial_heuristic", benchScaling(A, trivial_heuristic, max_threads, sec));
+    cout.getKey();
+    }
+
 
-            int nbon = 0;
-            cout.clear();
-            cout << "Tour   : " << filename << "\n"; 
-            cout << "length : " << tour.size() << "\n";
-            cout << "score  : " << score(tour) << "\n\n";
-
-            cout << TS[0]->hrule();
-            cout << TS[0]->header();
-            cout << TS[0]->hrule();
-            for (int j = 0; j < nb_inst; j++)
-                {
-                int i = ind[j]; 
-                if (!(TS[i]->solved()))
-                    {
-                    cout << *(TS[i]);
-                    nbon++; 
-                    }
-                else
-                    {
-                    double l = TS[i]->cumulative_loss();
-                    cout << "*** solved with loss : " << l << " ***\n\n\n";
-                    if (l < best_loss)
-                        {
-                        best_loss = l; 
-                        if (l == 0)
-                            {
-                            TS[i]->save(filename + ".lossless");
-                            for (int i = 0; i < nb_inst; i++)
-                                {
-                                TS[i]->stopSearch();
-                                }
-                            return; 
-                            }
-                        else
-                            {
-                            TS[i]->save(filename + ".loss " + doubleToStringNice(((int)(l * 1000)) / 1000.0));
-                            }
-                        }
-                    }
-                }
-            cout << TS[0]->hrule();
-            if (nbon == 0) return;
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
-            }
-        }
 
 
+/**
+* Micro-benchmark of the color distance with the packed color table.
+**/
+void programBenchDistcol()
+    {
+    int64 nbcalls = arg("number of calls", 50000000);
+    cout << distcolToString(benchDistcol(nbcalls));
+    cout.getKey();
+    }
 
 
 
@@ -175,8 +186,47 @@ int main(int argc, char *argv[])
     MTOOLS_SWAP_THREADS(argc,argv); // required on OSX, does nothing on Linux/Windows
     mtools::parseCommandLine(argc,argv,true); // parse the command line, interactive mode
 
-
-    std::string tourname = arg("tour filename", "../LKHtours/ttr_f_7407570654169005365590.tour");
+    // load the image (.csv or binary) or keep the compiled-in one.
+    std::string imagename = arg("image file (empty for the compiled-in image)", std::string(""));
+    if ((imagename.size() > 0) && (!loadImage(imagename))) { MTOOLS_ERROR(std::string("Cannot open :") << imagename); }
+    if (imageSource().size() == 0) { MTOOLS_ERROR("No image (compiled without the image: an image file is required)."); }
+
+
+    std::string tourname = arg("tour filename (or directory of tours for the batch mode)", "../LKHtours/ttr_f_7407570654169005365590.tour");
+
+    if (std::filesystem::is_directory(tourname))
+        { // batch mode: lift all the tours of the directory.
+        std::string outdir = arg("output directory", tourname + "/lifted");
+        int nbthread = arg("number of threads", 10);
+        int maxtime = arg("time limit per tour in seconds (0 = none)", 0);
+        double margin = arg("cancel the tours worse than the best solution by more than", 0.0);
+        double maxdiff = arg("skip the tours with a difficulty larger than (-1 = no pre-screen)", -1.0);
+        BatchLift batch(tourname, outdir, nbthread, Unif_64(gen));
+        batch.setCancel(margin, maxtime);
+        if (maxdiff >= 0)
+            { // probe each tour for about 800 ms with the heuristic of the lift (see LiftAnalyzer).
+            batch.setPrescreen([](const std::vector<iVec2>& T, std::string&)
+                {
+                LiftAnalyzer LA(tourHash(T));
+                LA.setSetup([](TreeSearch& TS) { TS.setMacroSteps(); });
+                return LA.analyze(T, trivial_heuristic).difficulty;
+                }, maxdiff);
+            }
+        batch.setSetup([](TreeSearch& TS) { TS.setMacroSteps(); });
+        batch.start(trivial_heuristic);
+        cout.resize(50, 50, 620, 800);
+        while (!batch.update())
+            {
+            cout.clear();
+            cout << "Directory : " << tourname << "\n\n";
+            cout << batch.toString();
+            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            }
+        cout << "\n\n" << batch.summary() << "\n";
+        cout << "-> summary saved in [" << outdir << "/batch_summary.txt]\n\n";
+        mtools::cout.getKey();
+        return 0;
+        }
 
     // load the tour found with LKH 
     auto V = loadLKHTour(tourname);
@@ -184,31 +234,26 @@ int main(int argc, char *argv[])
     // display the tour in the plotter.     
     drawTour(V);
 
-    // split the tour in 5 pieces (split at corners)
-    std::vector<iVec2> A, B, C, D, E;
-    splitTour(V, A, B, C, D, E);
-
-     
-    int nbthread = 10; // number of thread to use
-
-    // these 3 path are trivial to lift up. 
-    parallelize(B, 10, tourname + ".B");
-    parallelize(C, 10, tourname + ".C");
-    parallelize(D, 10, tourname + ".D");
+    int nbthread = arg("number of threads", 10); // number of thread to use
 
-    // these 2 are the difficult ones ! 
-    parallelize(A, 10, tourname + ".A");
-    parallelize(E, 10, tourname + ".E");
-
-    // load the 5 partial solutions
-    auto AA = loadSolution((tourname + ".A.lossless").c_str());
-    auto BB = loadSolution((tourname + ".B.lossless").c_str());
-    auto CC = loadSolution((tourname + ".C.lossless").c_str());
-    auto DD = loadSolution((tourname + ".D.lossless").c_str());
-    auto EE = loadSolution((tourname + ".E.lossless").c_str());
+    // lift the 5 parts concurrently. B, C and D are trivial, A and E are the
+    // difficult ones: they get the threads freed by the easy ones.
+    LiftSession session(V, tourname, nbthread, Unif_64(gen));
+    session.setSetup([](TreeSearch& TS) { TS.setMacroSteps(); });
+    session.start(trivial_heuristic);
+    cout.resize(50, 50, 520, 600);
+    while (!session.update())
+        {
+        cout.clear();
+        cout << "Tour   : " << tourname << "\n";
+        cout << "length : " << V.size() << "\n";
+        cout << "score  : " << score(V) << "\n\n";
+        cout << session.toString();
+        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        }
 
     // merge them into a single ful solution
-    auto SOL = patch(AA, BB, CC, DD, EE);
+    auto SOL = session.solution();
 
     // and save it to disk. 
     saveSolution(SOL, (tourname + ".solved.csv").c_str());